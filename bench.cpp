@@ -0,0 +1,1689 @@
+#include "image_quality.h"
+#include "cpu_features.h"
+#include "filter_graph.h"
+#include "temporal.h"
+#include "thread_pool.h"
+// tester.cpp is written as a header (it has an include guard) and is
+// only built into the benchmark suite
+#include "tester.cpp"
+#include <opencv2/imgcodecs.hpp>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+/**
+ * BENCHMARK SUITE
+ * 
+ * Measures the speed of the enhancement kernels on synthetic images,
+ * so results are reproducible and no test images have to be downloaded.
+ * 
+ * Usage: ./image_bench [options] [benchmark ...]
+ * With no benchmark names, every benchmark is run.
+ * 
+ * ./image_bench --make-corpus <dir> writes a small set of synthetic clean
+ * and JPEG-compressed images instead; the PGO build trains on it.
+ */
+
+/**
+ * Options shared by all benchmarks
+ */
+struct BenchOptions {
+    int width;        // Synthetic image width
+    int height;       // Synthetic image height
+    int images;       // Number of images for batch benchmarks
+    int repetitions;  // Timed repetitions per measurement (best is reported)
+};
+
+/**
+ * Generate a synthetic test image
+ * 
+ * The image mixes the content found in real photographs: smooth gradients
+ * (sky, walls), sharp-edged shapes (buildings, text) and fine noise
+ * (sensor noise, compression artifacts).
+ * 
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param seed Random seed, so every run produces the same image
+ * @return cv::Mat 8-bit, 3-channel BGR image
+ */
+cv::Mat makeSyntheticImage(int width, int height, unsigned seed) {
+    cv::Mat image(height, width, CV_8UC3);
+    
+    // Fill rows in parallel; this also first-touches the memory from the
+    // thread (and NUMA node) that generates the image
+    parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+        cv::RNG rng(seed * 7919u + rowBegin);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+            for (int x = 0; x < width; x++) {
+                // Smooth diagonal gradient
+                double base = 255.0 * (x + y) / (width + height);
+                
+                // Checkerboard of 64x64 blocks with hard edges
+                if (((x / 64) + (y / 64)) % 2 == 0) {
+                    base = 0.6 * base + 80.0;
+                }
+                
+                for (int c = 0; c < 3; c++) {
+                    double value = base + 20.0 * c + rng.gaussian(6.0);
+                    row[x][c] = cv::saturate_cast<uchar>(value);
+                }
+            }
+        }
+    });
+    
+    return image;
+}
+
+/**
+ * Seconds elapsed since a cv::getTickCount() timestamp
+ */
+double secondsSince(int64 startTicks) {
+    return (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+}
+
+/**
+ * The batch pipeline being measured: Gaussian blur followed by unsharp
+ * masking, with the default parameters of practical mode
+ */
+cv::Mat enhance(const cv::Mat& image) {
+    cv::Mat blurred = applyGaussianBlur(image, 5, 1.0);
+    return applyUnsharpMask(image, blurred, 1.5, 0.0);
+}
+
+
+// ================================================================
+// BENCHMARK: NUMA THROUGHPUT PER SOCKET
+// ================================================================
+
+/**
+ * Batch enhancement throughput per NUMA node
+ * 
+ * Images are generated (and therefore first-touched) on a home node, then
+ * enhanced either on the same node (local) or on the next node (remote).
+ * The difference between the two runs is the cost of cross-socket memory
+ * traffic. Run with --pin-threads to enable NUMA placement; without it
+ * the whole machine is reported as a single node.
+ */
+int benchNuma(const BenchOptions& options) {
+    ThreadPool& pool = ThreadPool::instance();
+    int numNodes = pool.nodeCount();
+    double megapixels = options.width * static_cast<double>(options.height) / 1e6;
+    
+    std::cout << "Threads: " << pool.threadCount()
+              << (pool.threadsPinned() ? " (pinned)" : " (not pinned)")
+              << ", NUMA nodes: " << numNodes << std::endl;
+    
+    // Generate each image on its home node so its pages live there
+    std::vector<cv::Mat> images(options.images);
+    {
+        TaskGroup generate;
+        for (int i = 0; i < options.images; i++) {
+            generate.runOnNode(i % numNodes, [&, i]() {
+                images[i] = makeSyntheticImage(options.width, options.height, i + 1);
+            });
+        }
+        generate.wait();
+    }
+    
+    // Local placement first, then remote if there is more than one node
+    int placements = (numNodes > 1) ? 2 : 1;
+    for (int placement = 0; placement < placements; placement++) {
+        double bestSeconds = 0.0;
+        
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            TaskGroup batch;
+            for (int i = 0; i < options.images; i++) {
+                int homeNode = i % numNodes;
+                int workNode = (homeNode + placement) % numNodes;
+                batch.runOnNode(workNode, [&, i]() {
+                    // Only the time matters; the result is discarded
+                    enhance(images[i]);
+                });
+            }
+            batch.wait();
+            double seconds = secondsSince(start);
+            if (rep == 0 || seconds < bestSeconds) {
+                bestSeconds = seconds;
+            }
+        }
+        
+        std::cout << (placement == 0 ? "  Local placement:" : "  Remote placement:") << std::endl;
+        for (int node = 0; node < numNodes; node++) {
+            // Images processed by this node in one batch
+            int count = 0;
+            for (int i = 0; i < options.images; i++) {
+                if ((i % numNodes + placement) % numNodes == node) {
+                    count++;
+                }
+            }
+            std::cout << "    Node " << node << ": " << count << " images, "
+                      << count * megapixels / bestSeconds << " MPix/s" << std::endl;
+        }
+        std::cout << "    Total:  " << options.images / bestSeconds << " images/s, "
+                  << options.images * megapixels / bestSeconds << " MPix/s" << std::endl;
+    }
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK: FLOAT32 PRECISION CHECK
+// ================================================================
+
+/**
+ * Double-precision reference unsharp mask (the original implementation),
+ * used to validate the float32/integer kernel in filters.cpp
+ */
+cv::Mat referenceUnsharpMask(const cv::Mat& original, const cv::Mat& blurred,
+                             double amount, double threshold) {
+    cv::Mat output(original.size(), original.type());
+    for (int y = 0; y < original.rows; y++) {
+        const unsigned char* origRow = original.ptr<unsigned char>(y);
+        const unsigned char* blurRow = blurred.ptr<unsigned char>(y);
+        unsigned char* outRow = output.ptr<unsigned char>(y);
+        for (int i = 0; i < original.cols * original.channels(); i++) {
+            double detail = static_cast<double>(origRow[i]) - blurRow[i];
+            if (std::abs(detail) < threshold) {
+                detail = 0.0;
+            }
+            double sharpened = origRow[i] + amount * detail;
+            outRow[i] = static_cast<unsigned char>(std::min(255.0, std::max(0.0, sharpened)));
+        }
+    }
+    return output;
+}
+
+/**
+ * Double-precision reference PSNR (CV_64F conversion, as originally
+ * implemented), used to validate calculatePSNR
+ */
+double referencePSNR(const cv::Mat& original, const cv::Mat& compressed, double maxValue) {
+    cv::Mat orig_double, comp_double;
+    original.convertTo(orig_double, CV_64F);
+    compressed.convertTo(comp_double, CV_64F);
+    cv::Mat diff = orig_double - comp_double;
+    diff = diff.mul(diff);
+    cv::Scalar sums = cv::sum(diff);
+    double sse = sums[0] + sums[1] + sums[2] + sums[3];
+    double mse = sse / (original.total() * original.channels());
+    return 10.0 * std::log10(maxValue * maxValue / mse);
+}
+
+/**
+ * Verify the float32 and integer kernels against the double reference
+ * 
+ * PSNR of every sharpened result is computed both ways and must agree to
+ * within 0.01 dB; the benchmark fails otherwise. The largest per-pixel
+ * difference and the speed of both versions are reported as well.
+ */
+int benchPrecision(const BenchOptions& options) {
+    const double maxDeltaDb = 0.01;
+    
+    cv::Mat clean = makeSyntheticImage(options.width, options.height, 1);
+    cv::Mat noisy = makeSyntheticImage(options.width, options.height, 2);
+    cv::Mat blurred = applyGaussianBlur(noisy, 5, 1.0);
+    
+    // Amounts exactly representable in float (0.5, 1.5) and not (0.7, 2.3)
+    const double amounts[] = {0.5, 0.7, 1.5, 2.3};
+    const double thresholds[] = {0.0, 2.5};
+    
+    int failures = 0;
+    double worstDeltaDb = 0.0;
+    double worstPixelDiff = 0.0;
+    
+    for (size_t a = 0; a < sizeof(amounts) / sizeof(amounts[0]); a++) {
+        for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); t++) {
+            cv::Mat fast = applyUnsharpMask(noisy, blurred, amounts[a], thresholds[t]);
+            cv::Mat reference = referenceUnsharpMask(noisy, blurred, amounts[a], thresholds[t]);
+            
+            double pixelDiff = cv::norm(fast, reference, cv::NORM_INF);
+            double psnrFast = calculatePSNR(clean, fast);
+            double psnrReference = referencePSNR(clean, reference, 255.0);
+            double deltaDb = std::abs(psnrFast - psnrReference);
+            
+            worstPixelDiff = std::max(worstPixelDiff, pixelDiff);
+            worstDeltaDb = std::max(worstDeltaDb, deltaDb);
+            if (deltaDb > maxDeltaDb) {
+                std::cerr << "  ✗ amount " << amounts[a] << ", threshold " << thresholds[t]
+                          << ": PSNR differs by " << deltaDb << " dB" << std::endl;
+                failures++;
+            }
+        }
+    }
+    
+    // Floating-point images (normalized to [0,1]) take the float32 PSNR path
+    cv::Mat cleanFloat, noisyFloat;
+    clean.convertTo(cleanFloat, CV_32F, 1.0 / 255.0);
+    noisy.convertTo(noisyFloat, CV_32F, 1.0 / 255.0);
+    double floatDeltaDb = std::abs(calculatePSNR(cleanFloat, noisyFloat) -
+                                   referencePSNR(cleanFloat, noisyFloat, 1.0));
+    worstDeltaDb = std::max(worstDeltaDb, floatDeltaDb);
+    if (floatDeltaDb > maxDeltaDb) {
+        std::cerr << "  ✗ float32 images: PSNR differs by " << floatDeltaDb << " dB" << std::endl;
+        failures++;
+    }
+    
+    // Speed of both unsharp mask versions
+    double fastSeconds = 0.0, referenceSeconds = 0.0;
+    for (int rep = 0; rep < options.repetitions; rep++) {
+        int64 start = cv::getTickCount();
+        applyUnsharpMask(noisy, blurred, 1.5, 0.0);
+        double seconds = secondsSince(start);
+        fastSeconds = (rep == 0) ? seconds : std::min(fastSeconds, seconds);
+        
+        start = cv::getTickCount();
+        referenceUnsharpMask(noisy, blurred, 1.5, 0.0);
+        seconds = secondsSince(start);
+        referenceSeconds = (rep == 0) ? seconds : std::min(referenceSeconds, seconds);
+    }
+    
+    std::cout << std::setprecision(6);
+    std::cout << "  Largest PSNR difference:  " << worstDeltaDb << " dB (limit " << maxDeltaDb << " dB)" << std::endl;
+    std::cout << std::setprecision(2);
+    std::cout << "  Largest pixel difference: " << worstPixelDiff << " gray levels" << std::endl;
+    std::cout << "  Unsharp mask, double reference (1 thread): " << referenceSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "  Unsharp mask, float32/integer (pool):      " << fastSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << (failures == 0 ? "  ✓ PASS" : "  ✗ FAIL") << std::endl;
+    
+    return failures == 0 ? 0 : -1;
+}
+
+
+// ================================================================
+// BENCHMARK: SPECIALIZED CONVOLUTION KERNELS
+// ================================================================
+
+/**
+ * applyGaussianBlur for each specialized kernel size (3 to 11) and one
+ * generic size (13), compared with cv::GaussianBlur
+ * 
+ * OpenCV's own threading is disabled by the thread pool, so the OpenCV
+ * column is single-threaded; the largest difference between the two
+ * results is reported to confirm they agree.
+ */
+int benchConvolution(const BenchOptions& options) {
+    cv::Mat image = makeSyntheticImage(options.width, options.height, 1);
+    const int sizes[] = {3, 5, 7, 9, 11, 13};
+    
+    std::cout << "  Size   Ours (ms)   OpenCV (ms)   Max difference" << std::endl;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int size = sizes[s];
+        double sigma = 0.3 * ((size - 1) * 0.5 - 1) + 0.8;
+        cv::Mat ours, reference;
+        double oursSeconds = 0.0, referenceSeconds = 0.0;
+        
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            ours = applyGaussianBlur(image, size, sigma);
+            double seconds = secondsSince(start);
+            oursSeconds = (rep == 0) ? seconds : std::min(oursSeconds, seconds);
+            
+            start = cv::getTickCount();
+            cv::GaussianBlur(image, reference, cv::Size(size, size), sigma, sigma);
+            seconds = secondsSince(start);
+            referenceSeconds = (rep == 0) ? seconds : std::min(referenceSeconds, seconds);
+        }
+        
+        std::cout << "  " << std::setw(4) << size << (size > 11 ? "*" : " ")
+                  << std::setw(11) << oursSeconds * 1000.0
+                  << std::setw(14) << referenceSeconds * 1000.0
+                  << std::setw(17) << cv::norm(ours, reference, cv::NORM_INF) << std::endl;
+    }
+    std::cout << "  (* generic kernel, not specialized)" << std::endl;
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK: END-TO-END PIPELINE
+// ================================================================
+
+/**
+ * Throughput of the whole practical-mode pipeline: blur, unsharp mask,
+ * then PSNR and SSIM of the result against the input
+ * 
+ * Images are processed concurrently, as in batch mode. The final
+ * "Throughput:" line is what "make pgo" compares between builds.
+ */
+int benchPipeline(const BenchOptions& options) {
+    double megapixels = options.width * static_cast<double>(options.height) / 1e6;
+    
+    std::vector<cv::Mat> images(options.images);
+    for (int i = 0; i < options.images; i++) {
+        images[i] = makeSyntheticImage(options.width, options.height, i + 1);
+    }
+    
+    double bestSeconds = 0.0;
+    for (int rep = 0; rep < options.repetitions; rep++) {
+        int64 start = cv::getTickCount();
+        TaskGroup batch;
+        for (int i = 0; i < options.images; i++) {
+            batch.run([&, i]() {
+                cv::Mat enhanced = enhance(images[i]);
+                calculatePSNR(images[i], enhanced);
+                computeSSIM(images[i], enhanced);
+            });
+        }
+        batch.wait();
+        double seconds = secondsSince(start);
+        bestSeconds = (rep == 0) ? seconds : std::min(bestSeconds, seconds);
+    }
+    
+    std::cout << "  Per image:  " << bestSeconds * 1000.0 / options.images << " ms" << std::endl;
+    std::cout << "  Throughput: " << options.images * megapixels / bestSeconds << " MPix/s" << std::endl;
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK: UNSHARP MASK METHODS
+// ================================================================
+
+/**
+ * Unsharp mask computed per sample vs read from the 256 x 256 table
+ * 
+ * Times both methods (best of the repetitions) on the blurred synthetic
+ * image, checks that they give identical results and shows which one
+ * the startup calibration picked for this host.
+ */
+int benchUnsharpMethods(const BenchOptions& options) {
+    double megapixels = options.width * static_cast<double>(options.height) / 1e6;
+    cv::Mat image = makeSyntheticImage(options.width, options.height, 1);
+    cv::Mat blurred = applyGaussianBlur(image, 5, 1.0);
+    
+    UnsharpMethod calibrated = activeUnsharpMethod();
+    const UnsharpMethod methods[] = {UNSHARP_ARITHMETIC, UNSHARP_TABLE};
+    cv::Mat results[2];
+    
+    std::cout << "  Method       Time (ms)  Throughput (MPix/s)" << std::endl;
+    for (int m = 0; m < 2; m++) {
+        setUnsharpMethod(methods[m]);
+        double bestSeconds = 0.0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            applyUnsharpMask(image, blurred, results[m], 1.5, 0.0);
+            double seconds = secondsSince(start);
+            bestSeconds = (rep == 0) ? seconds : std::min(bestSeconds, seconds);
+        }
+        std::cout << "  " << std::left << std::setw(11) << unsharpMethodName(methods[m]) << std::right
+                  << std::setw(11) << bestSeconds * 1000.0
+                  << std::setw(21) << megapixels / bestSeconds << std::endl;
+    }
+    setUnsharpMethod(UNSHARP_AUTO);
+    
+    bool identical = cv::norm(results[0], results[1], cv::NORM_INF) == 0.0;
+    std::cout << "  Identical results: " << (identical ? "yes" : "NO") << std::endl;
+    std::cout << "  Chosen at startup: " << unsharpMethodName(calibrated) << std::endl;
+    if (!identical) {
+        std::cerr << "  ERROR: Table results differ from the arithmetic results!" << std::endl;
+        return -1;
+    }
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK: FLAT TILE SKIPPING
+// ================================================================
+
+/**
+ * Synthetic image with large flat areas, like a photo with sky or a scan
+ * with a plain background
+ * 
+ * The top half is a smooth sky gradient with ±1 gray level of noise, the
+ * bottom half the textured content of makeSyntheticImage, with a few
+ * dark "text" strokes on a light band in between.
+ */
+cv::Mat makeFlatContentImage(int width, int height, unsigned seed) {
+    cv::Mat image = makeSyntheticImage(width, height, seed);
+    
+    parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+        cv::RNG rng(seed * 104729u + rowBegin);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+            
+            if (y < height / 2) {
+                // Sky: blue gradient getting lighter towards the horizon
+                double base = 150.0 + 60.0 * y / height;
+                for (int x = 0; x < width; x++) {
+                    int noise = rng.uniform(-1, 2);
+                    row[x][0] = cv::saturate_cast<uchar>(base + 60.0 + noise);
+                    row[x][1] = cv::saturate_cast<uchar>(base + noise);
+                    row[x][2] = cv::saturate_cast<uchar>(base - 60.0 + noise);
+                }
+            } else if (y < height / 2 + height / 8) {
+                // Document band: light background with short dark strokes
+                bool textLine = (y / 12) % 2 == 1;
+                for (int x = 0; x < width; x++) {
+                    bool stroke = textLine && (x % 40) < 3 && (x / 320) % 2 == 0;
+                    uchar value = stroke ? 30 : static_cast<uchar>(235 + rng.uniform(-1, 2));
+                    row[x] = cv::Vec3b(value, value, value);
+                }
+            }
+        }
+    });
+    
+    return image;
+}
+
+/**
+ * Blur + unsharp mask with and without the flat tile prepass
+ * 
+ * For each sharpening threshold, reports the share of flat tiles, the
+ * time of the full-frame filters and of prepass + tiled filters, and
+ * checks that both give the same enhanced image.
+ */
+int benchTiles(const BenchOptions& options) {
+    const double thresholds[] = {2.0, 4.0, 8.0};
+    const int kernelSize = 5;
+    const double sigma = 1.0;
+    const double amount = 1.5;
+    cv::Mat image = makeFlatContentImage(options.width, options.height, 1);
+    
+    std::cout << "  Threshold  Skipped   Full (ms)  Prepass (ms)  Tiled (ms)  Speedup  Identical" << std::endl;
+    for (size_t t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); t++) {
+        cv::Mat blurred, fullResult, tiledResult;
+        TileActivity tiles;
+        double fullSeconds = 0.0, prepassSeconds = 0.0, tiledSeconds = 0.0;
+        
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            applyGaussianBlur(image, blurred, kernelSize, sigma);
+            applyUnsharpMask(image, blurred, fullResult, amount, thresholds[t]);
+            double seconds = secondsSince(start);
+            fullSeconds = (rep == 0) ? seconds : std::min(fullSeconds, seconds);
+            
+            start = cv::getTickCount();
+            findFlatTiles(image, blurRadius(kernelSize, sigma, BLUR_EXACT), thresholds[t], tiles);
+            double prepass = secondsSince(start);
+            applyGaussianBlur(image, blurred, kernelSize, sigma, &tiles);
+            applyUnsharpMask(image, blurred, tiledResult, amount, thresholds[t], &tiles);
+            seconds = secondsSince(start);
+            if (rep == 0 || seconds < tiledSeconds) {
+                tiledSeconds = seconds;
+                prepassSeconds = prepass;
+            }
+        }
+        
+        bool identical = cv::norm(fullResult, tiledResult, cv::NORM_INF) == 0.0;
+        std::cout << "  " << std::setw(9) << thresholds[t]
+                  << std::setw(8) << 100.0 * tiles.skipRatio() << "%"
+                  << std::setw(12) << fullSeconds * 1000.0
+                  << std::setw(14) << prepassSeconds * 1000.0
+                  << std::setw(12) << tiledSeconds * 1000.0
+                  << std::setw(8) << fullSeconds / tiledSeconds << "x"
+                  << std::setw(11) << (identical ? "yes" : "NO") << std::endl;
+        if (!identical) {
+            std::cerr << "  ERROR: Tiled result differs from the full-frame result!" << std::endl;
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK: BOX BLUR CASCADE
+// ================================================================
+
+/**
+ * Three-box running-sum approximation vs exact Gaussian blurs
+ * 
+ * For growing sigmas (kernel size 2 × ceil(3 × sigma) + 1), times our
+ * exact blur, cv::GaussianBlur and the box cascade, and reports how far
+ * the cascade is from cv::GaussianBlur (largest difference and PSNR).
+ */
+int benchBoxBlur(const BenchOptions& options) {
+    const double sigmas[] = {1.0, 2.0, 4.0, 8.0, 16.0};
+    cv::Mat image = makeSyntheticImage(options.width, options.height, 1);
+    
+    std::cout << "  Sigma  Boxes       Box sigma  Exact (ms)  OpenCV (ms)  Box (ms)  Max diff  PSNR (dB)" << std::endl;
+    for (size_t s = 0; s < sizeof(sigmas) / sizeof(sigmas[0]); s++) {
+        double sigma = sigmas[s];
+        int kernelSize = 2 * static_cast<int>(std::ceil(3.0 * sigma)) + 1;
+        int widths[3];
+        double boxSigma = boxCascadeWidths(sigma, widths);
+        
+        cv::Mat exact, reference, box;
+        double exactSeconds = 0.0, opencvSeconds = 0.0, boxSeconds = 0.0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            applyGaussianBlur(image, exact, kernelSize, sigma);
+            double seconds = secondsSince(start);
+            exactSeconds = (rep == 0) ? seconds : std::min(exactSeconds, seconds);
+            
+            start = cv::getTickCount();
+            cv::GaussianBlur(image, reference, cv::Size(kernelSize, kernelSize), sigma, sigma);
+            seconds = secondsSince(start);
+            opencvSeconds = (rep == 0) ? seconds : std::min(opencvSeconds, seconds);
+            
+            start = cv::getTickCount();
+            applyGaussianBlur(image, box, kernelSize, sigma, nullptr, BLUR_BOX_CASCADE);
+            seconds = secondsSince(start);
+            boxSeconds = (rep == 0) ? seconds : std::min(boxSeconds, seconds);
+        }
+        
+        std::ostringstream boxes;
+        boxes << widths[0] << "," << widths[1] << "," << widths[2];
+        std::cout << "  " << std::setw(5) << sigma
+                  << "  " << std::left << std::setw(10) << boxes.str() << std::right
+                  << std::setw(11) << boxSigma
+                  << std::setw(12) << exactSeconds * 1000.0
+                  << std::setw(13) << opencvSeconds * 1000.0
+                  << std::setw(10) << boxSeconds * 1000.0
+                  << std::setw(10) << cv::norm(box, reference, cv::NORM_INF)
+                  << std::setw(11) << calculatePSNR(reference, box) << std::endl;
+    }
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK: TESTER.CPP SEPARABLE GAUSSIAN
+// ================================================================
+
+/**
+ * Copy an image into tester.cpp's RGB layout
+ */
+Image toTesterImage(const cv::Mat& source) {
+    Image image(source.cols, source.rows);
+    for (int y = 0; y < source.rows; y++) {
+        const cv::Vec3b* row = source.ptr<cv::Vec3b>(y);
+        for (int x = 0; x < source.cols; x++) {
+            RGB& pixel = image.at(x, y);
+            pixel.r = row[x][2];
+            pixel.g = row[x][1];
+            pixel.b = row[x][0];
+        }
+    }
+    return image;
+}
+
+/**
+ * Horizontal and vertical pass of the tester.cpp Gaussian blur at Full HD
+ * and 8K widths
+ * 
+ * The vertical pass accumulates whole rows, so its throughput should stay
+ * close to the horizontal pass's even when a row (8K: 23 KB) times the
+ * kernel size no longer fits in L1 cache.
+ */
+int benchTesterGaussian(const BenchOptions& options) {
+    const int widths[] = {1920, 7680};
+    const int kernelSize = 5;
+    std::vector<float> kernel1D(kernelSize);
+    computeGaussianWeights(kernelSize, 1.0, &kernel1D[0]);
+    
+    std::cout << "  Width  Horizontal (ms)  MPix/s   Vertical (ms)  MPix/s" << std::endl;
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        // Same content as the other benchmarks, in tester.cpp's RGB layout
+        Image input = toTesterImage(makeSyntheticImage(widths[w], options.height, 1));
+        Image temp(input.width, input.height);
+        Image output(input.width, input.height);
+        double megapixels = input.width * static_cast<double>(input.height) / 1e6;
+        
+        double horizontalSeconds = 0.0, verticalSeconds = 0.0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            parallelFor(0, input.height, [&](int rowBegin, int rowEnd) {
+                gaussianPass(false, input, temp, &kernel1D[0], kernelSize, rowBegin, rowEnd);
+            });
+            double seconds = secondsSince(start);
+            horizontalSeconds = (rep == 0) ? seconds : std::min(horizontalSeconds, seconds);
+            
+            start = cv::getTickCount();
+            parallelFor(0, temp.height, [&](int rowBegin, int rowEnd) {
+                gaussianPass(true, temp, output, &kernel1D[0], kernelSize, rowBegin, rowEnd);
+            });
+            seconds = secondsSince(start);
+            verticalSeconds = (rep == 0) ? seconds : std::min(verticalSeconds, seconds);
+        }
+        
+        std::cout << "  " << std::setw(5) << input.width
+                  << std::setw(17) << horizontalSeconds * 1000.0
+                  << std::setw(8) << megapixels / horizontalSeconds
+                  << std::setw(16) << verticalSeconds * 1000.0
+                  << std::setw(8) << megapixels / verticalSeconds << std::endl;
+    }
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK: TESTER.CPP SHARPEN
+// ================================================================
+
+/**
+ * Largest per-sample difference between two tester.cpp images
+ */
+int maxTesterDifference(const Image& a, const Image& b) {
+    const unsigned char* pa = reinterpret_cast<const unsigned char*>(&a.pixels[0]);
+    const unsigned char* pb = reinterpret_cast<const unsigned char*>(&b.pixels[0]);
+    int maxDiff = 0;
+    for (size_t i = 0; i < a.pixels.size() * 3; i++) {
+        maxDiff = std::max(maxDiff, std::abs(pa[i] - pb[i]));
+    }
+    return maxDiff;
+}
+
+/**
+ * 3x3 sharpen of tester.cpp: float reference vs fixed-point version, and
+ * blur then sharpen as two passes vs the fused single pass
+ * 
+ * Reports the time of each and the largest difference to the reference
+ * (the fused pass must match the two passes exactly).
+ */
+int benchTesterSharpen(const BenchOptions& options) {
+    Image input = toTesterImage(makeSyntheticImage(options.width, options.height, 1));
+    const int kernelSize = 5;
+    const double sigma = 1.0;
+    const double amount = 1.0;
+    double megapixels = input.width * static_cast<double>(input.height) / 1e6;
+    
+    double floatSeconds = 0.0, fixedSeconds = 0.0, separateSeconds = 0.0, fusedSeconds = 0.0;
+    Image floatResult(0, 0), fixedResult(0, 0), separateResult(0, 0), fusedResult(0, 0);
+    for (int rep = 0; rep < options.repetitions; rep++) {
+        int64 start = cv::getTickCount();
+        floatResult = applySharpenFloat(input, amount);
+        double seconds = secondsSince(start);
+        floatSeconds = (rep == 0) ? seconds : std::min(floatSeconds, seconds);
+        
+        start = cv::getTickCount();
+        fixedResult = applySharpen(input, amount);
+        seconds = secondsSince(start);
+        fixedSeconds = (rep == 0) ? seconds : std::min(fixedSeconds, seconds);
+        
+        start = cv::getTickCount();
+        separateResult = applySharpen(applyGaussianBlur(input, kernelSize, sigma), amount);
+        seconds = secondsSince(start);
+        separateSeconds = (rep == 0) ? seconds : std::min(separateSeconds, seconds);
+        
+        start = cv::getTickCount();
+        fusedResult = applyGaussianSharpen(input, kernelSize, sigma, amount);
+        seconds = secondsSince(start);
+        fusedSeconds = (rep == 0) ? seconds : std::min(fusedSeconds, seconds);
+    }
+    
+    std::cout << "  Method                        Time (ms)  MPix/s  Max diff" << std::endl;
+    const char* names[] = {"Sharpen (float)", "Sharpen (fixed point)",
+                           "Blur + sharpen (two passes)", "Blur + sharpen (fused)"};
+    double times[] = {floatSeconds, fixedSeconds, separateSeconds, fusedSeconds};
+    int diffs[] = {0, maxTesterDifference(floatResult, fixedResult),
+                   0, maxTesterDifference(separateResult, fusedResult)};
+    for (int i = 0; i < 4; i++) {
+        std::cout << "  " << std::left << std::setw(28) << names[i] << std::right
+                  << std::setw(11) << times[i] * 1000.0
+                  << std::setw(8) << megapixels / times[i]
+                  << std::setw(10) << diffs[i] << std::endl;
+    }
+    
+    if (diffs[3] != 0) {
+        std::cerr << "Error: Fused blur + sharpen differs from the two passes!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// ================================================================
+// BENCHMARK: JPEG DEBLOCKING
+// ================================================================
+
+/**
+ * Deblocking of a strongly compressed JPEG vs a full-frame Gaussian blur
+ * 
+ * The synthetic image is encoded at a low JPEG quality and decoded again.
+ * Reports the time of both filters and the PSNR of their results against
+ * the uncompressed image.
+ */
+int benchDeblock(const BenchOptions& options) {
+    const int jpegQualities[] = {10, 20, 40};
+    cv::Mat clean = makeSyntheticImage(options.width, options.height, 1);
+    
+    std::cout << "  Quality  Input PSNR   Deblock (ms)  PSNR      Blur 5x5 (ms)  PSNR" << std::endl;
+    for (size_t q = 0; q < sizeof(jpegQualities) / sizeof(jpegQualities[0]); q++) {
+        std::vector<int> params;
+        params.push_back(cv::IMWRITE_JPEG_QUALITY);
+        params.push_back(jpegQualities[q]);
+        std::vector<uchar> encoded;
+        cv::imencode(".jpg", clean, encoded, params);
+        cv::Mat compressed = cv::imdecode(encoded, cv::IMREAD_COLOR);
+        
+        cv::Mat deblocked, blurred;
+        double deblockSeconds = 0.0, blurSeconds = 0.0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            applyDeblocking(compressed, deblocked, 1.0);
+            double seconds = secondsSince(start);
+            deblockSeconds = (rep == 0) ? seconds : std::min(deblockSeconds, seconds);
+            
+            start = cv::getTickCount();
+            applyGaussianBlur(compressed, blurred, 5, 1.0);
+            seconds = secondsSince(start);
+            blurSeconds = (rep == 0) ? seconds : std::min(blurSeconds, seconds);
+        }
+        
+        std::cout << "  " << std::setw(7) << jpegQualities[q]
+                  << std::setw(12) << calculatePSNR(clean, compressed)
+                  << std::setw(15) << deblockSeconds * 1000.0
+                  << std::setw(8) << calculatePSNR(clean, deblocked)
+                  << std::setw(15) << blurSeconds * 1000.0
+                  << std::setw(8) << calculatePSNR(clean, blurred) << std::endl;
+    }
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK: MEDIAN FILTER
+// ================================================================
+
+/**
+ * Copy of an image with salt-and-pepper noise: the given fraction of the
+ * pixels is set to black or white
+ */
+cv::Mat addImpulseNoise(const cv::Mat& clean, double fraction, unsigned seed) {
+    cv::Mat noisy = clean.clone();
+    const int channels = clean.channels();
+    parallelFor(0, clean.rows, [&](int rowBegin, int rowEnd) {
+        cv::RNG rng(seed * 104729u + rowBegin);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            uchar* row = noisy.ptr<uchar>(y);
+            for (int x = 0; x < clean.cols; x++) {
+                if (rng.uniform(0.0, 1.0) < fraction) {
+                    uchar value = (rng.uniform(0, 2) == 0) ? 0 : 255;
+                    for (int c = 0; c < channels; c++) {
+                        row[x * channels + c] = value;
+                    }
+                }
+            }
+        }
+    });
+    return noisy;
+}
+
+/**
+ * Median filter vs cv::medianBlur for growing radii, on an image with 5%
+ * salt-and-pepper noise
+ * 
+ * The time of applyMedianFilter should stay about the same for every
+ * radius. Also reports the PSNR against the clean image, with a 5x5
+ * Gaussian blur for comparison, and checks that both medians agree.
+ */
+int benchMedian(const BenchOptions& options) {
+    const int radii[] = {1, 2, 4, 8, 16};
+    cv::Mat clean = makeSyntheticImage(options.width, options.height, 1);
+    cv::Mat noisy = addImpulseNoise(clean, 0.05, 1);
+    
+    cv::Mat blurred;
+    double blurSeconds = 0.0;
+    for (int rep = 0; rep < options.repetitions; rep++) {
+        int64 start = cv::getTickCount();
+        applyGaussianBlur(noisy, blurred, 5, 1.0);
+        double seconds = secondsSince(start);
+        blurSeconds = (rep == 0) ? seconds : std::min(blurSeconds, seconds);
+    }
+    std::cout << "  Input PSNR: " << calculatePSNR(clean, noisy) << " dB" << std::endl;
+    std::cout << "  Gaussian blur 5x5: " << blurSeconds * 1000.0 << " ms, PSNR "
+              << calculatePSNR(clean, blurred) << " dB" << std::endl << std::endl;
+    
+    std::cout << "  Radius  Median (ms)  cv::medianBlur (ms)  PSNR     Identical" << std::endl;
+    bool allIdentical = true;
+    for (size_t r = 0; r < sizeof(radii) / sizeof(radii[0]); r++) {
+        cv::Mat filtered, reference;
+        double medianSeconds = 0.0, opencvSeconds = 0.0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            applyMedianFilter(noisy, filtered, radii[r]);
+            double seconds = secondsSince(start);
+            medianSeconds = (rep == 0) ? seconds : std::min(medianSeconds, seconds);
+            
+            start = cv::getTickCount();
+            cv::medianBlur(noisy, reference, 2 * radii[r] + 1);
+            seconds = secondsSince(start);
+            opencvSeconds = (rep == 0) ? seconds : std::min(opencvSeconds, seconds);
+        }
+        
+        bool identical = cv::norm(filtered, reference, cv::NORM_INF) == 0;
+        allIdentical = allIdentical && identical;
+        std::cout << "  " << std::setw(6) << radii[r]
+                  << std::setw(13) << medianSeconds * 1000.0
+                  << std::setw(21) << opencvSeconds * 1000.0
+                  << std::setw(8) << calculatePSNR(clean, filtered)
+                  << std::setw(12) << (identical ? "yes" : "NO") << std::endl;
+    }
+    
+    if (!allIdentical) {
+        std::cerr << "Error: Median filter differs from cv::medianBlur!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// ================================================================
+// BENCHMARK: TEMPORAL DENOISING
+// ================================================================
+
+/**
+ * Copy of an image with Gaussian noise added to every sample
+ */
+cv::Mat addNoise(const cv::Mat& clean, double sigma, unsigned seed) {
+    cv::Mat noisy(clean.size(), clean.type());
+    int rowLength = clean.cols * clean.channels();
+    parallelFor(0, clean.rows, [&](int rowBegin, int rowEnd) {
+        cv::RNG rng(seed * 104729u + rowBegin);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            const uchar* src = clean.ptr<uchar>(y);
+            uchar* dst = noisy.ptr<uchar>(y);
+            for (int i = 0; i < rowLength; i++) {
+                dst[i] = cv::saturate_cast<uchar>(src[i] + rng.gaussian(sigma));
+            }
+        }
+    });
+    return noisy;
+}
+
+/**
+ * Temporal denoising of a panning sequence vs a spatial Gaussian blur
+ * 
+ * The clean sequence is a window moving 2 pixels right and 1 pixel down
+ * per frame over a larger synthetic scene; every frame gets fresh noise.
+ * Reports the time per frame and the mean PSNR against the clean frames
+ * (the first frames, while the history builds up, are not scored).
+ * Run with --threads 1 for the single-core time.
+ */
+int benchTemporal(const BenchOptions& options) {
+    const double noiseSigma = 8.0;
+    const int frames = std::max(options.images, 8);
+    const int warmupFrames = 3;
+    
+    cv::Mat scene = makeSyntheticImage(options.width + 2 * frames, options.height + frames, 1);
+    std::vector<cv::Mat> clean(frames), noisy(frames);
+    for (int t = 0; t < frames; t++) {
+        clean[t] = scene(cv::Rect(2 * t, t, options.width, options.height)).clone();
+        noisy[t] = addNoise(clean[t], noiseSigma, t + 1);
+    }
+    
+    double noisyPsnr = 0.0;
+    for (int t = warmupFrames; t < frames; t++) {
+        noisyPsnr += calculatePSNR(clean[t], noisy[t]);
+    }
+    noisyPsnr /= (frames - warmupFrames);
+    
+    const char* methods[] = {"Gaussian blur 5x5", "Temporal", "Temporal + block matching"};
+    
+    std::cout << "  Threads: " << ThreadPool::instance().threadCount()
+              << ", noise sigma " << noiseSigma << ", " << frames << " frames" << std::endl;
+    std::cout << "  Method                      ms/frame   PSNR (dB)" << std::endl;
+    std::cout << "  Noisy input                        -" << std::setw(12) << noisyPsnr << std::endl;
+    
+    for (int method = 0; method < 3; method++) {
+        double bestSeconds = 0.0;
+        double meanPsnr = 0.0;
+        
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            TemporalDenoiseParams params = defaultTemporalDenoiseParams();
+            params.blockMatching = (method == 2);
+            TemporalDenoiser denoiser(params);
+            
+            std::vector<cv::Mat> outputs(frames);
+            int64 start = cv::getTickCount();
+            for (int t = 0; t < frames; t++) {
+                if (method == 0) {
+                    applyGaussianBlur(noisy[t], outputs[t], 5, 1.0);
+                } else {
+                    denoiser.process(noisy[t], outputs[t]);
+                }
+            }
+            double seconds = secondsSince(start);
+            bestSeconds = (rep == 0) ? seconds : std::min(bestSeconds, seconds);
+            
+            meanPsnr = 0.0;
+            for (int t = warmupFrames; t < frames; t++) {
+                meanPsnr += calculatePSNR(clean[t], outputs[t]);
+            }
+            meanPsnr /= (frames - warmupFrames);
+        }
+        
+        std::cout << "  " << std::left << std::setw(27) << methods[method] << std::right
+                  << std::setw(10) << bestSeconds * 1000.0 / frames
+                  << std::setw(12) << meanPsnr << std::endl;
+    }
+    std::cout << "  (real time at 30 FPS needs under 33.3 ms/frame)" << std::endl;
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK: NON-LOCAL MEANS
+// ================================================================
+
+/**
+ * Non-local means with growing patch sizes vs Gaussian and median filters,
+ * on an image with Gaussian noise (sigma 15)
+ * 
+ * The search window is fixed (11x11), so the time of non-local means
+ * should stay about the same for every patch size. Reports the PSNR of
+ * each result against the clean image.
+ */
+int benchNonLocalMeans(const BenchOptions& options) {
+    const double noiseSigma = 15.0;
+    const int searchRadius = 5;
+    const int patchRadii[] = {1, 2, 3, 5};
+    cv::Mat clean = makeSyntheticImage(options.width, options.height, 1);
+    cv::Mat noisy = addNoise(clean, noiseSigma, 1);
+    
+    std::cout << "  Input PSNR: " << calculatePSNR(clean, noisy) << " dB" << std::endl << std::endl;
+    std::cout << "  Method                    Time (ms)  PSNR" << std::endl;
+    
+    const int methods = 2 + sizeof(patchRadii) / sizeof(patchRadii[0]);
+    for (int m = 0; m < methods; m++) {
+        cv::Mat result;
+        double bestSeconds = 0.0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            if (m == 0) {
+                applyGaussianBlur(noisy, result, 5, 1.0);
+            } else if (m == 1) {
+                applyMedianFilter(noisy, result, 1);
+            } else {
+                applyNonLocalMeans(noisy, result, noiseSigma, patchRadii[m - 2], searchRadius);
+            }
+            double seconds = secondsSince(start);
+            bestSeconds = (rep == 0) ? seconds : std::min(bestSeconds, seconds);
+        }
+        
+        std::string name;
+        if (m == 0) {
+            name = "Gaussian blur 5x5";
+        } else if (m == 1) {
+            name = "Median 3x3";
+        } else {
+            int patch = 2 * patchRadii[m - 2] + 1;
+            name = "Non-local means " + std::to_string(patch) + "x" + std::to_string(patch);
+        }
+        std::cout << "  " << std::left << std::setw(24) << name << std::right
+                  << std::setw(11) << bestSeconds * 1000.0
+                  << std::setw(8) << calculatePSNR(clean, result) << std::endl;
+    }
+    
+    return 0;
+}
+
+// ================================================================
+// BENCHMARK: WAVELET DENOISING
+// ================================================================
+
+/**
+ * Wavelet shrinkage vs the Gaussian blur, on images with Gaussian noise
+ * (sigma 5, 10 and 20)
+ * 
+ * Reports the time and the PSNR of the denoised image against the clean
+ * one, then the PSNR of the enhanced output (blur and unsharp mask) with
+ * and without the wavelet pre-pass, against the clean image enhanced the
+ * same way. Also checks that a threshold of 0 gives the input back
+ * exactly (the integer lifting is lossless).
+ */
+int benchWavelet(const BenchOptions& options) {
+    const double noiseSigmas[] = {5.0, 10.0, 20.0};
+    const double thresholdScales[] = {1.0, 1.5};
+    cv::Mat clean = makeSyntheticImage(options.width, options.height, 1);
+    
+    cv::Mat roundTrip;
+    applyWaveletDenoise(clean, roundTrip, 0.0, 3);
+    bool lossless = cv::norm(clean, roundTrip, cv::NORM_INF) == 0;
+    std::cout << "  Lossless round trip (threshold 0): " << (lossless ? "yes" : "NO") << std::endl << std::endl;
+    
+    std::cout << "  Noise  Input PSNR  Blur 5x5 (ms)  PSNR    Wavelet 1.0 (ms)  PSNR    Wavelet 1.5 (ms)  PSNR" << std::endl;
+    for (size_t n = 0; n < sizeof(noiseSigmas) / sizeof(noiseSigmas[0]); n++) {
+        cv::Mat noisy = addNoise(clean, noiseSigmas[n], 1);
+        std::cout << "  " << std::setw(5) << noiseSigmas[n]
+                  << std::setw(12) << calculatePSNR(clean, noisy);
+        
+        for (int m = 0; m < 3; m++) {
+            cv::Mat result;
+            double bestSeconds = 0.0;
+            for (int rep = 0; rep < options.repetitions; rep++) {
+                int64 start = cv::getTickCount();
+                if (m == 0) {
+                    applyGaussianBlur(noisy, result, 5, 1.0);
+                } else {
+                    applyWaveletDenoise(noisy, result, thresholdScales[m - 1], 3);
+                }
+                double seconds = secondsSince(start);
+                bestSeconds = (rep == 0) ? seconds : std::min(bestSeconds, seconds);
+            }
+            std::cout << std::setw(m == 0 ? 15 : 18) << bestSeconds * 1000.0
+                      << std::setw(8) << calculatePSNR(clean, result);
+        }
+        std::cout << std::endl;
+    }
+    
+    // The unsharp mask amplifies whatever noise is left, so the enhanced
+    // output is what the pre-pass has to improve
+    cv::Mat target = enhance(clean);
+    std::cout << std::endl << "  Noise  Enhanced PSNR  Wavelet + enhanced PSNR" << std::endl;
+    for (size_t n = 0; n < sizeof(noiseSigmas) / sizeof(noiseSigmas[0]); n++) {
+        cv::Mat noisy = addNoise(clean, noiseSigmas[n], 1);
+        cv::Mat denoised;
+        applyWaveletDenoise(noisy, denoised, 1.0, 3);
+        std::cout << "  " << std::setw(5) << noiseSigmas[n]
+                  << std::setw(15) << calculatePSNR(target, enhance(noisy))
+                  << std::setw(25) << calculatePSNR(target, enhance(denoised)) << std::endl;
+    }
+    
+    if (!lossless) {
+        std::cerr << "Error: Wavelet transform is not lossless!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// ================================================================
+// BENCHMARK: FFT CONVOLUTION
+// ================================================================
+
+/**
+ * Direct separable convolution vs the FFT overlap-save path for kernel
+ * sizes from 15 to 301 (default sigma of each size)
+ * 
+ * Reports both times, the largest difference between the two results
+ * (at most one gray level) and the crossover measured at startup, from
+ * which applyGaussianBlur switches to the FFT path.
+ */
+int benchFFTConvolution(const BenchOptions& options) {
+    const int sizes[] = {15, 31, 63, 127, 201, 301};
+    cv::Mat image = makeSyntheticImage(options.width, options.height, 1);
+    
+    std::cout << "  Crossover on this host: " << fftConvolutionCrossover() << std::endl << std::endl;
+    std::cout << "  Size   Direct (ms)   FFT (ms)   Speedup   Max difference" << std::endl;
+    double worstDifference = 0.0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int size = sizes[s];
+        std::vector<float> kernel(size);
+        computeGaussianWeights(size, 0.0, &kernel[0]);
+        
+        cv::Mat direct, fft;
+        double directSeconds = 0.0, fftSeconds = 0.0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            convolveSeparableDirect(image, direct, &kernel[0], size);
+            double seconds = secondsSince(start);
+            directSeconds = (rep == 0) ? seconds : std::min(directSeconds, seconds);
+            
+            start = cv::getTickCount();
+            convolveSeparableFFT(image, fft, &kernel[0], size);
+            seconds = secondsSince(start);
+            fftSeconds = (rep == 0) ? seconds : std::min(fftSeconds, seconds);
+        }
+        
+        double difference = cv::norm(direct, fft, cv::NORM_INF);
+        worstDifference = std::max(worstDifference, difference);
+        std::cout << "  " << std::setw(4) << size
+                  << std::setw(14) << directSeconds * 1000.0
+                  << std::setw(11) << fftSeconds * 1000.0
+                  << std::setw(9) << directSeconds / fftSeconds << "x"
+                  << std::setw(17) << difference << std::endl;
+    }
+    
+    if (worstDifference > 1.0) {
+        std::cerr << "Error: FFT convolution differs from the direct path by more than one gray level!" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// ================================================================
+// BENCHMARK: LAPLACIAN PYRAMID ENHANCEMENT
+// ================================================================
+
+/**
+ * Laplacian pyramid enhancement vs the blur + unsharp mask it replaces,
+ * once (sigma 1) and twice (sigma 1, then sigma 3 for mid-scale detail)
+ * 
+ * Reports the time of each and the pyramid time relative to one unsharp
+ * mask (the target is under 2x), for 1 to 5 pyramid levels.
+ */
+int benchPyramid(const BenchOptions& options) {
+    const int maxLevels = 5;
+    cv::Mat image = makeSyntheticImage(options.width, options.height, 1);
+    std::vector<PyramidLevel> defaults = defaultPyramidLevels(1.5, 0.0);
+    
+    // Method 0: one blur + unsharp mask, 1: two of them, 2 and up: the
+    // pyramid with 1 to maxLevels levels (levels past the defaults reuse
+    // the coarsest setting)
+    double seconds[2 + maxLevels];
+    cv::Mat blurred, coarseBlurred, sharpened, result;
+    for (int m = 0; m < 2 + maxLevels; m++) {
+        std::vector<PyramidLevel> settings;
+        for (int k = 0; k < m - 1; k++) {
+            settings.push_back(defaults[std::min(k, static_cast<int>(defaults.size()) - 1)]);
+        }
+        
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            if (m < 2) {
+                applyGaussianBlur(image, blurred, 5, 1.0);
+                applyUnsharpMask(image, blurred, sharpened, 1.5, 0.0);
+                if (m == 1) {
+                    applyGaussianBlur(sharpened, coarseBlurred, 19, 3.0);
+                    applyUnsharpMask(sharpened, coarseBlurred, result, 0.5, 0.0);
+                }
+            } else {
+                applyPyramidEnhance(image, result, settings);
+            }
+            double elapsed = secondsSince(start);
+            seconds[m] = (rep == 0) ? elapsed : std::min(seconds[m], elapsed);
+        }
+    }
+    
+    std::cout << "  Blur + unsharp mask, sigma 1:          " << std::setw(8) << seconds[0] * 1000.0 << " ms" << std::endl;
+    std::cout << "  Blur + unsharp mask, sigma 1 then 3:   " << std::setw(8) << seconds[1] * 1000.0 << " ms" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  Levels   Pyramid (ms)   vs one unsharp mask" << std::endl;
+    for (int levels = 1; levels <= maxLevels; levels++) {
+        std::cout << "  " << std::setw(6) << levels
+                  << std::setw(15) << seconds[levels + 1] * 1000.0
+                  << std::setw(20) << seconds[levels + 1] / seconds[0] << "x" << std::endl;
+    }
+    
+    return 0;
+}
+
+// ================================================================
+// BENCHMARK: JOINT BILATERAL UPSAMPLING
+// ================================================================
+
+/**
+ * PSNR between two tester.cpp images of the same size
+ */
+double testerPSNR(const Image& a, const Image& b) {
+    const unsigned char* pa = reinterpret_cast<const unsigned char*>(&a.pixels[0]);
+    const unsigned char* pb = reinterpret_cast<const unsigned char*>(&b.pixels[0]);
+    double sumSquares = 0.0;
+    for (size_t i = 0; i < a.pixels.size() * 3; i++) {
+        double d = pa[i] - pb[i];
+        sumSquares += d * d;
+    }
+    double mse = sumSquares / (a.pixels.size() * 3.0);
+    return (mse == 0.0) ? 100.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+/**
+ * tester.cpp bilateral filter (9x9, sigma 3) at full resolution vs at half
+ * and quarter resolution with joint bilateral upsampling
+ * 
+ * Reports the time, the speedup and the PSNR of each result against the
+ * full-resolution filter on a noisy image.
+ */
+int benchJointUpsampling(const BenchOptions& options) {
+    const int kernelSize = 9;
+    const double sigmaSpatial = 3.0;
+    const double sigmaRange = 30.0;
+    const int factors[] = {1, 2, 4};
+    Image input = toTesterImage(addNoise(makeSyntheticImage(options.width, options.height, 1), 10.0, 1));
+    
+    std::cout << "  Factor   Time (ms)   Speedup   PSNR vs full resolution" << std::endl;
+    Image reference(0, 0);
+    double referenceSeconds = 0.0;
+    for (int f = 0; f < 3; f++) {
+        Image result(0, 0);
+        double bestSeconds = 0.0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            result = applyBilateralFilterDownsampled(input, kernelSize, sigmaSpatial, sigmaRange, factors[f]);
+            double seconds = secondsSince(start);
+            bestSeconds = (rep == 0) ? seconds : std::min(bestSeconds, seconds);
+        }
+        if (f == 0) {
+            reference = result;
+            referenceSeconds = bestSeconds;
+        }
+        std::cout << "  " << std::setw(6) << factors[f]
+                  << std::setw(12) << bestSeconds * 1000.0
+                  << std::setw(9) << referenceSeconds / bestSeconds << "x";
+        if (f == 0) {
+            std::cout << std::setw(26) << "-" << std::endl;
+        } else {
+            std::cout << std::setw(26) << testerPSNR(reference, result) << std::endl;
+        }
+    }
+    
+    return 0;
+}
+
+// ================================================================
+// BENCHMARK: FILTER GRAPH FUSION
+// ================================================================
+
+/**
+ * A filter graph with fused, banded passes vs its stages one by one
+ * 
+ * The graph "deblock; median 1; sharpen 1.5 4; gain 1.1; gamma 0.9;
+ * clamp 16 235" runs in one banded pass. The reference calls the filters
+ * on whole images and runs each pointwise stage as its own graph, one
+ * full-frame pass per stage. Reports both times and checks that the
+ * results are identical.
+ */
+int benchFilterGraph(const BenchOptions& options) {
+    const char* description = "deblock; median 1; sharpen 1.5 4; gain 1.1; gamma 0.9; clamp 16 235";
+    const char* pointwiseStages[] = {"gain 1.1", "gamma 0.9", "clamp 16 235"};
+    cv::Mat image = addImpulseNoise(makeSyntheticImage(options.width, options.height, 1), 0.01, 1);
+    
+    FilterGraph graph;
+    FilterGraph pointwise[3];
+    if (!graph.parse(description)) {
+        return -1;
+    }
+    for (int k = 0; k < 3; k++) {
+        if (!pointwise[k].parse(pointwiseStages[k])) {
+            return -1;
+        }
+    }
+    std::cout << "  Graph: " << description << std::endl;
+    std::cout << graph.describe(image.cols, image.channels(), "    ");
+    
+    cv::Mat deblocked, filtered, blurred, stageResults[4], fusedResult;
+    double stagedSeconds = 0.0, fusedSeconds = 0.0;
+    for (int rep = 0; rep < options.repetitions; rep++) {
+        int64 start = cv::getTickCount();
+        applyDeblocking(image, deblocked, 1.0);
+        applyMedianFilter(deblocked, filtered, 1);
+        applyGaussianBlur(filtered, blurred, 5, 1.0);
+        applyUnsharpMask(filtered, blurred, stageResults[0], 1.5, 4.0);
+        for (int k = 0; k < 3; k++) {
+            pointwise[k].run(stageResults[k], stageResults[k + 1]);
+        }
+        double seconds = secondsSince(start);
+        stagedSeconds = (rep == 0) ? seconds : std::min(stagedSeconds, seconds);
+        
+        start = cv::getTickCount();
+        graph.run(image, fusedResult);
+        seconds = secondsSince(start);
+        fusedSeconds = (rep == 0) ? seconds : std::min(fusedSeconds, seconds);
+    }
+    
+    bool identical = cv::norm(stageResults[3], fusedResult, cv::NORM_INF) == 0.0;
+    std::cout << "  Stage by stage (7 passes):     " << std::setw(8) << stagedSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "  Fused graph (" << graph.passCount() << " pass):           "
+              << std::setw(8) << fusedSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "  Speedup:                       " << std::setw(8) << stagedSeconds / fusedSeconds << "x" << std::endl;
+    std::cout << "  Identical:                     " << std::setw(8) << (identical ? "yes" : "NO") << std::endl;
+    if (!identical) {
+        std::cerr << "  ERROR: Fused graph result differs from the stage-by-stage result!" << std::endl;
+        return -1;
+    }
+    
+    return 0;
+}
+
+// ================================================================
+// BENCHMARK: FUSED SSIM
+// ================================================================
+
+/**
+ * SSIM as originally implemented: every step of the formula is a
+ * separate cv::Mat operation with its own full-size result
+ */
+double referenceSSIM(const cv::Mat& imageA, const cv::Mat& imageB) {
+    const double C1 = (0.01 * 255) * (0.01 * 255);
+    const double C2 = (0.03 * 255) * (0.03 * 255);
+    cv::Mat floatA, floatB;
+    imageA.convertTo(floatA, CV_32F);
+    imageB.convertTo(floatB, CV_32F);
+    cv::Mat meanA = applyGaussianBlur(floatA, 11, 1.5);
+    cv::Mat meanB = applyGaussianBlur(floatB, 11, 1.5);
+    cv::Mat varianceA = applyGaussianBlur(floatA.mul(floatA), 11, 1.5);
+    cv::Mat varianceB = applyGaussianBlur(floatB.mul(floatB), 11, 1.5);
+    cv::Mat covariance = applyGaussianBlur(floatA.mul(floatB), 11, 1.5);
+    cv::Mat meanA_squared = meanA.mul(meanA);
+    cv::Mat meanB_squared = meanB.mul(meanB);
+    cv::Mat meanA_times_meanB = meanA.mul(meanB);
+    varianceA = varianceA - meanA_squared;
+    varianceB = varianceB - meanB_squared;
+    covariance = covariance - meanA_times_meanB;
+    cv::Mat numerator = (2.0 * meanA_times_meanB + C1).mul(2.0 * covariance + C2);
+    cv::Mat denominator = (meanA_squared + meanB_squared + C1).mul(varianceA + varianceB + C2);
+    cv::Mat ssimMap;
+    cv::divide(numerator, denominator, ssimMap);
+    return cv::mean(ssimMap)[0];
+}
+
+/**
+ * Fused SSIM formula vs the chain of cv::Mat operations
+ * 
+ * computeSSIM evaluates everything after the five Gaussian-filtered
+ * moments in one loop; the reference builds eleven more full-size
+ * planes. Reports both times and checks that the scores agree to 1e-4.
+ */
+int benchSSIM(const BenchOptions& options) {
+    const double maxDelta = 1e-4;
+    cv::Mat clean = makeSyntheticImage(options.width, options.height, 1);
+    cv::Mat enhanced = enhance(addNoise(clean, 8.0, 1));
+    
+    double referenceValue = 0.0, fusedValue = 0.0;
+    double referenceSeconds = 0.0, fusedSeconds = 0.0;
+    for (int rep = 0; rep < options.repetitions; rep++) {
+        int64 start = cv::getTickCount();
+        referenceValue = referenceSSIM(clean, enhanced);
+        double seconds = secondsSince(start);
+        referenceSeconds = (rep == 0) ? seconds : std::min(referenceSeconds, seconds);
+        
+        start = cv::getTickCount();
+        fusedValue = computeSSIM(clean, enhanced);
+        seconds = secondsSince(start);
+        fusedSeconds = (rep == 0) ? seconds : std::min(fusedSeconds, seconds);
+    }
+    
+    double delta = std::abs(fusedValue - referenceValue);
+    std::cout << std::setprecision(6);
+    std::cout << "  cv::Mat chain:  " << std::setw(10) << referenceSeconds * 1000.0 << " ms   SSIM " << referenceValue << std::endl;
+    std::cout << "  Fused formula:  " << std::setw(10) << fusedSeconds * 1000.0 << " ms   SSIM " << fusedValue << std::endl;
+    std::cout << "  Speedup:        " << std::setw(10) << referenceSeconds / fusedSeconds << "x" << std::endl;
+    std::cout << "  Difference:     " << std::setw(10) << delta << (delta <= maxDelta ? "   ✓ PASS" : "   ✗ FAIL") << std::endl;
+    std::cout << std::setprecision(2);
+    
+    return delta <= maxDelta ? 0 : -1;
+}
+
+// ================================================================
+// BENCHMARK: FP16 SSIM STORAGE
+// ================================================================
+
+/**
+ * SSIM with float32 vs FP16 moment planes
+ * 
+ * At the benchmark size and at twice its width and height, times
+ * computeSSIM with both storages and reports the score deviation; FP16
+ * must stay within 1e-3 of float32.
+ */
+int benchSSIMStorage(const BenchOptions& options) {
+    const double maxDelta = 1e-3;
+    const SSIMStorage storages[] = {SSIM_STORAGE_FLOAT32, SSIM_STORAGE_FLOAT16};
+    SSIMStorage previous = activeSSIMStorage();
+    
+    std::cout << "  Size            Float32 (ms)   FP16 (ms)   Speedup   Deviation" << std::endl;
+    bool passed = true;
+    for (int scale = 1; scale <= 2; scale++) {
+        int width = options.width * scale, height = options.height * scale;
+        cv::Mat clean = makeSyntheticImage(width, height, 1);
+        cv::Mat enhanced = enhance(addNoise(clean, 8.0, 1));
+        
+        double values[2], seconds[2];
+        for (int s = 0; s < 2; s++) {
+            setSSIMStorage(storages[s]);
+            for (int rep = 0; rep < options.repetitions; rep++) {
+                int64 start = cv::getTickCount();
+                values[s] = computeSSIM(clean, enhanced);
+                double elapsed = secondsSince(start);
+                seconds[s] = (rep == 0) ? elapsed : std::min(seconds[s], elapsed);
+            }
+        }
+        
+        double delta = std::abs(values[1] - values[0]);
+        passed = passed && delta <= maxDelta;
+        std::ostringstream size;
+        size << width << "x" << height;
+        std::cout << "  " << std::left << std::setw(14) << size.str() << std::right
+                  << std::setw(14) << seconds[0] * 1000.0
+                  << std::setw(12) << seconds[1] * 1000.0
+                  << std::setw(9) << seconds[0] / seconds[1] << "x"
+                  << std::setw(12) << std::scientific << delta << std::fixed << std::endl;
+    }
+    setSSIMStorage(previous);
+    
+    std::cout << "  Moment planes: " << (passed ? "✓ FP16 within " : "✗ FP16 NOT within ")
+              << std::scientific << maxDelta << std::fixed << " of float32" << std::endl;
+    return passed ? 0 : -1;
+}
+
+/**
+ * Noise estimation on a 24 MP image
+ * 
+ * Adds Gaussian noise of increasing strength to a 6000x4000 synthetic
+ * image (which already holds noise of sigma 6) and times estimateNoiseLevel.
+ * Each estimate must be within 10% of the total noise, and the parameters
+ * it picks are printed.
+ */
+int benchNoiseEstimate(const BenchOptions& options) {
+    const int width = 6000, height = 4000;
+    const double syntheticSigma = 6.0;
+    const double tolerance = 0.10;
+    const double addedSigmas[] = {0.0, 2.0, 5.0, 10.0, 20.0};
+    cv::Mat clean = makeSyntheticImage(width, height, 1);
+    
+    std::cout << "  " << width << "x" << height << " image, noise sigma " << syntheticSigma << " before adding noise" << std::endl;
+    std::cout << "  Added   Total   Estimate   Time (ms)   Kernel   Blur sigma   Threshold" << std::endl;
+    bool passed = true;
+    for (double added : addedSigmas) {
+        cv::Mat noisy = (added > 0) ? addNoise(clean, added, 1) : clean;
+        double expected = std::sqrt(syntheticSigma * syntheticSigma + added * added);
+        
+        NoiseEstimate estimate;
+        double seconds = 0.0;
+        for (int rep = 0; rep < options.repetitions; rep++) {
+            int64 start = cv::getTickCount();
+            if (!estimateNoiseLevel(noisy, estimate)) {
+                return -1;
+            }
+            double elapsed = secondsSince(start);
+            seconds = (rep == 0) ? elapsed : std::min(seconds, elapsed);
+        }
+        
+        bool accurate = std::abs(estimate.noiseSigma - expected) <= tolerance * expected;
+        passed = passed && accurate;
+        std::cout << "  " << std::setw(5) << added << std::setw(8) << expected
+                  << std::setw(11) << estimate.noiseSigma << (accurate ? " " : "!")
+                  << std::setw(11) << seconds * 1000.0
+                  << std::setw(9) << estimate.kernelSize
+                  << std::setw(13) << estimate.gaussianSigma
+                  << std::setw(12) << estimate.sharpenThreshold << std::endl;
+    }
+    
+    std::cout << "  Noise estimate: " << (passed ? "✓ within " : "✗ NOT within ")
+              << tolerance * 100.0 << "% of the total noise" << std::endl;
+    return passed ? 0 : -1;
+}
+
+// ================================================================
+// TRAINING CORPUS
+// ================================================================
+
+/**
+ * Write the synthetic training corpus used by "make pgo"
+ * 
+ * For each image k, clean_k.png holds the synthetic image and
+ * compressed_k.jpg the same image saved at low JPEG quality, so both the
+ * testing and practical modes can be run on it.
+ * 
+ * @param directory Existing directory to write into
+ * @param options Image size (--size)
+ * @return int 0 on success, -1 if an image could not be written
+ */
+int writeTrainingCorpus(const std::string& directory, const BenchOptions& options) {
+    const int corpusImages = 4;
+    const int jpegQuality = 30;
+    
+    for (int i = 1; i <= corpusImages; i++) {
+        cv::Mat clean = makeSyntheticImage(options.width, options.height, i);
+        std::string cleanPath = directory + "/clean_" + std::to_string(i) + ".png";
+        std::string compressedPath = directory + "/compressed_" + std::to_string(i) + ".jpg";
+        
+        std::vector<int> jpegParams;
+        jpegParams.push_back(cv::IMWRITE_JPEG_QUALITY);
+        jpegParams.push_back(jpegQuality);
+        
+        if (!cv::imwrite(cleanPath, clean) || !cv::imwrite(compressedPath, clean, jpegParams)) {
+            std::cerr << "ERROR: Could not write corpus image in '" << directory << "'" << std::endl;
+            return -1;
+        }
+        std::cout << "Wrote " << cleanPath << " and " << compressedPath << std::endl;
+    }
+    
+    return 0;
+}
+
+
+// ================================================================
+// BENCHMARK REGISTRY AND MAIN
+// ================================================================
+
+struct Benchmark {
+    const char* name;
+    const char* description;
+    int (*run)(const BenchOptions&);
+};
+
+const Benchmark benchmarks[] = {
+    {"numa", "Batch enhancement throughput per NUMA node (local vs remote memory)", benchNuma},
+    {"precision", "Float32/integer kernels vs double reference (PSNR within 0.01 dB)", benchPrecision},
+    {"convolution", "Gaussian blur with specialized kernel sizes vs cv::GaussianBlur", benchConvolution},
+    {"pipeline", "End-to-end practical mode (blur, unsharp, PSNR, SSIM) throughput", benchPipeline},
+    {"temporal", "Temporal denoising (with/without block matching) vs Gaussian blur", benchTemporal},
+    {"deblock", "JPEG deblocking (8x8 grid pixels only) vs full-frame Gaussian blur", benchDeblock},
+    {"tiles", "Blur + unsharp mask with flat tiles skipped vs full frame", benchTiles},
+    {"unsharp", "Unsharp mask computed per sample vs looked up in a 256x256 table", benchUnsharpMethods},
+    {"boxblur", "Three-box running-sum Gaussian approximation vs exact blurs", benchBoxBlur},
+    {"tester", "tester.cpp Gaussian passes at Full HD and 8K widths", benchTesterGaussian},
+    {"sharpen", "tester.cpp fixed-point 3x3 sharpen and fused blur + sharpen", benchTesterSharpen},
+    {"median", "Constant-time median filter vs cv::medianBlur for radius 1 to 16", benchMedian},
+    {"nlmeans", "Non-local means (patch sizes 3x3 to 11x11) vs Gaussian and median", benchNonLocalMeans},
+    {"wavelet", "Wavelet shrinkage (integer CDF 5/3 lifting) vs Gaussian blur", benchWavelet},
+    {"fft", "FFT overlap-save vs direct convolution for kernel sizes 15 to 301", benchFFTConvolution},
+    {"pyramid", "Laplacian pyramid enhancement (1 to 5 levels) vs blur + unsharp mask", benchPyramid},
+    {"jbu", "tester.cpp bilateral filter at 1/2 and 1/4 resolution with joint upsampling", benchJointUpsampling},
+    {"graph", "Filter graph with fused pointwise stages in banded passes vs stage by stage", benchFilterGraph},
+    {"ssim", "SSIM formula fused into one loop vs the chain of cv::Mat operations", benchSSIM},
+    {"ssimfp16", "SSIM with FP16 vs float32 moment planes (time and score deviation)", benchSSIMStorage},
+    {"noise", "Tile-sampled noise estimate on 24 MP and the parameters it picks", benchNoiseEstimate},
+};
+
+const int numBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [options] [benchmark ...]" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Benchmarks (all are run if none is given):" << std::endl;
+    for (int i = 0; i < numBenchmarks; i++) {
+        std::cout << "  " << std::left << std::setw(14) << benchmarks[i].name
+                  << benchmarks[i].description << std::endl;
+    }
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --size <w>x<h>  : Synthetic image size (default: 1920x1080)" << std::endl;
+    std::cout << "  --images <n>    : Images per batch (default: 16)" << std::endl;
+    std::cout << "  --reps <n>      : Timed repetitions, best is reported (default: 3)" << std::endl;
+    std::cout << "  --threads <n>   : Number of threads to use (default: one per core)" << std::endl;
+    std::cout << "  --pin-threads   : Pin threads to cores and keep work on one NUMA node" << std::endl;
+    std::cout << "  --make-corpus <dir> : Write the PGO training images to <dir> and exit" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    options.width = 1920;
+    options.height = 1080;
+    options.images = 16;
+    options.repetitions = 3;
+    
+    std::vector<std::string> selected;
+    std::string corpusDirectory;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+        
+        if (arg == "--size" && hasValue) {
+            std::string size = argv[++i];
+            size_t x = size.find('x');
+            if (x == std::string::npos) {
+                std::cerr << "ERROR: --size expects <width>x<height>" << std::endl;
+                return -1;
+            }
+            options.width = std::atoi(size.substr(0, x).c_str());
+            options.height = std::atoi(size.substr(x + 1).c_str());
+        } else if (arg == "--images" && hasValue) {
+            options.images = std::atoi(argv[++i]);
+        } else if (arg == "--reps" && hasValue) {
+            options.repetitions = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            ThreadPool::setThreadCount(std::atoi(argv[++i]));
+        } else if (arg == "--pin-threads") {
+            ThreadPool::setPinThreads(true);
+        } else if (arg == "--make-corpus" && hasValue) {
+            corpusDirectory = argv[++i];
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            return 0;
+        } else {
+            selected.push_back(arg);
+        }
+    }
+    
+    if (options.width <= 0 || options.height <= 0 || options.images <= 0 || options.repetitions <= 0) {
+        std::cerr << "ERROR: Sizes and counts must be positive!" << std::endl;
+        return -1;
+    }
+    
+    // Start the pool from the main thread (pinned in NUMA mode)
+    ThreadPool::instance();
+    
+    if (!corpusDirectory.empty()) {
+        return writeTrainingCorpus(corpusDirectory, options);
+    }
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Image size: " << options.width << " x " << options.height << std::endl;
+    std::cout << "Instruction set: " << isaName(activeIsaLevel())
+              << " (set IMAGE_ENHANCER_ISA to compare variants)" << std::endl << std::endl;
+    
+    int failures = 0;
+    for (int i = 0; i < numBenchmarks; i++) {
+        bool run = selected.empty();
+        for (size_t j = 0; j < selected.size(); j++) {
+            if (selected[j] == benchmarks[i].name) {
+                run = true;
+            }
+        }
+        if (!run) {
+            continue;
+        }
+        
+        std::cout << "========================================" << std::endl;
+        std::cout << benchmarks[i].name << ": " << benchmarks[i].description << std::endl;
+        std::cout << "========================================" << std::endl;
+        if (benchmarks[i].run(options) != 0) {
+            std::cerr << "✗ Benchmark " << benchmarks[i].name << " failed!" << std::endl;
+            failures++;
+        }
+        std::cout << std::endl;
+    }
+    
+    // Report names that do not match any benchmark
+    for (size_t j = 0; j < selected.size(); j++) {
+        bool known = false;
+        for (int i = 0; i < numBenchmarks; i++) {
+            if (selected[j] == benchmarks[i].name) {
+                known = true;
+            }
+        }
+        if (!known) {
+            std::cerr << "ERROR: Unknown benchmark or option '" << selected[j] << "'" << std::endl;
+            failures++;
+        }
+    }
+    
+    return failures == 0 ? 0 : -1;
+}
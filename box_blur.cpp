@@ -0,0 +1,216 @@
+#include "image_quality.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Number of box filters in the cascade
+const int boxPasses = 3;
+
+/**
+ * Three horizontal box passes over one row of floats
+ * 
+ * Each pass slides a running sum along the row: one add and one subtract
+ * per sample, whatever the box width. Sums are kept in double so they do
+ * not drift over long rows. Borders are reflected like BORDER_REFLECT_101.
+ * 
+ * @param row Row of width × channels samples, filtered in place
+ * @param padded Work buffer of at least (width + 2 × largest radius) × channels
+ */
+void boxFilterRow(float* row, std::vector<float>& padded, int width, int channels, const int* widths) {
+    for (int pass = 0; pass < boxPasses; pass++) {
+        const int radius = widths[pass] / 2;
+        if (radius == 0) {
+            continue;
+        }
+        const double scale = 1.0 / widths[pass];
+        
+        // Copy the row into the middle of the padded buffer and reflect the borders
+        std::copy(row, row + width * channels, &padded[radius * channels]);
+        for (int j = 1; j <= radius; j++) {
+            int left = cv::borderInterpolate(-j, width, cv::BORDER_REFLECT_101);
+            int right = cv::borderInterpolate(width - 1 + j, width, cv::BORDER_REFLECT_101);
+            for (int c = 0; c < channels; c++) {
+                padded[(radius - j) * channels + c] = row[left * channels + c];
+                padded[(radius + width - 1 + j) * channels + c] = row[right * channels + c];
+            }
+        }
+        
+        // padded[x] holds pixel x - radius, so the box of output pixel x is
+        // padded[x] to padded[x + 2 × radius]
+        for (int c = 0; c < channels; c++) {
+            double sum = 0.0;
+            for (int k = 0; k < 2 * radius; k++) {
+                sum += padded[k * channels + c];
+            }
+            for (int x = 0; x < width; x++) {
+                sum += padded[(x + 2 * radius) * channels + c];
+                row[x * channels + c] = static_cast<float>(sum * scale);
+                sum -= padded[x * channels + c];
+            }
+        }
+    }
+}
+
+/**
+ * One vertical box pass over the samples [begin, end) of every row
+ * 
+ * A running sum per sample is carried down the columns; each output row
+ * adds the row entering the box and subtracts the row leaving it. The
+ * inner loops run along the row, so they vectorize.
+ * 
+ * @param sums Work buffer of at least end - begin doubles
+ */
+template <typename T>
+void boxFilterColumns(const cv::Mat& input, cv::Mat& output, int width, int begin, int end,
+                      std::vector<double>& sums) {
+    const int radius = width / 2;
+    const double scale = 1.0 / width;
+    const int rows = input.rows;
+    const int length = end - begin;
+    
+    // Sum of the box of row 0 (rows -radius to radius, reflected)
+    std::fill(sums.begin(), sums.begin() + length, 0.0);
+    for (int k = -radius; k <= radius; k++) {
+        const float* src = input.ptr<float>(cv::borderInterpolate(k, rows, cv::BORDER_REFLECT_101)) + begin;
+        for (int i = 0; i < length; i++) {
+            sums[i] += src[i];
+        }
+    }
+    
+    for (int y = 0; y < rows; y++) {
+        T* dst = output.ptr<T>(y) + begin;
+        for (int i = 0; i < length; i++) {
+            dst[i] = cv::saturate_cast<T>(sums[i] * scale);
+        }
+        
+        // Slide the box down one row
+        if (y + 1 < rows) {
+            const float* entering = input.ptr<float>(cv::borderInterpolate(y + 1 + radius, rows, cv::BORDER_REFLECT_101)) + begin;
+            const float* leaving = input.ptr<float>(cv::borderInterpolate(y - radius, rows, cv::BORDER_REFLECT_101)) + begin;
+            for (int i = 0; i < length; i++) {
+                sums[i] += static_cast<double>(entering[i]) - leaving[i];
+            }
+        }
+    }
+}
+
+}
+
+double boxCascadeWidths(double sigma, int widths[3]) {
+    // Widths of n boxes whose cascade has the variance of the Gaussian:
+    // a box of width w has variance (w² - 1) / 12, and variances add up.
+    // All boxes get the largest odd width wl below the ideal width, then m
+    // of them are widened to wl + 2 to get as close as possible to sigma².
+    const int n = boxPasses;
+    double variance = std::max(0.0, sigma) * std::max(0.0, sigma);
+    double idealWidth = std::sqrt(12.0 * variance / n + 1.0);
+    int lower = static_cast<int>(std::floor(idealWidth));
+    if (lower % 2 == 0) {
+        lower--;
+    }
+    lower = std::max(1, lower);
+    int upper = lower + 2;
+    
+    double idealWider = (12.0 * variance - n * lower * lower - 4.0 * n * lower - 3.0 * n) / (-4.0 * lower - 4.0);
+    int narrow = std::min(n, std::max(0, static_cast<int>(std::lround(idealWider))));
+    
+    double achieved = 0.0;
+    for (int i = 0; i < n; i++) {
+        widths[i] = (i < narrow) ? lower : upper;
+        achieved += (widths[i] * widths[i] - 1) / 12.0;
+    }
+    return std::sqrt(achieved);
+}
+
+/**
+ * Approximate a Gaussian blur with a cascade of three box filters
+ * 
+ * By the central limit theorem, repeated box filters converge to a
+ * Gaussian; three boxes of the right widths are within a few percent of
+ * it. Each box is computed with running sums, so the cost per pixel is
+ * constant - about six adds per sample and pass direction - no matter how
+ * large sigma is, while a Gaussian kernel grows with 6 × sigma.
+ * 
+ * The horizontal passes run per row band; the vertical passes carry a
+ * running sum down column strips, so both split over the thread pool.
+ * Intermediate results stay in float, so the three passes do not add
+ * rounding errors.
+ * 
+ * @param input The input image (CV_8U or CV_32F depth, any channel count)
+ * @param output Destination image (must not share data with input)
+ * @param sigma Standard deviation of the Gaussian to approximate
+ * @return bool False if the image is empty or of another depth
+ */
+bool applyBoxBlurCascade(const cv::Mat& input, cv::Mat& output, double sigma) {
+    // Validate input image
+    if (input.empty()) {
+        std::cerr << "Error: Input image cannot be empty!" << std::endl;
+        return false;
+    }
+    if (input.depth() != CV_8U && input.depth() != CV_32F) {
+        std::cerr << "Error: Box blur requires an 8-bit or float image!" << std::endl;
+        return false;
+    }
+    
+    int widths[boxPasses];
+    boxCascadeWidths(sigma, widths);
+    
+    const int width = input.cols;
+    const int channels = input.channels();
+    const int length = width * channels;
+    const int maxRadius = *std::max_element(widths, widths + boxPasses) / 2;
+    
+    // Step 1: all horizontal passes, row by row, into a float image
+    cv::Mat rowsDone(input.rows, length, CV_32F);
+    parallelFor(0, input.rows, [&](int rowBegin, int rowEnd) {
+        std::vector<float> padded((width + 2 * maxRadius) * channels);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            float* row = rowsDone.ptr<float>(y);
+            if (input.depth() == CV_8U) {
+                const unsigned char* src = input.ptr<unsigned char>(y);
+                std::copy(src, src + length, row);
+            } else {
+                const float* src = input.ptr<float>(y);
+                std::copy(src, src + length, row);
+            }
+            boxFilterRow(row, padded, width, channels, widths);
+        }
+    });
+    
+    // Step 2: the vertical passes over column strips, alternating between
+    // two float images; the last pass writes the output type
+    output.create(input.size(), input.type());
+    cv::Mat outputSamples = output.reshape(1, input.rows);
+    cv::Mat columnsDone(input.rows, length, CV_32F);
+    
+    // Strips of 1024 samples keep the running sums in L1 cache
+    const int stripLength = 1024;
+    const int strips = (length + stripLength - 1) / stripLength;
+    
+    cv::Mat* source = &rowsDone;
+    cv::Mat* target = &columnsDone;
+    for (int pass = 0; pass < boxPasses; pass++) {
+        bool last = (pass == boxPasses - 1);
+        parallelFor(0, strips, [&](int stripBegin, int stripEnd) {
+            std::vector<double> sums(stripLength);
+            for (int strip = stripBegin; strip < stripEnd; strip++) {
+                int begin = strip * stripLength;
+                int end = std::min(length, begin + stripLength);
+                if (!last) {
+                    boxFilterColumns<float>(*source, *target, widths[pass], begin, end, sums);
+                } else if (input.depth() == CV_8U) {
+                    boxFilterColumns<unsigned char>(*source, outputSamples, widths[pass], begin, end, sums);
+                } else {
+                    boxFilterColumns<float>(*source, outputSamples, widths[pass], begin, end, sums);
+                }
+            }
+        });
+        std::swap(source, target);
+    }
+    
+    return true;
+}
@@ -0,0 +1,355 @@
+#include "image_enhancer.h"
+#include "image_quality.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <new>
+#include <vector>
+
+/**
+ * Options and work buffers of one enhancement context
+ * 
+ * The intermediate images keep their buffers between calls (create()
+ * reuses a buffer that already fits), like the frame slots of sequence
+ * mode. The final stage writes straight into the caller's output.
+ */
+struct ie_context {
+    ie_options options;
+    std::vector<PyramidLevel> pyramidLevels;
+    
+    cv::Mat deblocked;    // Deblocked input (if enabled)
+    cv::Mat median;       // Median-filtered input (if enabled)
+    cv::Mat nlmDenoised;  // Non-local means denoised input (if enabled)
+    cv::Mat waveletDenoised;  // Wavelet shrinkage denoised input (IE_BLUR_WAVELET)
+    cv::Mat blurred;      // Gaussian blur for the unsharp mask
+    TileActivity tiles;   // Flat tiles (only with a sharpening threshold)
+};
+
+namespace {
+
+// Blur of the unsharp mask, the same as practical mode
+const int gaussianKernelSize = 5;
+const double gaussianSigma = 1.0;
+
+/**
+ * Wrap a caller buffer in a cv::Mat header (no copy)
+ * 
+ * @return ie_status IE_OK if the description is usable, with mat pointing
+ *                   at the caller's pixels
+ */
+ie_status wrapImage(const ie_image* image, cv::Mat& mat) {
+    if (image == nullptr || image->data == nullptr || image->width <= 0 || image->height <= 0) {
+        std::cerr << "Error: Image must have data and a positive size!" << std::endl;
+        return IE_INVALID_ARGUMENT;
+    }
+    
+    int type;
+    switch (image->format) {
+        case IE_PIXEL_GRAY8:
+            type = CV_8UC1;
+            break;
+        case IE_PIXEL_RGB24:
+        case IE_PIXEL_BGR24:
+            type = CV_8UC3;
+            break;
+        default:
+            std::cerr << "Error: Unknown pixel format " << static_cast<int>(image->format) << "!" << std::endl;
+            return IE_UNSUPPORTED_FORMAT;
+    }
+    
+    if (image->stride < static_cast<ptrdiff_t>(image->width) * CV_ELEM_SIZE(type)) {
+        std::cerr << "Error: Image stride is smaller than a row of pixels!" << std::endl;
+        return IE_INVALID_ARGUMENT;
+    }
+    
+    mat = cv::Mat(image->height, image->width, type, image->data, static_cast<size_t>(image->stride));
+    return IE_OK;
+}
+
+/**
+ * Check that two images have the same size and pixel format
+ */
+ie_status checkSameShape(const ie_image* a, const ie_image* b) {
+    if (a->width != b->width || a->height != b->height || a->format != b->format) {
+        std::cerr << "Error: Images must have the same size and pixel format!" << std::endl;
+        return IE_SIZE_MISMATCH;
+    }
+    return IE_OK;
+}
+
+/**
+ * Check that output is either input itself or does not overlap it
+ * 
+ * The filters may run in place, but not on a buffer shifted against
+ * their input.
+ */
+ie_status checkAliasing(const cv::Mat& input, const cv::Mat& output) {
+    const unsigned char* inputEnd = input.ptr<unsigned char>(input.rows - 1) + input.cols * input.elemSize();
+    const unsigned char* outputEnd = output.ptr<unsigned char>(output.rows - 1) + output.cols * output.elemSize();
+    bool overlap = output.data < inputEnd && input.data < outputEnd;
+    if (overlap && (output.data != input.data || output.step != input.step)) {
+        std::cerr << "Error: Output must be the input buffer itself or not overlap it!" << std::endl;
+        return IE_INVALID_ARGUMENT;
+    }
+    return IE_OK;
+}
+
+ie_status checkOptions(const ie_options& options) {
+    if (options.median_radius < 0 || options.nlm_strength < 0 ||
+        options.sharpen_amount < 0 || options.sharpen_threshold < 0) {
+        std::cerr << "Error: Enhancement options cannot be negative!" << std::endl;
+        return IE_INVALID_ARGUMENT;
+    }
+    if (options.blur_method != IE_BLUR_EXACT && options.blur_method != IE_BLUR_BOX_CASCADE &&
+        options.blur_method != IE_BLUR_WAVELET) {
+        std::cerr << "Error: Unknown blur method " << static_cast<int>(options.blur_method) << "!" << std::endl;
+        return IE_INVALID_ARGUMENT;
+    }
+    return IE_OK;
+}
+
+/**
+ * Run the stages of practical mode from input into output
+ */
+ie_status enhance(ie_context& context, const cv::Mat& input, cv::Mat& output) {
+    const ie_options& options = context.options;
+    
+    // Optional clean-up stages, each into its own work buffer; the
+    // sharpening then starts from the result
+    const cv::Mat* base = &input;
+    if (options.deblock) {
+        if (!applyDeblocking(input, context.deblocked, 1.0)) {
+            return IE_FILTER_FAILED;
+        }
+        base = &context.deblocked;
+    }
+    if (options.median_radius > 0) {
+        if (!applyMedianFilter(*base, context.median, options.median_radius)) {
+            return IE_FILTER_FAILED;
+        }
+        base = &context.median;
+    }
+    if (options.nlm_strength > 0) {
+        if (!applyNonLocalMeans(*base, context.nlmDenoised, options.nlm_strength, 2, 5)) {
+            return IE_FILTER_FAILED;
+        }
+        base = &context.nlmDenoised;
+    }
+    if (options.blur_method == IE_BLUR_WAVELET) {
+        if (!applyWaveletDenoise(*base, context.waveletDenoised, 1.0, 3)) {
+            return IE_FILTER_FAILED;
+        }
+        base = &context.waveletDenoised;
+    }
+    
+    // Final stage straight into the caller's buffer (both run in place,
+    // so output may be input)
+    if (options.pyramid) {
+        return applyPyramidEnhance(*base, output, context.pyramidLevels) ? IE_OK : IE_FILTER_FAILED;
+    }
+    
+    BlurMethod blurMethod = options.blur_method == IE_BLUR_BOX_CASCADE ? BLUR_BOX_CASCADE : BLUR_EXACT;
+    const TileActivity* skipTiles = nullptr;
+    if (options.sharpen_threshold > 0 &&
+        findFlatTiles(*base, blurRadius(gaussianKernelSize, gaussianSigma, blurMethod),
+                      options.sharpen_threshold, context.tiles)) {
+        skipTiles = &context.tiles;
+    }
+    applyGaussianBlur(*base, context.blurred, gaussianKernelSize, gaussianSigma, skipTiles, blurMethod);
+    if (!applyUnsharpMask(*base, context.blurred, output, options.sharpen_amount,
+                          options.sharpen_threshold, skipTiles)) {
+        return IE_FILTER_FAILED;
+    }
+    return IE_OK;
+}
+
+/**
+ * Shared part of ie_psnr and ie_ssim
+ */
+template <typename Metric>
+ie_status compareImages(const ie_image* original, const ie_image* compared, double* score, Metric metric) {
+    if (score == nullptr) {
+        std::cerr << "Error: Score pointer cannot be null!" << std::endl;
+        return IE_INVALID_ARGUMENT;
+    }
+    
+    cv::Mat a, b;
+    ie_status status = wrapImage(original, a);
+    if (status == IE_OK) {
+        status = wrapImage(compared, b);
+    }
+    if (status == IE_OK) {
+        status = checkSameShape(original, compared);
+    }
+    if (status != IE_OK) {
+        return status;
+    }
+    
+    // Both metrics return exactly -1 on error (an SSIM can be slightly
+    // negative, but not -1 for real images)
+    double value = metric(a, b);
+    if (value == -1.0) {
+        return IE_FILTER_FAILED;
+    }
+    *score = value;
+    return IE_OK;
+}
+
+/**
+ * Map an exception escaping the library to a status
+ */
+ie_status statusOfException() {
+    try {
+        throw;
+    } catch (const std::bad_alloc&) {
+        std::cerr << "Error: Out of memory!" << std::endl;
+        return IE_OUT_OF_MEMORY;
+    } catch (const cv::Exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return (e.code == cv::Error::StsNoMem) ? IE_OUT_OF_MEMORY : IE_FILTER_FAILED;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return IE_FILTER_FAILED;
+    } catch (...) {
+        return IE_FILTER_FAILED;
+    }
+}
+
+}
+
+int ie_api_version(void) {
+    return IE_API_VERSION;
+}
+
+ie_options ie_default_options(void) {
+    ie_options options;
+    options.deblock = 0;
+    options.median_radius = 0;
+    options.nlm_strength = 0.0;
+    options.sharpen_amount = 1.5;
+    options.sharpen_threshold = 0.0;
+    options.blur_method = IE_BLUR_EXACT;
+    options.pyramid = 0;
+    return options;
+}
+
+void ie_set_thread_count(int threads) {
+    ThreadPool::setThreadCount(threads);
+}
+
+ie_status ie_context_create(const ie_options* options, ie_context** context) {
+    if (context == nullptr) {
+        std::cerr << "Error: Context pointer cannot be null!" << std::endl;
+        return IE_INVALID_ARGUMENT;
+    }
+    *context = nullptr;
+    
+    ie_options settings = (options != nullptr) ? *options : ie_default_options();
+    ie_status status = checkOptions(settings);
+    if (status != IE_OK) {
+        return status;
+    }
+    
+    try {
+        ie_context* created = new ie_context();
+        created->options = settings;
+        created->pyramidLevels = defaultPyramidLevels(settings.sharpen_amount, settings.sharpen_threshold);
+        *context = created;
+        return IE_OK;
+    } catch (...) {
+        return statusOfException();
+    }
+}
+
+void ie_context_destroy(ie_context* context) {
+    delete context;
+}
+
+/**
+ * Enhance a caller-owned image into a caller-owned image
+ * 
+ * Both buffers are wrapped in cv::Mat headers, so the filters read the
+ * input and write the output where the caller keeps them. Only the
+ * intermediate stages use the context's buffers.
+ */
+ie_status ie_enhance(ie_context* context, const ie_image* input, const ie_image* output) {
+    if (context == nullptr) {
+        std::cerr << "Error: Context cannot be null!" << std::endl;
+        return IE_INVALID_ARGUMENT;
+    }
+    
+    try {
+        cv::Mat inputMat, outputMat;
+        ie_status status = wrapImage(input, inputMat);
+        if (status == IE_OK) {
+            status = wrapImage(output, outputMat);
+        }
+        if (status == IE_OK) {
+            status = checkSameShape(input, output);
+        }
+        if (status == IE_OK) {
+            status = checkAliasing(inputMat, outputMat);
+        }
+        if (status != IE_OK) {
+            return status;
+        }
+        
+        status = enhance(*context, inputMat, outputMat);
+        
+        // The filters only call create() on the output with its own size
+        // and type, which keeps the caller's buffer; never hand back a
+        // result that went anywhere else
+        if (status == IE_OK && outputMat.data != static_cast<unsigned char*>(output->data)) {
+            std::cerr << "Error: Enhanced image was not written to the output buffer!" << std::endl;
+            return IE_FILTER_FAILED;
+        }
+        return status;
+    } catch (...) {
+        return statusOfException();
+    }
+}
+
+ie_status ie_psnr(const ie_image* original, const ie_image* compared, double* psnr) {
+    try {
+        return compareImages(original, compared, psnr, calculatePSNR);
+    } catch (...) {
+        return statusOfException();
+    }
+}
+
+ie_status ie_ssim(const ie_image* original, const ie_image* compared, double* ssim) {
+    try {
+        // computeSSIM scores the first channel only, which is blue for BGR
+        // buffers and red for RGB ones; score the blue channel of either,
+        // so the layout does not change the result
+        int blue = (original != nullptr && original->format == IE_PIXEL_RGB24) ? 2 : 0;
+        return compareImages(original, compared, ssim, [blue](const cv::Mat& a, const cv::Mat& b) {
+            if (a.channels() == 1) {
+                return computeSSIM(a, b);
+            }
+            cv::Mat blueA, blueB;
+            cv::extractChannel(a, blueA, blue);
+            cv::extractChannel(b, blueB, blue);
+            return computeSSIM(blueA, blueB);
+        });
+    } catch (...) {
+        return statusOfException();
+    }
+}
+
+const char* ie_status_message(ie_status status) {
+    switch (status) {
+        case IE_OK:
+            return "Success";
+        case IE_INVALID_ARGUMENT:
+            return "Invalid argument";
+        case IE_UNSUPPORTED_FORMAT:
+            return "Unsupported pixel format";
+        case IE_SIZE_MISMATCH:
+            return "Images differ in size or pixel format";
+        case IE_FILTER_FAILED:
+            return "Filter failed";
+        case IE_OUT_OF_MEMORY:
+            return "Out of memory";
+    }
+    return "Unknown status";
+}
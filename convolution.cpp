@@ -0,0 +1,362 @@
+#include "convolution.h"
+#include "cpu_features.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Coefficient tables generated at compile time
+constexpr GaussianTable<3> gaussian3 = makeGaussianTable<3>(0.0);
+constexpr GaussianTable<5> gaussian5 = makeGaussianTable<5>(0.0);
+constexpr GaussianTable<7> gaussian7 = makeGaussianTable<7>(0.0);
+constexpr GaussianTable<9> gaussian9 = makeGaussianTable<9>(0.0);
+constexpr GaussianTable<11> gaussian11 = makeGaussianTable<11>(0.0);
+
+// Enhancement pipeline blur (5x5, sigma 1.0)
+constexpr GaussianTable<5> gaussian5Sigma1 = makeGaussianTable<5>(1.0);
+
+// SSIM window (11x11, sigma 1.5)
+constexpr GaussianTable<11> gaussian11Sigma15 = makeGaussianTable<11>(1.5);
+
+/**
+ * Convolve the output rows [rowBegin, rowEnd), columns [colBegin, colEnd),
+ * with a kernel of size K (K == 0: size read from kernelSize at runtime)
+ * 
+ * Each output row is produced in two steps that stay in cache:
+ *   1. Vertical pass: the kernelSize input rows around it are combined
+ *      into one float row, written into the middle of a padded buffer
+ *      (only the columns the horizontal pass reads)
+ *   2. Horizontal pass: the padded row is convolved into the output row
+ */
+template <int K, typename T>
+FORCE_INLINE void convolveRows(const cv::Mat& input, cv::Mat& output, const float* kernel, int kernelSize,
+                               int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    const int size = (K > 0) ? K : kernelSize;
+    const int radius = size / 2;
+    const int width = input.cols;
+    const int channels = input.channels();
+    
+    // Columns read by the horizontal pass that lie inside the image
+    const int spanBegin = std::max(0, colBegin - radius);
+    const int spanEnd = std::min(width, colEnd + radius);
+    
+    // Work buffers are per band, so they stay in this thread's cache
+    std::vector<float> padded((width + 2 * radius) * channels);
+    std::vector<const T*> srcRows(size);
+    float* rowStart = &padded[radius * channels];
+    
+    for (int y = rowBegin; y < rowEnd; y++) {
+        // Resolve the input rows touched by the kernel (reflect at the borders)
+        for (int k = 0; k < size; k++) {
+            int sourceRow = cv::borderInterpolate(y + k - radius, input.rows, cv::BORDER_REFLECT_101);
+            srcRows[k] = input.ptr<T>(sourceRow) + spanBegin * channels;
+        }
+        
+        convolveVertical<K, T>(&srcRows[0], kernel, rowStart + spanBegin * channels,
+                               (spanEnd - spanBegin) * channels, size);
+        
+        // Fill the left and right borders by reflecting pixels of the row
+        // (only needed when the columns reach the image edges)
+        for (int j = 1; j <= radius; j++) {
+            int left = cv::borderInterpolate(-j, width, cv::BORDER_REFLECT_101);
+            int right = cv::borderInterpolate(width - 1 + j, width, cv::BORDER_REFLECT_101);
+            for (int c = 0; c < channels; c++) {
+                if (colBegin - radius < 0) {
+                    rowStart[-j * channels + c] = rowStart[left * channels + c];
+                }
+                if (colEnd + radius > width) {
+                    rowStart[(width - 1 + j) * channels + c] = rowStart[right * channels + c];
+                }
+            }
+        }
+        
+        convolveHorizontal<K, T>(&padded[colBegin * channels], kernel, output.ptr<T>(y) + colBegin * channels,
+                                 (colEnd - colBegin) * channels, channels, size);
+    }
+}
+
+/**
+ * Pick the specialization matching the kernel size
+ */
+template <typename T>
+FORCE_INLINE void convolveRowsDispatch(const cv::Mat& input, cv::Mat& output, const float* kernel,
+                                       int kernelSize, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    switch (kernelSize) {
+        case 3:  convolveRows<3, T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd); break;
+        case 5:  convolveRows<5, T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd); break;
+        case 7:  convolveRows<7, T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd); break;
+        case 9:  convolveRows<9, T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd); break;
+        case 11: convolveRows<11, T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd); break;
+        default: convolveRows<0, T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd); break;
+    }
+}
+
+typedef void (*ConvolveRowsFn)(const cv::Mat&, cv::Mat&, const float*, int, int, int, int, int);
+
+// One copy of the row loops per instruction set; the FORCE_INLINE bodies
+// above are generated again inside each wrapper with its target
+
+template <typename T>
+void convolveRowsGeneric(const cv::Mat& input, cv::Mat& output, const float* kernel, int kernelSize,
+                         int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    convolveRowsDispatch<T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd);
+}
+
+#if HAVE_ISA_VARIANTS
+template <typename T>
+ISA_TARGET_SSE2 void convolveRowsSSE2(const cv::Mat& input, cv::Mat& output, const float* kernel,
+                                      int kernelSize, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    convolveRowsDispatch<T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd);
+}
+
+template <typename T>
+ISA_TARGET_AVX2 void convolveRowsAVX2(const cv::Mat& input, cv::Mat& output, const float* kernel,
+                                      int kernelSize, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    convolveRowsDispatch<T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd);
+}
+
+template <typename T>
+ISA_TARGET_AVX512 void convolveRowsAVX512(const cv::Mat& input, cv::Mat& output, const float* kernel,
+                                          int kernelSize, int rowBegin, int rowEnd, int colBegin, int colEnd) {
+    convolveRowsDispatch<T>(input, output, kernel, kernelSize, rowBegin, rowEnd, colBegin, colEnd);
+}
+
+template <typename T>
+KernelVariants<ConvolveRowsFn> convolveRowsVariants(const char* name) {
+    KernelVariants<ConvolveRowsFn> variants = {
+        name, convolveRowsGeneric<T>, convolveRowsSSE2<T>, convolveRowsAVX2<T>, convolveRowsAVX512<T>
+    };
+    return variants;
+}
+#else
+template <typename T>
+KernelVariants<ConvolveRowsFn> convolveRowsVariants(const char* name) {
+    KernelVariants<ConvolveRowsFn> variants = {name, convolveRowsGeneric<T>, nullptr, nullptr, nullptr};
+    return variants;
+}
+#endif
+
+// Best variants for this CPU, chosen once at startup
+const ConvolveRowsFn convolveRows8U = selectKernel(convolveRowsVariants<unsigned char>("separable convolution (8-bit)"));
+const ConvolveRowsFn convolveRows32F = selectKernel(convolveRowsVariants<float>("separable convolution (float)"));
+
+// Kernel sizes timed by the FFT crossover measurement; when the FFT path
+// wins at none of them, it is assumed to win from twice the largest
+const int fftCandidateSizes[] = {31, 63, 127, 255};
+const int fftAssumedCrossover = 511;
+
+/**
+ * Time the direct and FFT paths on a 1024x128 color image for growing
+ * kernel sizes and return the first size where the FFT path is faster
+ */
+int measureFFTCrossover() {
+    const int runs = 2;
+    cv::Mat image(128, 1024, CV_8UC3);
+    unsigned int seed = 12345u;
+    for (int y = 0; y < image.rows; y++) {
+        unsigned char* row = image.ptr<unsigned char>(y);
+        for (int i = 0; i < image.cols * 3; i++) {
+            seed = seed * 1103515245u + 12345u;
+            row[i] = static_cast<unsigned char>((i / 48 + y + (seed >> 20)) & 255);
+        }
+    }
+    
+    cv::Mat output(image.size(), image.type());
+    std::ostringstream choice;
+    choice << std::fixed << std::setprecision(2);
+    for (int kernelSize : fftCandidateSizes) {
+        std::vector<float> kernel(kernelSize);
+        computeGaussianWeights(kernelSize, 0.0, &kernel[0]);
+        
+        double directSeconds = 0.0, fftSeconds = 0.0;
+        for (int run = 0; run < runs; run++) {
+            int64 start = cv::getTickCount();
+            convolveSeparableDirect(image, output, &kernel[0], kernelSize);
+            double seconds = (cv::getTickCount() - start) / cv::getTickFrequency();
+            directSeconds = (run == 0) ? seconds : std::min(directSeconds, seconds);
+            
+            start = cv::getTickCount();
+            convolveSeparableFFT(image, output, &kernel[0], kernelSize);
+            seconds = (cv::getTickCount() - start) / cv::getTickFrequency();
+            fftSeconds = (run == 0) ? seconds : std::min(fftSeconds, seconds);
+        }
+        
+        if (fftSeconds < directSeconds) {
+            choice << "FFT from size " << kernelSize << " (direct " << directSeconds * 1e3
+                   << " ms, FFT " << fftSeconds * 1e3 << " ms on 1024x128)";
+            registerKernelChoice("FFT convolution crossover", choice.str());
+            return kernelSize;
+        }
+    }
+    
+    choice << "FFT from size " << fftAssumedCrossover << " (direct faster up to "
+           << fftCandidateSizes[3] << ")";
+    registerKernelChoice("FFT convolution crossover", choice.str());
+    return fftAssumedCrossover;
+}
+
+/**
+ * Copy the flat tiles of the input over the output (FFT path, which
+ * always convolves the whole image)
+ */
+void copyFlatTiles(const cv::Mat& input, cv::Mat& output, const TileActivity& tiles) {
+    const size_t pixelBytes = input.elemSize();
+    for (int ty = 0; ty < tiles.tilesY; ty++) {
+        int y0 = ty * tiles.tileSize;
+        int y1 = std::min(input.rows, y0 + tiles.tileSize);
+        for (int tx = 0; tx < tiles.tilesX; tx++) {
+            if (!tiles.isFlat(tx, ty)) {
+                continue;
+            }
+            int x0 = tx * tiles.tileSize;
+            int x1 = std::min(input.cols, x0 + tiles.tileSize);
+            for (int y = y0; y < y1; y++) {
+                std::memcpy(output.ptr(y) + x0 * pixelBytes, input.ptr(y) + x0 * pixelBytes,
+                            (x1 - x0) * pixelBytes);
+            }
+        }
+    }
+}
+
+}
+
+int fftConvolutionCrossover() {
+    // Measured on first use, so programs that never blur with a large
+    // kernel do not pay for it
+    static const int crossover = measureFFTCrossover();
+    return crossover;
+}
+
+const float* findGaussianTable(int kernelSize, double sigma) {
+    // The default sigma for a size is the sigma <= 0 table of that size
+    if (sigma > 0 && std::abs(sigma - defaultGaussianSigma(kernelSize)) < 1e-12) {
+        sigma = 0.0;
+    }
+    
+    if (sigma <= 0) {
+        switch (kernelSize) {
+            case 3:  return gaussian3.weights;
+            case 5:  return gaussian5.weights;
+            case 7:  return gaussian7.weights;
+            case 9:  return gaussian9.weights;
+            case 11: return gaussian11.weights;
+            default: return nullptr;
+        }
+    }
+    if (kernelSize == 5 && sigma == 1.0) {
+        return gaussian5Sigma1.weights;
+    }
+    if (kernelSize == 11 && sigma == 1.5) {
+        return gaussian11Sigma15.weights;
+    }
+    return nullptr;
+}
+
+void computeGaussianWeights(int kernelSize, double sigma, float* weights) {
+    const float* table = findGaussianTable(kernelSize, sigma);
+    if (table != nullptr) {
+        for (int i = 0; i < kernelSize; i++) {
+            weights[i] = table[i];
+        }
+        return;
+    }
+    
+    if (sigma <= 0) {
+        sigma = defaultGaussianSigma(kernelSize);
+    }
+    
+    // Same formula as the compile-time tables, evaluated at runtime
+    std::vector<double> raw(kernelSize);
+    double sum = 0.0;
+    for (int i = 0; i < kernelSize; i++) {
+        double x = i - kernelSize / 2;
+        raw[i] = std::exp(-(x * x) / (2.0 * sigma * sigma));
+        sum += raw[i];
+    }
+    for (int i = 0; i < kernelSize; i++) {
+        weights[i] = static_cast<float>(raw[i] / sum);
+    }
+}
+
+bool convolveSeparableDirect(const cv::Mat& input, cv::Mat& output, const float* kernel, int kernelSize) {
+    if (input.depth() != CV_8U && input.depth() != CV_32F) {
+        return false;
+    }
+    
+    output.create(input.size(), input.type());
+    ConvolveRowsFn convolveRows = (input.depth() == CV_8U) ? convolveRows8U : convolveRows32F;
+    
+    // Rows of the output are independent; split them over the shared pool
+    parallelFor(0, input.rows, [&](int rowBegin, int rowEnd) {
+        convolveRows(input, output, kernel, kernelSize, rowBegin, rowEnd, 0, input.cols);
+    });
+    return true;
+}
+
+bool convolveSeparable(const cv::Mat& input, cv::Mat& output, const float* kernel, int kernelSize,
+                       const TileActivity* skipTiles) {
+    if (input.depth() != CV_8U && input.depth() != CV_32F) {
+        return false;
+    }
+    
+    // The tile map only applies if it was computed for an image of this size
+    bool useTiles = skipTiles != nullptr && skipTiles->tileSize > 0 &&
+                    skipTiles->tilesX == (input.cols + skipTiles->tileSize - 1) / skipTiles->tileSize &&
+                    skipTiles->tilesY == (input.rows + skipTiles->tileSize - 1) / skipTiles->tileSize;
+    
+    // Very large kernels: the FFT path costs about the same for any size
+    if (kernelSize >= fftMinimumKernelSize && kernelSize >= fftConvolutionCrossover()) {
+        convolveSeparableFFT(input, output, kernel, kernelSize);
+        if (useTiles) {
+            copyFlatTiles(input, output, *skipTiles);
+        }
+        return true;
+    }
+    
+    if (!useTiles) {
+        return convolveSeparableDirect(input, output, kernel, kernelSize);
+    }
+    
+    output.create(input.size(), input.type());
+    ConvolveRowsFn convolveRows = (input.depth() == CV_8U) ? convolveRows8U : convolveRows32F;
+    
+    // One task per tile row: runs of active tiles are convolved together,
+    // flat tiles are copied from the input
+    const int tileSize = skipTiles->tileSize;
+    const size_t pixelBytes = input.elemSize();
+    parallelFor(0, skipTiles->tilesY, [&](int tileRowBegin, int tileRowEnd) {
+        for (int ty = tileRowBegin; ty < tileRowEnd; ty++) {
+            int y0 = ty * tileSize;
+            int y1 = std::min(input.rows, y0 + tileSize);
+            
+            int tx = 0;
+            while (tx < skipTiles->tilesX) {
+                // Extend the run while the tiles have the same state
+                bool flat = skipTiles->isFlat(tx, ty);
+                int runEnd = tx + 1;
+                while (runEnd < skipTiles->tilesX && skipTiles->isFlat(runEnd, ty) == flat) {
+                    runEnd++;
+                }
+                int x0 = tx * tileSize;
+                int x1 = std::min(input.cols, runEnd * tileSize);
+                
+                if (flat) {
+                    for (int y = y0; y < y1; y++) {
+                        std::memcpy(output.ptr(y) + x0 * pixelBytes, input.ptr(y) + x0 * pixelBytes,
+                                    (x1 - x0) * pixelBytes);
+                    }
+                } else {
+                    convolveRows(input, output, kernel, kernelSize, y0, y1, x0, x1);
+                }
+                tx = runEnd;
+            }
+        }
+    });
+    
+    return true;
+}
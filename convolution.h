@@ -0,0 +1,231 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include "cpu_features.h"
+#include "tiles.h"
+#include <opencv2/core.hpp>
+
+/**
+ * Separable convolution kernels specialized at compile time
+ * 
+ * The kernel size is a template parameter, so for the sizes the program
+ * actually uses (3, 5, 7, 9 and 11) the tap loops are fully unrolled and
+ * the pixel loops vectorize. The instantiation with size 0 is the generic
+ * version that reads the size at runtime; the dispatcher falls back to it
+ * for every other kernel size.
+ * 
+ * The row loops are compiled once per instruction set (see cpu_features.h)
+ * and the variant matching the CPU is selected at startup.
+ */
+
+/**
+ * Gaussian coefficient table of a fixed size
+ */
+template <int K>
+struct GaussianTable {
+    float weights[K];
+};
+
+/**
+ * exp(x) evaluated at compile time
+ * 
+ * The argument is halved until it is small, the Taylor series is summed,
+ * and the result is squared back up: exp(x) = exp(x / 2^n)^(2^n).
+ * Accurate to about 1e-15 relative for the arguments used here.
+ */
+constexpr double constexprExp(double x) {
+    int halvings = 0;
+    while (x < -0.5 || x > 0.5) {
+        x /= 2.0;
+        halvings++;
+    }
+    
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 20; n++) {
+        term *= x / n;
+        sum += term;
+    }
+    
+    for (int i = 0; i < halvings; i++) {
+        sum *= sum;
+    }
+    return sum;
+}
+
+/**
+ * Sigma OpenCV uses when none is given (sigma <= 0) for a kernel size
+ */
+constexpr double defaultGaussianSigma(int kernelSize) {
+    return 0.3 * ((kernelSize - 1) * 0.5 - 1) + 0.8;
+}
+
+/**
+ * Build a normalized 1D Gaussian table at compile time
+ * 
+ * @param sigma Standard deviation (<= 0 picks the OpenCV default for K)
+ * @return GaussianTable<K> Weights summing to 1
+ */
+template <int K>
+constexpr GaussianTable<K> makeGaussianTable(double sigma) {
+    GaussianTable<K> table = {};
+    if (sigma <= 0) {
+        sigma = defaultGaussianSigma(K);
+    }
+    
+    double raw[K] = {};
+    double sum = 0.0;
+    for (int i = 0; i < K; i++) {
+        double x = i - K / 2;
+        raw[i] = constexprExp(-(x * x) / (2.0 * sigma * sigma));
+        sum += raw[i];
+    }
+    for (int i = 0; i < K; i++) {
+        table.weights[i] = static_cast<float>(raw[i] / sum);
+    }
+    return table;
+}
+
+/**
+ * Find a compile-time coefficient table for a (size, sigma) pair
+ * 
+ * Tables exist for the default sigma of every specialized size, for the
+ * 5x5 / sigma 1.0 blur of the enhancement pipeline and for the 11x11 /
+ * sigma 1.5 window of SSIM.
+ * 
+ * @param kernelSize Kernel size
+ * @param sigma Standard deviation (<= 0 means the OpenCV default)
+ * @return const float* The table, or nullptr if none matches
+ */
+const float* findGaussianTable(int kernelSize, double sigma);
+
+/**
+ * Compute normalized 1D Gaussian weights
+ * 
+ * Uses a compile-time table when one matches, otherwise computes the
+ * weights at runtime.
+ * 
+ * @param kernelSize Kernel size (odd)
+ * @param sigma Standard deviation (<= 0 means the OpenCV default)
+ * @param weights Output array of kernelSize weights
+ */
+void computeGaussianWeights(int kernelSize, double sigma, float* weights);
+
+/**
+ * Vertical pass of a separable convolution for one output row
+ * 
+ * dst[i] = sum over k of kernel[k] * srcRows[k][i]
+ * 
+ * The K source rows are read in lockstep, so every memory access is
+ * sequential and the pixel loop vectorizes; with K known at compile time
+ * the tap loop is fully unrolled.
+ * 
+ * @param srcRows The kernelSize input rows (already border-resolved)
+ * @param kernel The kernelSize weights
+ * @param dst Output row of floats
+ * @param length Number of samples per row (width × channels)
+ * @param kernelSize Kernel size (only used when K == 0)
+ */
+template <int K, typename T>
+FORCE_INLINE void convolveVertical(const T* const* srcRows, const float* kernel, float* dst,
+                                   int length, int kernelSize) {
+    const int size = (K > 0) ? K : kernelSize;
+    for (int i = 0; i < length; i++) {
+        float sum = 0.0f;
+        for (int k = 0; k < size; k++) {
+            sum += kernel[k] * srcRows[k][i];
+        }
+        dst[i] = sum;
+    }
+}
+
+/**
+ * Horizontal pass of a separable convolution for one row
+ * 
+ * src must hold (kernelSize / 2) border pixels on both sides of the row,
+ * so dst[i] = sum over k of kernel[k] * src[i + k * channels].
+ * 
+ * @param src Padded input row
+ * @param kernel The kernelSize weights
+ * @param dst Output row
+ * @param length Number of samples per row (width × channels)
+ * @param channels Samples per pixel
+ * @param kernelSize Kernel size (only used when K == 0)
+ */
+template <int K, typename T>
+FORCE_INLINE void convolveHorizontal(const float* src, const float* kernel, T* dst,
+                                     int length, int channels, int kernelSize) {
+    const int size = (K > 0) ? K : kernelSize;
+    for (int i = 0; i < length; i++) {
+        float sum = 0.0f;
+        for (int k = 0; k < size; k++) {
+            sum += kernel[k] * src[i + k * channels];
+        }
+        dst[i] = cv::saturate_cast<T>(sum);
+    }
+}
+
+/**
+ * Separable convolution of a whole image with a symmetric 1D kernel
+ * applied along both axes (borders are reflected like OpenCV's
+ * BORDER_REFLECT_101)
+ * 
+ * Dispatches to the specialization for kernel sizes 3, 5, 7, 9 and 11 and
+ * to the generic loop otherwise. Rows are split over the shared thread
+ * pool. Supports 8-bit and 32-bit float images with any channel count.
+ * 
+ * With a tile map, flat tiles are copied from the input instead of being
+ * convolved (see tiles.h); active tiles get exactly the full-image result.
+ * 
+ * Kernels of at least fftConvolutionCrossover() taps go through
+ * convolveSeparableFFT instead.
+ * 
+ * @param input Source image (CV_8U or CV_32F depth)
+ * @param output Destination image (allocated by the function)
+ * @param kernel 1D weights
+ * @param kernelSize Number of weights (odd)
+ * @param skipTiles Optional flat tiles of input to copy through
+ *                  (ignored if it does not match the image size)
+ * @return bool False if the image depth is not supported
+ */
+bool convolveSeparable(const cv::Mat& input, cv::Mat& output, const float* kernel, int kernelSize,
+                       const TileActivity* skipTiles = nullptr);
+
+/**
+ * Separable convolution that always uses the direct loops, whatever the
+ * kernel size (no tiles; used to measure the FFT crossover)
+ */
+bool convolveSeparableDirect(const cv::Mat& input, cv::Mat& output, const float* kernel, int kernelSize);
+
+// Smallest kernel size ever sent to the FFT path (below it the direct
+// loops always win, and the crossover is not measured)
+const int fftMinimumKernelSize = 31;
+
+/**
+ * Separable convolution through the FFT, by overlap-save
+ * 
+ * Same contract and border handling as convolveSeparable without tiles;
+ * the cost per pixel grows with log(kernelSize) instead of kernelSize, so
+ * it wins for very large kernels. Results match the direct path within
+ * float rounding (at most one gray level on 8-bit images).
+ * 
+ * @param input Source image (CV_8U or CV_32F depth)
+ * @param output Destination image (allocated by the function)
+ * @param kernel 1D weights
+ * @param kernelSize Number of weights (odd)
+ * @return bool False if the image depth is not supported
+ */
+bool convolveSeparableFFT(const cv::Mat& input, cv::Mat& output, const float* kernel, int kernelSize);
+
+/**
+ * Kernel size from which convolveSeparable uses the FFT path
+ * 
+ * Measured on this host the first time it is needed, by timing both paths
+ * on a small image for kernel sizes 31, 63, 127 and 255; the result is
+ * listed with the other kernel choices (see registerKernelChoice).
+ * 
+ * @return int The crossover kernel size (at least fftMinimumKernelSize)
+ */
+int fftConvolutionCrossover();
+
+#endif // CONVOLUTION_H
@@ -0,0 +1,147 @@
+#include "cpu_features.h"
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * Kernel name and the variant it selected
+ */
+struct KernelSelection {
+    std::string name;
+    std::string choice;
+};
+
+std::mutex& selectionMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<KernelSelection>& selections() {
+    static std::vector<KernelSelection> list;
+    return list;
+}
+
+/**
+ * Parse the IMAGE_ENHANCER_ISA override (-1 if unset or unknown)
+ */
+int isaOverride() {
+    const char* value = std::getenv("IMAGE_ENHANCER_ISA");
+    if (value == nullptr) {
+        return -1;
+    }
+    for (int level = ISA_GENERIC; level <= ISA_AVX512; level++) {
+        if (std::strcmp(value, isaName(static_cast<IsaLevel>(level))) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+}
+
+IsaLevel detectIsaLevel() {
+#if HAVE_ISA_VARIANTS
+    // __builtin_cpu_supports reads cpuid and also checks (via xgetbv) that
+    // the operating system saves the wide vector registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vl")) {
+        return ISA_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return ISA_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return ISA_SSE2;
+    }
+#endif
+    return ISA_GENERIC;
+}
+
+bool cpuSupportsF16C() {
+#if HAVE_ISA_VARIANTS
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("f16c");
+#else
+    return false;
+#endif
+}
+
+IsaLevel activeIsaLevel() {
+    // Detected once; every kernel sees the same level
+    static const IsaLevel level = [] {
+        IsaLevel detected = detectIsaLevel();
+        int requested = isaOverride();
+        if (requested >= 0 && requested < detected) {
+            return static_cast<IsaLevel>(requested);
+        }
+        return detected;
+    }();
+    return level;
+}
+
+const char* isaName(IsaLevel level) {
+    switch (level) {
+        case ISA_SSE2:   return "sse2";
+        case ISA_AVX2:   return "avx2";
+        case ISA_AVX512: return "avx512";
+        default:         return "generic";
+    }
+}
+
+int registerKernelSelection(const char* name, IsaLevel selected) {
+    return registerKernelChoice(name, isaName(selected));
+}
+
+int registerKernelChoice(const char* name, const std::string& choice) {
+    std::lock_guard<std::mutex> lock(selectionMutex());
+    KernelSelection entry;
+    entry.name = name;
+    entry.choice = choice;
+    selections().push_back(entry);
+    return 0;
+}
+
+void printCpuFeatures(std::ostream& out) {
+    out << "CPU features:" << std::endl;
+#if HAVE_ISA_VARIANTS
+    __builtin_cpu_init();
+    // __builtin_cpu_supports needs a string literal, so list each by name
+    struct Feature {
+        const char* name;
+        bool supported;
+    };
+    const Feature features[] = {
+        {"sse2", __builtin_cpu_supports("sse2") != 0},
+        {"sse4.2", __builtin_cpu_supports("sse4.2") != 0},
+        {"avx", __builtin_cpu_supports("avx") != 0},
+        {"avx2", __builtin_cpu_supports("avx2") != 0},
+        {"fma", __builtin_cpu_supports("fma") != 0},
+        {"avx512f", __builtin_cpu_supports("avx512f") != 0},
+        {"avx512bw", __builtin_cpu_supports("avx512bw") != 0},
+        {"avx512vl", __builtin_cpu_supports("avx512vl") != 0}
+    };
+    for (const Feature& feature : features) {
+        out << "  " << feature.name << ": " << (feature.supported ? "yes" : "no") << std::endl;
+    }
+#else
+    out << "  (no x86 variants compiled for this platform)" << std::endl;
+#endif
+    
+    out << "Detected level: " << isaName(detectIsaLevel()) << std::endl;
+    out << "Active level:   " << isaName(activeIsaLevel());
+    if (isaOverride() >= 0) {
+        out << " (IMAGE_ENHANCER_ISA=" << std::getenv("IMAGE_ENHANCER_ISA") << ")";
+    }
+    out << std::endl;
+    
+    out << "Kernel variants:" << std::endl;
+    std::lock_guard<std::mutex> lock(selectionMutex());
+    for (const KernelSelection& entry : selections()) {
+        out << "  " << entry.name << ": " << entry.choice << std::endl;
+    }
+}
@@ -0,0 +1,147 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include <ostream>
+#include <string>
+
+/**
+ * Runtime CPU feature dispatch
+ * 
+ * Hot kernels are compiled several times in the same binary, once per
+ * instruction set (SSE2, AVX2, AVX-512), using per-function target
+ * attributes. At startup the CPU is queried with cpuid and every kernel
+ * picks the best variant the host supports, so one binary runs the widest
+ * SIMD path available on old and new machines alike.
+ * 
+ * The environment variable IMAGE_ENHANCER_ISA (generic, sse2, avx2 or
+ * avx512) caps the level, e.g. to compare variants on the same host.
+ */
+
+/**
+ * Instruction set levels, from oldest to newest
+ */
+enum IsaLevel {
+    ISA_GENERIC = 0,  // Portable C++ (non-x86 hosts)
+    ISA_SSE2 = 1,     // 128-bit vectors (every x86-64 CPU)
+    ISA_AVX2 = 2,     // 256-bit vectors with FMA (Haswell and later)
+    ISA_AVX512 = 3    // 512-bit vectors with byte/word ops (Skylake-SP and later)
+};
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_ISA_VARIANTS 1
+#define ISA_TARGET_SSE2 __attribute__((target("sse2")))
+#define ISA_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define ISA_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx2,fma")))
+// The generic tuning emulates gathers with scalar loads (hardware gathers
+// are slow on some CPUs); these let table lookups use the instruction,
+// for kernels whose gather variant is timed against an alternative
+#define ISA_TARGET_AVX2_GATHER __attribute__((target("avx2,fma,tune=haswell")))
+#define ISA_TARGET_AVX512_GATHER __attribute__((target("avx512f,avx512bw,avx512vl,avx2,fma,tune=skylake-avx512")))
+// Half-precision conversions; check cpuSupportsF16C() before selecting
+#define ISA_TARGET_AVX2_F16C __attribute__((target("avx2,fma,f16c")))
+#else
+#define HAVE_ISA_VARIANTS 0
+#endif
+
+// Kernel bodies are forced inline into each ISA wrapper, so the compiler
+// generates them again with that wrapper's instruction set
+#if defined(__GNUC__)
+#define FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define FORCE_INLINE inline
+#endif
+
+/**
+ * Highest instruction set supported by this CPU (and its operating system)
+ */
+IsaLevel detectIsaLevel();
+
+/**
+ * Whether the CPU has the F16C half-precision conversions, which the
+ * AVX2 level does not imply
+ */
+bool cpuSupportsF16C();
+
+/**
+ * Instruction set kernels should use: the detected level, capped by
+ * IMAGE_ENHANCER_ISA if it is set
+ */
+IsaLevel activeIsaLevel();
+
+/**
+ * Printable name of an instruction set level
+ */
+const char* isaName(IsaLevel level);
+
+/**
+ * Variants of one kernel, one function pointer per instruction set
+ * (null where a variant is not compiled on this platform)
+ */
+template <typename Fn>
+struct KernelVariants {
+    const char* name;
+    Fn generic;
+    Fn sse2;
+    Fn avx2;
+    Fn avx512;
+    
+    /**
+     * Level of the variant that select() returns on this host
+     */
+    IsaLevel selectedLevel() const {
+        IsaLevel level = activeIsaLevel();
+        if (level >= ISA_AVX512 && avx512) return ISA_AVX512;
+        if (level >= ISA_AVX2 && avx2) return ISA_AVX2;
+        if (level >= ISA_SSE2 && sse2) return ISA_SSE2;
+        return ISA_GENERIC;
+    }
+    
+    /**
+     * Best variant for this host
+     */
+    Fn select() const {
+        switch (selectedLevel()) {
+            case ISA_AVX512: return avx512;
+            case ISA_AVX2:   return avx2;
+            case ISA_SSE2:   return sse2;
+            default:         return generic;
+        }
+    }
+};
+
+/**
+ * Record a kernel for the --cpu-features report
+ * 
+ * @param name Kernel name
+ * @param selected Level of the variant that kernel uses
+ * @return int Always 0 (lets the call initialize a static variable)
+ */
+int registerKernelSelection(const char* name, IsaLevel selected);
+
+/**
+ * Record any other choice made for a kernel at startup (e.g. between two
+ * algorithms) for the --cpu-features report
+ * 
+ * @param name Kernel name
+ * @param choice Description of the choice
+ * @return int Always 0
+ */
+int registerKernelChoice(const char* name, const std::string& choice);
+
+/**
+ * Select the variant of a kernel once and record the choice
+ */
+template <typename Fn>
+Fn selectKernel(const KernelVariants<Fn>& variants) {
+    registerKernelSelection(variants.name, variants.selectedLevel());
+    return variants.select();
+}
+
+/**
+ * Print detected CPU features and the variant chosen for each kernel
+ * 
+ * @param out Stream to print to
+ */
+void printCpuFeatures(std::ostream& out);
+
+#endif // CPU_FEATURES_H
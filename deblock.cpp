@@ -0,0 +1,178 @@
+#include "image_quality.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+// JPEG compresses the image in independent 8x8 blocks
+const int jpegBlockSize = 8;
+
+/**
+ * Thresholds of the deblocking filter, in gray levels
+ */
+struct DeblockThresholds {
+    int edge;      // Steps across the boundary from this size on are real edges
+    int activity;  // Mean curvature per line above which a segment is texture
+    int clip;      // Largest correction of p0/q0 (half of it for p1/q1)
+};
+
+inline int clampInt(int value, int low, int high) {
+    return std::min(high, std::max(low, value));
+}
+
+/**
+ * Filter one segment (up to 8 lines) of a block boundary
+ * 
+ * The samples across the boundary are named
+ *     p2 p1 p0 | q0 q1 q2
+ * with q0 the first sample of the block after the boundary.
+ * 
+ * 1. Activity test for the whole segment: the curvature
+ *    |p2 - 2p1 + p0| + |q2 - 2q1 + q0| measures texture on both sides.
+ *    Blocking is only visible (and only removable) where both blocks are
+ *    smooth, so textured segments are left alone.
+ * 2. Per line, a step |p0 - q0| at or above the edge threshold is a real
+ *    edge of the picture and is left alone.
+ * 3. Otherwise the step is spread over p1 p0 q0 q1, with the corrections
+ *    clipped so the filter can never create new artifacts.
+ * 
+ * @param q0 Pointer to q0 of the first line
+ * @param across Offset between neighbouring samples across the boundary
+ * @param along Offset between lines along the boundary
+ * @param lines Number of lines in the segment
+ * @param t Thresholds
+ */
+void filterSegment(unsigned char* q0, int across, int along, int lines, const DeblockThresholds& t) {
+    // Step 1: activity test over the whole segment
+    int activity = 0;
+    for (int line = 0; line < lines; line++) {
+        const unsigned char* q = q0 + line * along;
+        int p0 = q[-across], p1 = q[-2 * across], p2 = q[-3 * across];
+        int q0v = q[0], q1 = q[across], q2 = q[2 * across];
+        activity += std::abs(p2 - 2 * p1 + p0) + std::abs(q2 - 2 * q1 + q0v);
+    }
+    if (activity >= t.activity * lines) {
+        return;
+    }
+    
+    for (int line = 0; line < lines; line++) {
+        unsigned char* q = q0 + line * along;
+        int p0 = q[-across], p1 = q[-2 * across], p2 = q[-3 * across];
+        int q0v = q[0], q1 = q[across], q2 = q[2 * across];
+        
+        // Step 2: leave real edges alone
+        if (std::abs(q0v - p0) >= t.edge) {
+            continue;
+        }
+        
+        // Step 3: spread the step over the two samples on each side
+        // (the same normal filter as HEVC deblocking)
+        int delta = clampInt((9 * (q0v - p0) - 3 * (q1 - p1) + 8) >> 4, -t.clip, t.clip);
+        int deltaP = clampInt((((p2 + p0 + 1) >> 1) - p1 + delta) >> 1, -t.clip / 2, t.clip / 2);
+        int deltaQ = clampInt((((q2 + q0v + 1) >> 1) - q1 - delta) >> 1, -t.clip / 2, t.clip / 2);
+        
+        q[-across] = static_cast<unsigned char>(clampInt(p0 + delta, 0, 255));
+        q[0] = static_cast<unsigned char>(clampInt(q0v - delta, 0, 255));
+        q[-2 * across] = static_cast<unsigned char>(clampInt(p1 + deltaP, 0, 255));
+        q[across] = static_cast<unsigned char>(clampInt(q1 + deltaQ, 0, 255));
+    }
+}
+
+}
+
+/**
+ * Remove JPEG blocking artifacts
+ * 
+ * JPEG quantizes each 8x8 block on its own, so at low quality the blocks
+ * no longer line up and a grid of small steps appears. Unlike a Gaussian
+ * blur, which filters every pixel, this filter only looks at the 3 pixels
+ * on each side of the 8x8 grid lines and changes at most 2 of them - a
+ * fraction of a full-frame blur, and without softening the inside of the
+ * blocks.
+ * 
+ * Vertical grid lines are filtered first (row bands in parallel), then
+ * horizontal grid lines (one grid line per task). Every channel is
+ * filtered separately.
+ * 
+ * @param input The compressed image (8-bit, any number of channels)
+ * @param output Destination image; its buffer is reused when it already
+ *               has the right size and type (may be input itself)
+ * @param strength Scales all thresholds (1.0 = default, higher removes
+ *                 stronger blocking but may soften more real detail)
+ * @return bool False if the input is empty or not 8-bit
+ */
+bool applyDeblocking(const cv::Mat& input, cv::Mat& output, double strength) {
+    // Validate input image
+    if (input.empty()) {
+        std::cerr << "Error: Input image cannot be empty!" << std::endl;
+        return false;
+    }
+    if (input.depth() != CV_8U) {
+        std::cerr << "Error: Deblocking requires an 8-bit image!" << std::endl;
+        return false;
+    }
+    
+    // The filter changes only a few pixels, so start from a copy and
+    // correct the grid lines in place (no copy when filtering in place)
+    if (output.data != input.data) {
+        input.copyTo(output);
+    }
+    
+    strength = std::max(0.0, strength);
+    DeblockThresholds t;
+    t.edge = static_cast<int>(std::lround(24 * strength));
+    t.activity = static_cast<int>(std::lround(8 * strength));
+    t.clip = std::max(1, static_cast<int>(std::lround(6 * strength)));
+    
+    const int channels = output.channels();
+    const int rowStep = static_cast<int>(output.step);
+    
+    // Vertical grid lines (x = 8, 16, ...): filter across them along each row
+    // A band of 8 rows is one segment per grid line
+    int blockRows = (output.rows + jpegBlockSize - 1) / jpegBlockSize;
+    parallelFor(0, blockRows, [&](int bandBegin, int bandEnd) {
+        for (int band = bandBegin; band < bandEnd; band++) {
+            int y0 = band * jpegBlockSize;
+            int lines = std::min(jpegBlockSize, output.rows - y0);
+            unsigned char* row = output.ptr<unsigned char>(y0);
+            
+            // Three samples are needed on each side of the grid line
+            for (int x = jpegBlockSize; x + 2 < output.cols; x += jpegBlockSize) {
+                for (int c = 0; c < channels; c++) {
+                    filterSegment(row + x * channels + c, channels, rowStep, lines, t);
+                }
+            }
+        }
+    });
+    
+    // Horizontal grid lines (y = 8, 16, ...): filter across them down each column
+    // (the last grid line needs rows y + 1 and y + 2 below it)
+    int gridLines = (output.rows - 3) / jpegBlockSize;
+    parallelFor(1, gridLines + 1, [&](int lineBegin, int lineEnd) {
+        for (int k = lineBegin; k < lineEnd; k++) {
+            int y = k * jpegBlockSize;
+            unsigned char* row = output.ptr<unsigned char>(y);
+            
+            // One segment per 8-pixel block along the grid line
+            for (int x0 = 0; x0 < output.cols; x0 += jpegBlockSize) {
+                int lines = std::min(jpegBlockSize, output.cols - x0);
+                for (int c = 0; c < channels; c++) {
+                    filterSegment(row + x0 * channels + c, rowStep, channels, lines, t);
+                }
+            }
+        }
+    });
+    
+    return true;
+}
+
+cv::Mat applyDeblocking(const cv::Mat& input, double strength) {
+    cv::Mat output;
+    if (!applyDeblocking(input, output, strength)) {
+        return cv::Mat();
+    }
+    return output;
+}
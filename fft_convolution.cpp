@@ -0,0 +1,229 @@
+#include "convolution.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Samples per task of the vertical pass: the columns of a strip are
+// gathered into signals and transformed together
+const int fftColumnStrip = 16;
+
+/**
+ * Spectrum of a kernel for overlap-save convolution
+ * 
+ * Signals are cut into blocks of blockLength samples that overlap by
+ * size - 1; the circular convolution of a block with the kernel is exact
+ * for its last validLength = blockLength - size + 1 samples. Blocks of
+ * about 4 × size keep the overlap small while the transforms stay short,
+ * so the memory used does not depend on the image size.
+ */
+struct FFTKernel {
+    int size;
+    int blockLength;
+    int validLength;
+    std::vector<float> spectrum;  // Packed (CCS) spectrum of the reversed kernel
+};
+
+FFTKernel makeFFTKernel(const float* kernel, int kernelSize) {
+    FFTKernel fftKernel;
+    fftKernel.size = kernelSize;
+    fftKernel.blockLength = cv::getOptimalDFTSize(std::max(64, 4 * kernelSize));
+    fftKernel.validLength = fftKernel.blockLength - kernelSize + 1;
+    
+    // Reversed, so the convolution computes sum of kernel[k] × src[i + k]
+    // like the direct path
+    cv::Mat padded(1, fftKernel.blockLength, CV_32F, cv::Scalar(0));
+    float* taps = padded.ptr<float>(0);
+    for (int k = 0; k < kernelSize; k++) {
+        taps[k] = kernel[kernelSize - 1 - k];
+    }
+    cv::Mat spectrum;
+    cv::dft(padded, spectrum);
+    const float* packed = spectrum.ptr<float>(0);
+    fftKernel.spectrum.assign(packed, packed + fftKernel.blockLength);
+    return fftKernel;
+}
+
+/**
+ * Multiply a packed (CCS) spectrum of n samples by another in place
+ * 
+ * Layout: Re(0), then (Re, Im) pairs, then Re(n / 2) when n is even.
+ */
+void multiplySpectrum(float* a, const float* b, int n) {
+    a[0] *= b[0];
+    const int pairsEnd = (n % 2 == 0) ? n - 1 : n;
+    for (int i = 1; i < pairsEnd; i += 2) {
+        float re = a[i] * b[i] - a[i + 1] * b[i + 1];
+        float im = a[i] * b[i + 1] + a[i + 1] * b[i];
+        a[i] = re;
+        a[i + 1] = im;
+    }
+    if (n % 2 == 0) {
+        a[n - 1] *= b[n - 1];
+    }
+}
+
+/**
+ * Convolve count signals with the kernel by overlap-save
+ * 
+ * Signal s starts at signals + s × signalStride and holds outputLength +
+ * size - 1 samples (already padded with the borders); its outputLength
+ * results go to outputs + s × outputStride. All blocks of all signals
+ * are transformed with one cv::dft call per direction (one block per row).
+ * 
+ * @param blocks Work matrix, reused between calls
+ */
+void convolveSignals(const FFTKernel& fftKernel, const float* signals, int signalStride, int count,
+                     int outputLength, float* outputs, int outputStride, cv::Mat& blocks) {
+    const int n = fftKernel.blockLength;
+    const int valid = fftKernel.validLength;
+    const int inputLength = outputLength + fftKernel.size - 1;
+    const int blocksPerSignal = (outputLength + valid - 1) / valid;
+    
+    blocks.create(count * blocksPerSignal, n, CV_32F);
+    for (int s = 0; s < count; s++) {
+        const float* signal = signals + s * signalStride;
+        for (int b = 0; b < blocksPerSignal; b++) {
+            float* block = blocks.ptr<float>(s * blocksPerSignal + b);
+            int start = b * valid;
+            int available = std::min(n, inputLength - start);
+            std::copy(signal + start, signal + start + available, block);
+            std::fill(block + available, block + n, 0.0f);
+        }
+    }
+    
+    cv::dft(blocks, blocks, cv::DFT_ROWS);
+    for (int r = 0; r < blocks.rows; r++) {
+        multiplySpectrum(blocks.ptr<float>(r), &fftKernel.spectrum[0], n);
+    }
+    cv::dft(blocks, blocks, cv::DFT_INVERSE | cv::DFT_ROWS | cv::DFT_SCALE | cv::DFT_REAL_OUTPUT);
+    
+    // The first size - 1 samples of each block wrapped around; keep the rest
+    for (int s = 0; s < count; s++) {
+        float* output = outputs + s * outputStride;
+        for (int b = 0; b < blocksPerSignal; b++) {
+            const float* block = blocks.ptr<float>(s * blocksPerSignal + b) + fftKernel.size - 1;
+            int start = b * valid;
+            int length = std::min(valid, outputLength - start);
+            std::copy(block, block + length, output + start);
+        }
+    }
+}
+
+/**
+ * Horizontal pass: every row, one signal per channel, into a float image
+ */
+template <typename T>
+void fftHorizontalPass(const cv::Mat& input, cv::Mat& rowsDone, const FFTKernel& fftKernel) {
+    const int width = input.cols;
+    const int channels = input.channels();
+    const int radius = fftKernel.size / 2;
+    const int paddedLength = width + 2 * radius;
+    
+    parallelFor(0, input.rows, [&](int rowBegin, int rowEnd) {
+        std::vector<float> signals(channels * paddedLength);
+        std::vector<float> results(channels * width);
+        cv::Mat blocks;
+        
+        for (int y = rowBegin; y < rowEnd; y++) {
+            // Split the channels and reflect the borders
+            const T* src = input.ptr<T>(y);
+            for (int c = 0; c < channels; c++) {
+                float* signal = &signals[c * paddedLength];
+                for (int i = 0; i < paddedLength; i++) {
+                    int x = i - radius;
+                    if (x < 0 || x >= width) {
+                        x = cv::borderInterpolate(x, width, cv::BORDER_REFLECT_101);
+                    }
+                    signal[i] = src[x * channels + c];
+                }
+            }
+            
+            convolveSignals(fftKernel, &signals[0], paddedLength, channels, width, &results[0], width, blocks);
+            
+            float* dst = rowsDone.ptr<float>(y);
+            for (int c = 0; c < channels; c++) {
+                for (int x = 0; x < width; x++) {
+                    dst[x * channels + c] = results[c * width + x];
+                }
+            }
+        }
+    });
+}
+
+/**
+ * Vertical pass: strips of columns of the float image, one signal per
+ * sample column, into the output type
+ */
+template <typename T>
+void fftVerticalPass(const cv::Mat& rowsDone, cv::Mat& output, const FFTKernel& fftKernel) {
+    const int height = rowsDone.rows;
+    const int length = rowsDone.cols;
+    const int radius = fftKernel.size / 2;
+    const int paddedLength = height + 2 * radius;
+    const int strips = (length + fftColumnStrip - 1) / fftColumnStrip;
+    
+    parallelFor(0, strips, [&](int stripBegin, int stripEnd) {
+        std::vector<float> signals(fftColumnStrip * paddedLength);
+        std::vector<float> results(fftColumnStrip * height);
+        cv::Mat blocks;
+        
+        for (int strip = stripBegin; strip < stripEnd; strip++) {
+            const int begin = strip * fftColumnStrip;
+            const int count = std::min(fftColumnStrip, length - begin);
+            
+            // Gather the columns (rows reflected at the borders)
+            for (int i = 0; i < paddedLength; i++) {
+                int y = cv::borderInterpolate(i - radius, height, cv::BORDER_REFLECT_101);
+                const float* row = rowsDone.ptr<float>(y) + begin;
+                for (int j = 0; j < count; j++) {
+                    signals[j * paddedLength + i] = row[j];
+                }
+            }
+            
+            convolveSignals(fftKernel, &signals[0], paddedLength, count, height, &results[0], height, blocks);
+            
+            for (int y = 0; y < height; y++) {
+                T* dst = output.ptr<T>(y) + begin;
+                for (int j = 0; j < count; j++) {
+                    dst[j] = cv::saturate_cast<T>(results[j * height + y]);
+                }
+            }
+        }
+    });
+}
+
+}
+
+/**
+ * Separable convolution through the FFT
+ * 
+ * Each row and then each column is convolved by overlap-save: the signal
+ * is cut into overlapping blocks of about 4 × kernelSize samples, which
+ * are transformed with cv::dft, multiplied by the kernel spectrum and
+ * transformed back. The cost per sample grows with the logarithm of the
+ * kernel size instead of linearly, and only the blocks of one row or
+ * column strip are in memory at a time (plus one float image between the
+ * two passes). Results are within float rounding of the direct path.
+ */
+bool convolveSeparableFFT(const cv::Mat& input, cv::Mat& output, const float* kernel, int kernelSize) {
+    if (input.depth() != CV_8U && input.depth() != CV_32F) {
+        return false;
+    }
+    
+    FFTKernel fftKernel = makeFFTKernel(kernel, kernelSize);
+    
+    cv::Mat rowsDone(input.rows, input.cols * input.channels(), CV_32F);
+    output.create(input.size(), input.type());
+    cv::Mat outputSamples = output.reshape(1, input.rows);
+    
+    if (input.depth() == CV_8U) {
+        fftHorizontalPass<unsigned char>(input, rowsDone, fftKernel);
+        fftVerticalPass<unsigned char>(rowsDone, outputSamples, fftKernel);
+    } else {
+        fftHorizontalPass<float>(input, rowsDone, fftKernel);
+        fftVerticalPass<float>(rowsDone, outputSamples, fftKernel);
+    }
+    return true;
+}
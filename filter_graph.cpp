@@ -0,0 +1,650 @@
+#include "filter_graph.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+/**
+ * How a stage reads its input (see filter_graph.h)
+ */
+enum StageKind {
+    STAGE_POINTWISE,     // Reads only the same pixel
+    STAGE_NEIGHBORHOOD,  // Reads pixels up to its halo away
+    STAGE_WHOLE_FRAME    // Reads the whole image
+};
+
+/**
+ * Name, parameters and kind of a stage type
+ */
+struct StageSpec {
+    const char* name;
+    int required;        // Parameters that must be given
+    int optional;        // Parameters that may follow, with defaults
+    double defaults[3];  // Defaults of the optional parameters
+    StageKind kind;
+    const char* usage;
+};
+
+const StageSpec stageSpecs[] = {
+    {"deblock", 0, 1, {1.0},           STAGE_NEIGHBORHOOD, "deblock [strength]"},
+    {"median",  1, 0, {},              STAGE_NEIGHBORHOOD, "median <radius>"},
+    {"nlmeans", 1, 2, {2.0, 5.0},      STAGE_NEIGHBORHOOD, "nlmeans <h> [patch] [search]"},
+    {"blur",    2, 0, {},              STAGE_NEIGHBORHOOD, "blur <size> <sigma>"},
+    {"sharpen", 1, 3, {0.0, 5.0, 1.0}, STAGE_NEIGHBORHOOD, "sharpen <amount> [threshold] [size] [sigma]"},
+    {"gain",    1, 0, {},              STAGE_POINTWISE,    "gain <factor>"},
+    {"gamma",   1, 0, {},              STAGE_POINTWISE,    "gamma <exponent>"},
+    {"clamp",   2, 0, {},              STAGE_POINTWISE,    "clamp <low> <high>"},
+    {"gray",    0, 0, {},              STAGE_POINTWISE,    "gray"},
+    {"wavelet", 0, 2, {1.0, 3.0},      STAGE_WHOLE_FRAME,  "wavelet [scale] [levels]"},
+    {"pyramid", 1, 1, {0.0},           STAGE_WHOLE_FRAME,  "pyramid <amount> [threshold]"}
+};
+
+const int numStageSpecs = sizeof(stageSpecs) / sizeof(stageSpecs[0]);
+
+// JPEG block size: deblocking bands must start and end on the 8x8 grid
+const int deblockGrid = 8;
+
+// Target size of the input of one band; together with the intermediate
+// band images of its stages it stays within a per-core L2 cache
+const size_t bandBytes = 256 * 1024;
+
+// Target size of one chunk of rows of a fused pointwise group (L1 cache)
+const size_t pointwiseChunkBytes = 32 * 1024;
+
+const StageSpec* findStageSpec(const std::string& name) {
+    for (int i = 0; i < numStageSpecs; i++) {
+        if (name == stageSpecs[i].name) {
+            return &stageSpecs[i];
+        }
+    }
+    return nullptr;
+}
+
+bool isInteger(double value) {
+    return value == std::floor(value);
+}
+
+/**
+ * Check the parameters of a stage (defaults already filled in)
+ *
+ * @return const char* Description of the problem, or nullptr if valid
+ */
+const char* checkStageParams(const GraphStage& stage) {
+    const std::vector<double>& p = stage.params;
+    const std::string& name = stage.name;
+    if (name == "deblock") {
+        if (p[0] < 0) return "strength must be 0 or more";
+    } else if (name == "median") {
+        if (!isInteger(p[0]) || p[0] < 0 || p[0] > 127) return "radius must be an integer from 0 to 127";
+    } else if (name == "nlmeans") {
+        if (p[0] <= 0) return "h must be positive";
+        if (!isInteger(p[1]) || p[1] < 0 || p[1] > 8) return "patch radius must be an integer from 0 to 8";
+        if (!isInteger(p[2]) || p[2] < 1 || p[2] > 16) return "search radius must be an integer from 1 to 16";
+    } else if (name == "blur" || name == "sharpen") {
+        double size = (name == "blur") ? p[0] : p[2];
+        double sigma = (name == "blur") ? p[1] : p[3];
+        if (!isInteger(size) || size < 1 || static_cast<int>(size) % 2 == 0) return "size must be an odd integer";
+        if (sigma <= 0) return "sigma must be positive";
+        if (name == "sharpen" && p[1] < 0) return "threshold must be 0 or more";
+    } else if (name == "gain") {
+        if (p[0] < 0) return "factor must be 0 or more";
+    } else if (name == "gamma") {
+        if (p[0] <= 0) return "exponent must be positive";
+    } else if (name == "clamp") {
+        if (p[0] < 0 || p[1] > 255 || p[0] > p[1]) return "limits must satisfy 0 <= low <= high <= 255";
+    } else if (name == "wavelet") {
+        if (p[0] < 0) return "scale must be 0 or more";
+        if (!isInteger(p[1]) || p[1] < 1 || p[1] > 6) return "levels must be an integer from 1 to 6";
+    } else if (name == "pyramid") {
+        if (p[1] < 0) return "threshold must be 0 or more";
+    }
+    return nullptr;
+}
+
+/**
+ * Rows a neighborhood stage reads above and below each output row
+ */
+int stageHalo(const GraphStage& stage) {
+    const std::vector<double>& p = stage.params;
+    if (stage.name == "deblock") {
+        // Grid lines are filtered with 3 samples on each side and the
+        // activity test looks at the whole 8-row block
+        return deblockGrid;
+    } else if (stage.name == "median") {
+        return static_cast<int>(p[0]);
+    } else if (stage.name == "nlmeans") {
+        return static_cast<int>(p[1]) + static_cast<int>(p[2]);
+    } else if (stage.name == "blur") {
+        return static_cast<int>(p[0]) / 2;
+    } else if (stage.name == "sharpen") {
+        return static_cast<int>(p[2]) / 2;
+    }
+    return 0;
+}
+
+/**
+ * Run a neighborhood or whole-frame stage on an image
+ *
+ * For sharpen, only its blur is run here; the unsharp mask is applied by
+ * the pointwise group that follows it.
+ */
+bool runFilterStage(const GraphStage& stage, const cv::Mat& input, cv::Mat& output) {
+    const std::vector<double>& p = stage.params;
+    if (stage.name == "deblock") {
+        return applyDeblocking(input, output, p[0]);
+    } else if (stage.name == "median") {
+        return applyMedianFilter(input, output, static_cast<int>(p[0]));
+    } else if (stage.name == "nlmeans") {
+        return applyNonLocalMeans(input, output, p[0], static_cast<int>(p[1]), static_cast<int>(p[2]));
+    } else if (stage.name == "blur" || stage.name == "sharpen") {
+        int size = static_cast<int>(stage.name == "blur" ? p[0] : p[2]);
+        double sigma = (stage.name == "blur") ? p[1] : p[3];
+        applyGaussianBlur(input, output, size, sigma);
+        return !output.empty();
+    } else if (stage.name == "wavelet") {
+        return applyWaveletDenoise(input, output, p[0], static_cast<int>(p[1]));
+    } else if (stage.name == "pyramid") {
+        return applyPyramidEnhance(input, output, defaultPyramidLevels(p[0], p[1]));
+    }
+    return false;
+}
+
+/**
+ * Result of a per-sample stage (gain, gamma, clamp) for every 8-bit value
+ */
+void buildStageTable(const GraphStage& stage, unsigned char table[256]) {
+    const std::vector<double>& p = stage.params;
+    for (int v = 0; v < 256; v++) {
+        double value = v;
+        if (stage.name == "gain") {
+            value = v * p[0];
+        } else if (stage.name == "gamma") {
+            value = 255.0 * std::pow(v / 255.0, p[0]);
+        } else if (stage.name == "clamp") {
+            value = std::min(p[1], std::max(p[0], value));
+        }
+        table[v] = cv::saturate_cast<unsigned char>(value);
+    }
+}
+
+/**
+ * One operation of a fused pointwise group
+ */
+struct PointOp {
+    bool gray;                 // Luma of the color, otherwise a table lookup
+    unsigned char table[256];  // Combined table of a run of gain, gamma and clamp
+    std::string label;         // Stages fused into this operation
+};
+
+/**
+ * One step of a banded pass: an optional neighborhood stage followed by
+ * the pointwise stages that come after it, fused into one row loop
+ */
+struct BandStep {
+    const GraphStage* filter;     // Neighborhood stage, or nullptr
+    int halo;                     // Rows the filter reads around each output row
+    int align;                    // Its input must start and end on multiples of this
+    bool unsharp;                 // Sharpen: unsharp mask of the filter input and its blur
+    double amount, threshold;     // Unsharp mask settings
+    std::vector<PointOp> points;  // Pointwise operations, in order
+};
+
+/**
+ * One pass over the image: a whole-frame stage, or a list of steps
+ * processed band by band
+ */
+struct GraphPass {
+    const GraphStage* wholeFrame;
+    std::vector<BandStep> steps;
+
+    int totalHalo() const {
+        int halo = 0;
+        for (size_t i = 0; i < steps.size(); i++) {
+            halo += steps[i].halo + steps[i].align - 1;
+        }
+        return halo;
+    }
+};
+
+/**
+ * Sort the stages into passes, steps and fused pointwise operations
+ */
+std::vector<GraphPass> planPasses(const std::vector<GraphStage>& stages) {
+    std::vector<GraphPass> passes;
+    for (size_t i = 0; i < stages.size(); i++) {
+        const GraphStage& stage = stages[i];
+        StageKind kind = findStageSpec(stage.name)->kind;
+
+        if (kind == STAGE_WHOLE_FRAME) {
+            GraphPass pass;
+            pass.wholeFrame = &stage;
+            passes.push_back(pass);
+            continue;
+        }
+
+        // Neighborhood and pointwise stages join the current banded pass
+        if (passes.empty() || passes.back().wholeFrame != nullptr) {
+            GraphPass pass;
+            pass.wholeFrame = nullptr;
+            passes.push_back(pass);
+        }
+        std::vector<BandStep>& steps = passes.back().steps;
+
+        // A neighborhood stage starts a new step; pointwise stages join the
+        // last step (or start one without a filter at the beginning)
+        if (kind == STAGE_NEIGHBORHOOD || steps.empty()) {
+            BandStep step;
+            step.filter = (kind == STAGE_NEIGHBORHOOD) ? &stage : nullptr;
+            step.halo = stageHalo(stage);
+            step.align = (stage.name == "deblock") ? deblockGrid : 1;
+            step.unsharp = (stage.name == "sharpen");
+            step.amount = step.unsharp ? stage.params[0] : 0.0;
+            step.threshold = step.unsharp ? stage.params[1] : 0.0;
+            steps.push_back(step);
+        }
+        if (kind != STAGE_POINTWISE) {
+            continue;
+        }
+
+        std::vector<PointOp>& points = steps.back().points;
+        if (stage.name == "gray") {
+            PointOp op;
+            op.gray = true;
+            op.label = "gray";
+            points.push_back(op);
+            continue;
+        }
+
+        // Runs of table stages are composed into one table
+        unsigned char table[256];
+        buildStageTable(stage, table);
+        if (!points.empty() && !points.back().gray) {
+            PointOp& last = points.back();
+            for (int v = 0; v < 256; v++) {
+                last.table[v] = table[last.table[v]];
+            }
+            last.label += " + " + stage.name;
+        } else {
+            PointOp op;
+            op.gray = false;
+            std::memcpy(op.table, table, sizeof(table));
+            op.label = stage.name;
+            points.push_back(op);
+        }
+    }
+    return passes;
+}
+
+/**
+ * Apply one pointwise operation to a row
+ *
+ * @param in Source samples (may be out itself)
+ * @param out Destination samples
+ * @param cols Pixels in the row
+ * @param channels Samples per pixel
+ */
+void applyPointOp(const PointOp& op, const unsigned char* in, unsigned char* out, int cols, int channels) {
+    if (!op.gray) {
+        const int length = cols * channels;
+        for (int i = 0; i < length; i++) {
+            out[i] = op.table[in[i]];
+        }
+        return;
+    }
+
+    // Luma with BGR weights in 8-bit fixed point (0.114, 0.587, 0.299);
+    // images without color are copied
+    if (channels < 3) {
+        if (out != in) {
+            std::memcpy(out, in, static_cast<size_t>(cols) * channels);
+        }
+        return;
+    }
+    for (int x = 0; x < cols; x++) {
+        const unsigned char* pixel = in + x * channels;
+        unsigned char luma = static_cast<unsigned char>((29 * pixel[0] + 150 * pixel[1] + 77 * pixel[2] + 128) >> 8);
+        unsigned char* target = out + x * channels;
+        if (target != pixel) {
+            for (int c = 3; c < channels; c++) {
+                target[c] = pixel[c];
+            }
+        }
+        target[0] = target[1] = target[2] = luma;
+    }
+}
+
+/**
+ * Run the pointwise group of a step in one pass over the rows
+ *
+ * Rows are taken in chunks that fit in the L1 cache; every operation of
+ * the group runs on a chunk before the next chunk is read.
+ *
+ * @param step The step
+ * @param source Rows to map, or the original rows for the unsharp mask
+ * @param blurred Blur of source (unsharp mask only)
+ * @param output Destination rows, same size as source (may be source itself)
+ * @return bool False if the unsharp mask fails
+ */
+bool runPointwise(const BandStep& step, const cv::Mat& source, const cv::Mat& blurred, cv::Mat& output) {
+    const int channels = source.channels();
+    const size_t rowBytes = static_cast<size_t>(source.cols) * channels;
+    const int chunkRows = static_cast<int>(std::max<size_t>(1, pointwiseChunkBytes / rowBytes));
+
+    for (int y0 = 0; y0 < source.rows; y0 += chunkRows) {
+        int y1 = std::min(source.rows, y0 + chunkRows);
+        cv::Mat outChunk = output.rowRange(y0, y1);
+
+        // The first operation reads the source, the others work in place
+        cv::Mat inChunk = source.rowRange(y0, y1);
+        if (step.unsharp) {
+            if (!applyUnsharpMask(inChunk, blurred.rowRange(y0, y1), outChunk, step.amount, step.threshold)) {
+                return false;
+            }
+            inChunk = outChunk;
+        }
+        for (size_t k = 0; k < step.points.size(); k++) {
+            for (int y = 0; y < y1 - y0; y++) {
+                applyPointOp(step.points[k], inChunk.ptr<unsigned char>(y), outChunk.ptr<unsigned char>(y),
+                             source.cols, channels);
+            }
+            inChunk = outChunk;
+        }
+    }
+    return true;
+}
+
+/**
+ * Rows [begin, end) of the image, clipped to [0, rows)
+ */
+struct RowRange {
+    int begin, end;
+};
+
+/**
+ * Run the steps of a banded pass on one band
+ *
+ * The input rows each step needs are worked out backwards from the output
+ * rows: each step needs the rows its successor needs, extended by its own
+ * halo. Going forwards, every filter output is then exact on the rows the
+ * next step reads, and the inexact rows near the band edges are dropped.
+ *
+ * @param pass The banded pass
+ * @param input Input of the pass (whole image)
+ * @param output Output of the pass (whole image)
+ * @param band Output rows of this band
+ * @param buffers Band-sized work images, reused from band to band
+ * @return bool False if a stage fails
+ */
+bool runBand(const GraphPass& pass, const cv::Mat& input, cv::Mat& output, RowRange band,
+             std::vector<cv::Mat>& buffers) {
+    const std::vector<BandStep>& steps = pass.steps;
+    const int n = static_cast<int>(steps.size());
+
+    // needed[k]: rows step k reads; needed[n]: rows of the band
+    std::vector<RowRange> needed(n + 1);
+    needed[n] = band;
+    for (int k = n - 1; k >= 0; k--) {
+        RowRange rows = needed[k + 1];
+        if (steps[k].filter != nullptr) {
+            int align = steps[k].align;
+            rows.begin = std::max(0, (rows.begin - steps[k].halo) / align * align);
+            rows.end = std::min(input.rows, (rows.end + steps[k].halo + align - 1) / align * align);
+        }
+        needed[k] = rows;
+    }
+
+    buffers.resize(2 * n);
+    cv::Mat current = input.rowRange(needed[0].begin, needed[0].end);
+    for (int k = 0; k < n; k++) {
+        const BandStep& step = steps[k];
+        const RowRange in = needed[k];
+        const RowRange out = needed[k + 1];
+        const bool last = (k == n - 1);
+
+        // Rows of the step input that are also its output rows
+        cv::Mat source = current.rowRange(out.begin - in.begin, out.end - in.begin);
+        cv::Mat result;
+        if (step.filter != nullptr) {
+            cv::Mat& filtered = buffers[2 * k];
+            if (!runFilterStage(*step.filter, current, filtered)) {
+                return false;
+            }
+            result = filtered.rowRange(out.begin - in.begin, out.end - in.begin);
+        } else {
+            result = source;
+        }
+
+        if (step.unsharp || !step.points.empty()) {
+            // Write straight into the pass output on the last step; the
+            // pass input and the blur of sharpen must stay unchanged
+            cv::Mat target;
+            if (last) {
+                target = output.rowRange(out.begin, out.end);
+            } else if (step.unsharp || step.filter == nullptr) {
+                buffers[2 * k + 1].create(source.size(), source.type());
+                target = buffers[2 * k + 1];
+            } else {
+                target = result;
+            }
+            if (!runPointwise(step, step.unsharp ? source : result, result, target)) {
+                return false;
+            }
+            result = target;
+        } else if (last) {
+            result.copyTo(output.rowRange(out.begin, out.end));
+        }
+        current = result;
+    }
+    return true;
+}
+
+/**
+ * Rows per band of a banded pass
+ *
+ * About bandBytes of input, and at least four times the halo so the
+ * recomputed halo rows stay a small part of the work; a multiple of the
+ * deblocking grid.
+ */
+int bandRowCount(const GraphPass& pass, int width, int channels) {
+    size_t rowBytes = std::max<size_t>(1, static_cast<size_t>(width) * channels);
+    int rows = static_cast<int>(bandBytes / rowBytes);
+    rows = std::max(rows, std::max(16, 4 * pass.totalHalo()));
+    return (rows + deblockGrid - 1) / deblockGrid * deblockGrid;
+}
+
+/**
+ * Run a banded pass, one band per task on the shared thread pool
+ */
+bool runBandedPass(const GraphPass& pass, const cv::Mat& input, cv::Mat& output) {
+    output.create(input.size(), input.type());
+
+    const int bandRows = bandRowCount(pass, input.cols, input.channels());
+    const int bands = (input.rows + bandRows - 1) / bandRows;
+    std::atomic<bool> ok(true);
+    parallelFor(0, bands, [&](int bandBegin, int bandEnd) {
+        // Work images of this task, reused for each of its bands
+        std::vector<cv::Mat> buffers;
+        for (int b = bandBegin; b < bandEnd; b++) {
+            RowRange band = {b * bandRows, std::min(input.rows, (b + 1) * bandRows)};
+            if (!runBand(pass, input, output, band, buffers)) {
+                ok = false;
+            }
+        }
+    }, 1);
+    return ok.load();
+}
+
+std::string stageText(const GraphStage& stage) {
+    std::ostringstream text;
+    text << stage.name;
+    for (size_t i = 0; i < stage.params.size(); i++) {
+        text << " " << stage.params[i];
+    }
+    return text.str();
+}
+
+}
+
+bool FilterGraph::parse(const std::string& description) {
+    stages.clear();
+    std::vector<GraphStage> parsed;
+
+    std::istringstream lines(description);
+    std::string line;
+    while (std::getline(lines, line)) {
+        // '#' starts a comment; ';' separates stages on one line
+        line = line.substr(0, line.find('#'));
+        std::istringstream entries(line);
+        std::string entry;
+        while (std::getline(entries, entry, ';')) {
+            std::istringstream tokens(entry);
+            GraphStage stage;
+            if (!(tokens >> stage.name)) {
+                continue;
+            }
+
+            const StageSpec* spec = findStageSpec(stage.name);
+            if (spec == nullptr) {
+                std::cerr << "Error: Unknown filter graph stage '" << stage.name << "'!" << std::endl;
+                return false;
+            }
+
+            std::string token;
+            while (tokens >> token) {
+                char* end = nullptr;
+                double value = std::strtod(token.c_str(), &end);
+                if (end == token.c_str() || *end != '\0' || !std::isfinite(value)) {
+                    std::cerr << "Error: Invalid parameter '" << token << "' of stage '" << stage.name
+                              << "' (usage: " << spec->usage << ")!" << std::endl;
+                    return false;
+                }
+                stage.params.push_back(value);
+            }
+
+            int given = static_cast<int>(stage.params.size());
+            if (given < spec->required || given > spec->required + spec->optional) {
+                std::cerr << "Error: Wrong number of parameters for stage '" << stage.name
+                          << "' (usage: " << spec->usage << ")!" << std::endl;
+                return false;
+            }
+            for (int i = given; i < spec->required + spec->optional; i++) {
+                stage.params.push_back(spec->defaults[i - spec->required]);
+            }
+
+            const char* problem = checkStageParams(stage);
+            if (problem != nullptr) {
+                std::cerr << "Error: Stage '" << stage.name << "': " << problem << "!" << std::endl;
+                return false;
+            }
+            parsed.push_back(stage);
+        }
+    }
+
+    if (parsed.empty()) {
+        std::cerr << "Error: Filter graph has no stages!" << std::endl;
+        return false;
+    }
+    stages = parsed;
+    return true;
+}
+
+bool FilterGraph::load(const std::string& source) {
+    std::ifstream file(source.c_str());
+    if (!file) {
+        return parse(source);
+    }
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return parse(contents.str());
+}
+
+/**
+ * Run the stages on an image
+ *
+ * Each pass reads the output of the previous one; whole-frame stages run
+ * on the whole image, the other passes band by band. Only the frames
+ * between passes are full-size intermediate images.
+ */
+bool FilterGraph::run(const cv::Mat& input, cv::Mat& output) const {
+    if (stages.empty()) {
+        std::cerr << "Error: Filter graph has no stages!" << std::endl;
+        return false;
+    }
+    if (input.empty()) {
+        std::cerr << "Error: Input image cannot be empty!" << std::endl;
+        return false;
+    }
+    if (input.depth() != CV_8U) {
+        std::cerr << "Error: Filter graphs require an 8-bit image!" << std::endl;
+        return false;
+    }
+
+    std::vector<GraphPass> passes = planPasses(stages);
+    cv::Mat frames[2];
+    cv::Mat current = input;
+    for (size_t i = 0; i < passes.size(); i++) {
+        // The last pass writes the output; the others alternate between two frames
+        cv::Mat& target = (i + 1 == passes.size()) ? output : frames[i % 2];
+        bool ok = (passes[i].wholeFrame != nullptr) ? runFilterStage(*passes[i].wholeFrame, current, target)
+                                                    : runBandedPass(passes[i], current, target);
+        if (!ok) {
+            std::cerr << "Error: Filter graph pass " << (i + 1) << " failed!" << std::endl;
+            return false;
+        }
+        current = target;
+    }
+    return true;
+}
+
+std::string FilterGraph::describe(int width, int channels, const std::string& indent) const {
+    std::ostringstream text;
+    std::vector<GraphPass> passes = planPasses(stages);
+    for (size_t i = 0; i < passes.size(); i++) {
+        const GraphPass& pass = passes[i];
+        text << indent << "Pass " << (i + 1) << ": ";
+        if (pass.wholeFrame != nullptr) {
+            text << stageText(*pass.wholeFrame) << " (whole frame)" << std::endl;
+            continue;
+        }
+
+        text << "bands of " << bandRowCount(pass, width, channels) << " rows, halo "
+             << pass.totalHalo() << ":";
+        for (size_t k = 0; k < pass.steps.size(); k++) {
+            const BandStep& step = pass.steps[k];
+            text << (k == 0 ? " " : " -> ");
+            if (step.filter != nullptr) {
+                text << (step.unsharp ? "blur of " : "") << stageText(*step.filter);
+            }
+
+            // Fused pointwise group
+            std::vector<std::string> fused;
+            if (step.unsharp) {
+                fused.push_back("unsharp mask");
+            }
+            for (size_t j = 0; j < step.points.size(); j++) {
+                fused.push_back(step.points[j].gray ? std::string("gray")
+                                                    : "table(" + step.points[j].label + ")");
+            }
+            if (!fused.empty()) {
+                text << (step.filter != nullptr ? " + " : "") << "[";
+                for (size_t j = 0; j < fused.size(); j++) {
+                    text << (j > 0 ? ", " : "") << fused[j];
+                }
+                text << "]";
+            }
+        }
+        text << std::endl;
+    }
+    return text.str();
+}
+
+int FilterGraph::passCount() const {
+    return static_cast<int>(planPasses(stages).size());
+}
@@ -0,0 +1,118 @@
+#ifndef FILTER_GRAPH_H
+#define FILTER_GRAPH_H
+
+#include "image_quality.h"
+#include <string>
+#include <vector>
+
+/**
+ * Declarative enhancement pipelines
+ *
+ * A filter graph is a list of stages written as text, one stage per line
+ * or separated by ';', each a name followed by its numeric parameters
+ * ('#' starts a comment):
+ *
+ *     deblock; median 1; sharpen 1.5 4; clamp 16 235
+ *
+ * Stages and their parameters ([] = optional, with its default):
+ *   deblock [strength 1]              Remove JPEG 8x8 blocking
+ *   median <radius>                   Median filter (impulse noise)
+ *   nlmeans <h> [patch 2] [search 5]  Non-local means denoising
+ *   blur <size> <sigma>               Gaussian blur
+ *   sharpen <amount> [threshold 0] [size 5] [sigma 1]
+ *                                     Gaussian blur + unsharp mask
+ *   gain <factor>                     Multiply every sample
+ *   gamma <exponent>                  255 × (sample / 255)^exponent
+ *   clamp <low> <high>                Limit samples to [low, high]
+ *   gray                              Replace the color by its luma (BGR
+ *                                     weights; the channel count is kept)
+ *   wavelet [scale 1] [levels 3]      Wavelet shrinkage denoising
+ *   pyramid <amount> [threshold 0]    Laplacian pyramid enhancement
+ *
+ * The graph engine sorts the stages into three kinds and plans the passes
+ * over the image accordingly:
+ *   - Pointwise stages (the unsharp mask of sharpen, gain, gamma, clamp,
+ *     gray) only read the same pixel. Adjacent ones are fused into one row
+ *     loop, and runs of gain, gamma and clamp into one 256-entry table.
+ *   - Neighborhood stages (deblock, median, nlmeans, blur and the blur of
+ *     sharpen) read pixels up to a known distance (their halo). The image
+ *     is processed in bands of rows that fit in the cache: each band is
+ *     extended by the sum of the halos of its stages, so every stage of
+ *     the band reads exact inputs, and the intermediate images only ever
+ *     hold one band.
+ *   - Whole-frame stages (wavelet, pyramid) look at the whole image and
+ *     end a banded pass.
+ *
+ * So adding pointwise or neighborhood stages adds work on data that is
+ * already in the cache, not another pass over the frame in memory. The
+ * result is identical to running the stages one after the other on
+ * whole images (blurs large enough for the FFT path, see
+ * convolveSeparable, may differ by one gray level).
+ */
+
+/**
+ * One stage of a filter graph, as parsed
+ */
+struct GraphStage {
+    std::string name;            // Stage name (deblock, median, ...)
+    std::vector<double> params;  // Parameters, with the defaults filled in
+};
+
+/**
+ * Enhancement pipeline built from a text description
+ *
+ * A graph is not changed by run(), so one graph can enhance several
+ * images concurrently (batch mode).
+ */
+class FilterGraph {
+public:
+    /**
+     * Replace the stages with those of a description
+     *
+     * @param description Stage list (see above)
+     * @return bool False if a stage is unknown or has invalid parameters
+     *              (an error is printed and the graph is left empty)
+     */
+    bool parse(const std::string& description);
+
+    /**
+     * Parse the file at source if there is one, otherwise source itself
+     *
+     * @param source Path of a description file, or a description
+     * @return bool False if the description is invalid
+     */
+    bool load(const std::string& source);
+
+    /**
+     * Run the stages on an image
+     *
+     * @param input The input image (8-bit, any number of channels)
+     * @param output Destination image (must not share data with input)
+     * @return bool False if the graph is empty or a stage fails
+     */
+    bool run(const cv::Mat& input, cv::Mat& output) const;
+
+    /**
+     * Execution plan: one line per pass over the image, with the stages it
+     * runs, the fused pointwise groups and the band height for an image of
+     * the given width and channel count
+     * 
+     * @param indent Prefix of every line
+     */
+    std::string describe(int width, int channels, const std::string& indent = "") const;
+
+    /**
+     * Number of passes over the whole frame (banded passes plus
+     * whole-frame stages)
+     */
+    int passCount() const;
+
+    const std::vector<GraphStage>& stageList() const {
+        return stages;
+    }
+
+private:
+    std::vector<GraphStage> stages;
+};
+
+#endif // FILTER_GRAPH_H
@@ -0,0 +1,182 @@
+#ifndef IMAGE_ENHANCER_H
+#define IMAGE_ENHANCER_H
+
+/**
+ * C interface of the enhancement library (libimage_enhancer.so)
+ * 
+ * Lets another program enhance and score images in its own process: the
+ * caller passes pointers to its pixel buffers with their dimensions,
+ * strides and pixel formats, and the library reads and writes them in
+ * place. Nothing is copied in or out, no file is read or written and no
+ * process is started.
+ * 
+ * Only plain C types cross this interface, and no C++ exception leaves
+ * it: every failure is reported as an ie_status. Functions print the same
+ * error messages to stderr as the program.
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define IE_EXPORT __declspec(dllexport)
+#else
+#define IE_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Version of this interface, raised whenever it changes incompatibly
+ */
+#define IE_API_VERSION 1
+
+/**
+ * Result of every call that can fail
+ */
+typedef enum {
+    IE_OK = 0,
+    IE_INVALID_ARGUMENT = 1,     // Null pointer, bad dimensions, stride or option
+    IE_UNSUPPORTED_FORMAT = 2,   // Unknown pixel format
+    IE_SIZE_MISMATCH = 3,        // Two images differ in size or format
+    IE_FILTER_FAILED = 4,        // A filter rejected the image or its settings
+    IE_OUT_OF_MEMORY = 5         // A work buffer could not be allocated
+} ie_status;
+
+/**
+ * Pixel layout of a caller buffer (8 bits per sample, channels interleaved)
+ * 
+ * The filters treat every channel alike, so RGB and BGR buffers give the
+ * same enhanced pixels; input and output must still have the same format.
+ * ie_psnr averages all channels, and ie_ssim scores the blue channel of
+ * either layout, so neither depends on the channel order.
+ */
+typedef enum {
+    IE_PIXEL_GRAY8 = 0,
+    IE_PIXEL_RGB24 = 1,
+    IE_PIXEL_BGR24 = 2
+} ie_pixel_format;
+
+/**
+ * Image in a caller-owned buffer
+ * 
+ * Row y starts at (unsigned char*)data + y × stride; stride is in bytes and
+ * at least width × the bytes per pixel of the format (so padded rows and
+ * views into larger images can be passed as they are).
+ */
+typedef struct {
+    void* data;
+    int width;
+    int height;
+    ptrdiff_t stride;
+    ie_pixel_format format;
+} ie_image;
+
+/**
+ * How the sharpening blur is computed (see BlurMethod in image_quality.h)
+ * 
+ * IE_BLUR_WAVELET denoises by wavelet shrinkage first, then sharpens the
+ * result with the exact Gaussian blur, like --wavelet.
+ */
+typedef enum {
+    IE_BLUR_EXACT = 0,
+    IE_BLUR_BOX_CASCADE = 1,
+    IE_BLUR_WAVELET = 2
+} ie_blur_method;
+
+/**
+ * Stages of the enhancement, the same as the options of practical mode
+ * 
+ * Start from ie_default_options and change the fields needed.
+ */
+typedef struct {
+    int deblock;               // Non-zero: remove JPEG blocking first (--deblock)
+    int median_radius;         // Median filter radius, 0 = off (--median)
+    double nlm_strength;       // Non-local means strength h, 0 = off (--nlmeans)
+    double sharpen_amount;     // Unsharp mask amount (1.5)
+    double sharpen_threshold;  // Unsharp mask threshold; above 0, flat tiles are skipped (--threshold)
+    ie_blur_method blur_method;  // Blur of the unsharp mask (--fast-blur), or wavelet pre-pass (--wavelet)
+    int pyramid;               // Non-zero: Laplacian pyramid instead of the unsharp mask (--pyramid)
+} ie_options;
+
+/**
+ * Enhancement context: the options and the work buffers of the stages
+ * 
+ * The buffers are kept between calls, so enhancing frames of one size
+ * allocates nothing after the first frame. A context must not be used by
+ * two threads at once; separate contexts can be used concurrently.
+ */
+typedef struct ie_context ie_context;
+
+/**
+ * @return int IE_API_VERSION of the library (compare with the header's)
+ */
+IE_EXPORT int ie_api_version(void);
+
+/**
+ * @return ie_options The settings of practical mode without options
+ */
+IE_EXPORT ie_options ie_default_options(void);
+
+/**
+ * Set the number of threads the filters use (workers + calling thread)
+ * 
+ * Only takes effect before the first image is enhanced or scored: the
+ * shared thread pool is started then and keeps its size.
+ * 
+ * @param threads Total threads (<= 0 means one per hardware core)
+ */
+IE_EXPORT void ie_set_thread_count(int threads);
+
+/**
+ * Create a context with a copy of the options
+ * 
+ * @param options Stages to run (NULL for ie_default_options)
+ * @param context Receives the new context (NULL on failure)
+ * @return ie_status IE_INVALID_ARGUMENT for options out of range
+ */
+IE_EXPORT ie_status ie_context_create(const ie_options* options, ie_context** context);
+
+/**
+ * Free a context and its work buffers (NULL is ignored)
+ */
+IE_EXPORT void ie_context_destroy(ie_context* context);
+
+/**
+ * Enhance an image
+ * 
+ * The input is read and the output written in place. Both must have the
+ * same size and format; they may be the same buffer.
+ * 
+ * @return ie_status IE_OK once the whole output is written
+ */
+IE_EXPORT ie_status ie_enhance(ie_context* context, const ie_image* input, const ie_image* output);
+
+/**
+ * PSNR between two images of the same size and format
+ * 
+ * @param psnr Receives the PSNR in dB
+ */
+IE_EXPORT ie_status ie_psnr(const ie_image* original, const ie_image* compared, double* psnr);
+
+/**
+ * SSIM between two images of the same size and format
+ * 
+ * Color images are scored on their blue channel (the first channel of the
+ * BGR images the command-line program reads), whichever the layout.
+ * 
+ * @param ssim Receives the SSIM (1.0 for identical images)
+ */
+IE_EXPORT ie_status ie_ssim(const ie_image* original, const ie_image* compared, double* ssim);
+
+/**
+ * @return const char* A static English description of a status
+ */
+IE_EXPORT const char* ie_status_message(ie_status status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IMAGE_ENHANCER_H
@@ -4,6 +4,8 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
+#include "tiles.h"
+#include <vector>
 
 /**
  * Calculate the Peak Signal-to-Noise Ratio (PSNR) between two images
@@ -11,6 +13,10 @@
  * PSNR is a metric used to measure the quality of a reconstructed image
  * compared to the original. Higher PSNR values indicate better quality.
  * 
+ * 8-bit and 16-bit images are compared with exact integer arithmetic;
+ * other types use float32 differences (within 0.01 dB of a double
+ * computation, see the 'precision' benchmark).
+ * 
  * @param original The original reference image
  * @param compressed The compressed or modified image to compare
  * @return double The PSNR value in decibels (dB), or -1 if calculation fails
@@ -31,6 +37,36 @@ double calculatePSNR(const cv::Mat& original, const cv::Mat& compressed);
  */
 double computeSSIM(const cv::Mat& imageA, const cv::Mat& imageB);
 
+/**
+ * How computeSSIM stores its five Gaussian-filtered moment planes
+ * 
+ * The moments are computed and the formula is evaluated in float32. FP16
+ * storage halves the memory and bandwidth of the moment planes (F16C
+ * conversions on x86) and blurs band by band from the 8-bit images, so no
+ * full-frame float32 copy of them is built either, for very large images;
+ * the score typically moves by less than 1e-4.
+ */
+enum SSIMStorage {
+    SSIM_STORAGE_FLOAT32,  // Float32 planes (default)
+    SSIM_STORAGE_FLOAT16,  // Half-precision moment planes
+    SSIM_STORAGE_VALIDATE  // Both; prints the deviation and returns the FP16 score
+};
+
+/**
+ * Choose the moment storage of computeSSIM for the whole program
+ */
+void setSSIMStorage(SSIMStorage storage);
+
+/**
+ * Storage computeSSIM currently uses
+ */
+SSIMStorage activeSSIMStorage();
+
+/**
+ * Printable name of an SSIM storage mode
+ */
+const char* ssimStorageName(SSIMStorage storage);
+
 /**
  * Apply Gaussian blur to an image
  * 
@@ -44,6 +80,106 @@ double computeSSIM(const cv::Mat& imageA, const cv::Mat& imageB);
  */
 cv::Mat applyGaussianBlur(const cv::Mat& input, int kernelSize, double sigma);
 
+/**
+ * How applyGaussianBlur computes the blur
+ */
+enum BlurMethod {
+    BLUR_EXACT,        // Convolution with the exact Gaussian weights
+    BLUR_BOX_CASCADE   // Three running-sum box filters (constant cost for any sigma)
+};
+
+/**
+ * Printable name of a blur method
+ */
+const char* blurMethodName(BlurMethod method);
+
+/**
+ * How far the blur reaches: the radius of the Gaussian kernel, or the sum
+ * of the box radii of the cascade (its support can be wider than the
+ * kernel it replaces)
+ * 
+ * This is the margin findFlatTiles needs for the tile skip to be exact.
+ */
+int blurRadius(int kernelSize, double sigma, BlurMethod method);
+
+/**
+ * Apply Gaussian blur into an existing image buffer
+ * 
+ * Same as above, but writes into output and reuses its memory when it
+ * already has the right size and type (e.g. one buffer per video frame).
+ * 
+ * With skipTiles, the flat tiles found by findFlatTiles are copied from
+ * the input instead of blurred. The result is then only meant to be passed
+ * to applyUnsharpMask with the same tiles, which leaves those tiles
+ * unchanged anyway. The box cascade processes every tile.
+ * 
+ * @param input The input image to blur
+ * @param output Destination image (must not share data with input)
+ * @param kernelSize The size of the Gaussian kernel (must be odd, e.g., 5, 7, 11);
+ *                   not used by the box cascade
+ * @param sigma The standard deviation of the Gaussian distribution
+ * @param skipTiles Optional flat tiles of input to copy through
+ * @param method Exact Gaussian or box cascade approximation (8-bit and
+ *               float images); other types always use the exact blur
+ */
+void applyGaussianBlur(const cv::Mat& input, cv::Mat& output, int kernelSize, double sigma,
+                       const TileActivity* skipTiles = nullptr, BlurMethod method = BLUR_EXACT);
+
+/**
+ * Approximate a Gaussian blur with three successive box filters
+ * 
+ * Every box is computed with running sums, so the cost per pixel does not
+ * depend on sigma. The box widths are chosen from sigma (see
+ * boxCascadeWidths); the result is close to, but not exactly, a Gaussian
+ * blur - the 'boxblur' benchmark reports the difference.
+ * 
+ * @param input The input image (8-bit or float, any number of channels)
+ * @param output Destination image (must not share data with input)
+ * @param sigma The standard deviation of the Gaussian to approximate
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool applyBoxBlurCascade(const cv::Mat& input, cv::Mat& output, double sigma);
+
+/**
+ * Box widths of the cascade approximating a Gaussian
+ * 
+ * Three odd widths whose combined variance is as close as possible to
+ * sigma² (a box of width w has variance (w² - 1) / 12).
+ * 
+ * @param sigma Standard deviation of the Gaussian
+ * @param widths Receives the three box widths
+ * @return double Standard deviation the cascade actually has
+ */
+double boxCascadeWidths(double sigma, int widths[3]);
+
+/**
+ * Denoise an image by wavelet shrinkage
+ * 
+ * The image is decomposed with the integer CDF 5/3 wavelet (lossless JPEG
+ * 2000 lifting), every detail coefficient is shrunk towards zero by a
+ * threshold proportional to the noise level, which is estimated from the
+ * image itself, and the image is transformed back. Noise is removed while
+ * edges, which produce large coefficients, are kept. Runs in linear time
+ * on a single integer plane.
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param thresholdScale Threshold in noise standard deviations (about 1 to 2)
+ * @param levels Decomposition levels, 1 to 6
+ * @return cv::Mat The denoised image (empty on error)
+ */
+cv::Mat applyWaveletDenoise(const cv::Mat& input, double thresholdScale = 1.0, int levels = 3);
+
+/**
+ * Wavelet shrinkage denoising into an existing image buffer
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param output Destination image (may be input itself)
+ * @param thresholdScale Threshold in noise standard deviations
+ * @param levels Decomposition levels, 1 to 6
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool applyWaveletDenoise(const cv::Mat& input, cv::Mat& output, double thresholdScale, int levels);
+
 /**
  * Apply unsharp masking filter to sharpen an image
  * 
@@ -52,6 +188,16 @@ cv::Mat applyGaussianBlur(const cv::Mat& input, int kernelSize, double sigma);
  * 
  * Formula: output = original + amount * (original - blurred)
  * 
+ * Works on 8-bit images with any number of channels. The detail and the
+ * threshold test use exact integers and the multiply-add uses float32;
+ * results match the double formula exactly when amount is representable
+ * in float (e.g. 1.5) and otherwise differ by at most one gray level.
+ * 
+ * Because each result only depends on the two input bytes, the results
+ * can also be read from a 256 x 256 table built once per (amount,
+ * threshold) pair; the faster of the two methods is measured on first use
+ * (see UnsharpMethod).
+ * 
  * @param original The original input image
  * @param blurred The Gaussian-blurred version of the original
  * @param amount Sharpening strength (typical values: 0.5 to 2.5)
@@ -61,6 +207,202 @@ cv::Mat applyGaussianBlur(const cv::Mat& input, int kernelSize, double sigma);
 cv::Mat applyUnsharpMask(const cv::Mat& original, const cv::Mat& blurred, 
                          double amount = 1.5, double threshold = 0.0);
 
+/**
+ * Apply unsharp masking into an existing image buffer
+ * 
+ * Same as above, but writes into output and reuses its memory when it
+ * already has the right size and type. output may be original itself.
+ * 
+ * With skipTiles (found by findFlatTiles with the same threshold), flat
+ * tiles are copied from original; the result is identical to sharpening
+ * every pixel.
+ * 
+ * @param original The original input image
+ * @param blurred The Gaussian-blurred version of the original
+ * @param output Destination image
+ * @param amount Sharpening strength (typical values: 0.5 to 2.5)
+ * @param threshold Minimum difference for sharpening (reduces noise amplification)
+ * @param skipTiles Optional flat tiles of original to copy through
+ * @return bool False if the inputs are invalid (an error is printed)
+ */
+bool applyUnsharpMask(const cv::Mat& original, const cv::Mat& blurred, cv::Mat& output,
+                      double amount, double threshold, const TileActivity* skipTiles = nullptr);
+
+/**
+ * How applyUnsharpMask computes its 8-bit results
+ */
+enum UnsharpMethod {
+    UNSHARP_AUTO,        // Whichever of the two is faster on this host (timed on first use)
+    UNSHARP_ARITHMETIC,  // Compute every sample (vectorized arithmetic)
+    UNSHARP_TABLE        // Look every sample up in a 256 x 256 table of results
+};
+
+/**
+ * Force an unsharp mask method for the whole program (e.g. to compare
+ * them); UNSHARP_AUTO restores the automatic choice. Both methods give
+ * identical results.
+ */
+void setUnsharpMethod(UnsharpMethod method);
+
+/**
+ * Method applyUnsharpMask currently uses (never UNSHARP_AUTO)
+ */
+UnsharpMethod activeUnsharpMethod();
+
+/**
+ * Printable name of an unsharp mask method
+ */
+const char* unsharpMethodName(UnsharpMethod method);
+
+/**
+ * Remove JPEG blocking artifacts
+ * 
+ * Only the pixels next to the 8x8 JPEG block grid are examined and
+ * corrected. Each boundary segment is skipped when the blocks around it
+ * are textured, and each line is skipped when the step across it is a
+ * real edge, so the cost is a fraction of a full-frame blur. Meant to run
+ * before sharpening, so the block edges are not amplified.
+ * 
+ * @param input The compressed image (8-bit, any number of channels)
+ * @param strength Scales the filter thresholds (1.0 = default)
+ * @return cv::Mat The deblocked image
+ */
+cv::Mat applyDeblocking(const cv::Mat& input, double strength = 1.0);
+
+/**
+ * Remove JPEG blocking artifacts into an existing image buffer
+ * 
+ * @param input The compressed image (8-bit, any number of channels)
+ * @param output Destination image (may be input itself)
+ * @param strength Scales the filter thresholds (1.0 = default)
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool applyDeblocking(const cv::Mat& input, cv::Mat& output, double strength);
+
+/**
+ * Remove impulse (salt-and-pepper) noise with a median filter
+ * 
+ * Each sample becomes the median of its channel over the (2 × radius + 1)²
+ * window around it, so isolated outliers are removed instead of smeared
+ * like a Gaussian blur does. Histogram-based: the cost per pixel does not
+ * grow with the radius. Meant to run before the blur and unsharp mask.
+ * Results are identical to cv::medianBlur (replicated borders).
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param radius Window radius, 0 to 127
+ * @return cv::Mat The filtered image (empty on error)
+ */
+cv::Mat applyMedianFilter(const cv::Mat& input, int radius);
+
+/**
+ * Median filter into an existing image buffer
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param output Destination image (must not share data with input)
+ * @param radius Window radius, 0 to 127 (0 copies the image)
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool applyMedianFilter(const cv::Mat& input, cv::Mat& output, int radius);
+
+/**
+ * Denoise an image with non-local means
+ * 
+ * Each pixel becomes an average of the pixels in a search window around
+ * it, weighted by how similar the patches around them are, so repeated
+ * structure is averaged with other copies of itself and stays sharp.
+ * Patch distances are box sums over whole rows (summed-area tables in
+ * separable form): the cost per pixel grows with the search window but
+ * not with the patch size. Meant to run before the unsharp mask on
+ * heavily compressed or noisy inputs.
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param h Filter strength, about the noise standard deviation in gray levels
+ * @param patchRadius Patch radius (0 to 8; 2 = 5x5 patches)
+ * @param searchRadius Search window radius (1 to 16; 5 = 11x11 window)
+ * @return cv::Mat The denoised image (empty on error)
+ */
+cv::Mat applyNonLocalMeans(const cv::Mat& input, double h, int patchRadius = 2, int searchRadius = 5);
+
+/**
+ * Non-local means into an existing image buffer
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param output Destination image (must not share data with input)
+ * @param h Filter strength, about the noise standard deviation in gray levels
+ * @param patchRadius Patch radius (0 to 8)
+ * @param searchRadius Search window radius (1 to 16)
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool applyNonLocalMeans(const cv::Mat& input, cv::Mat& output, double h, int patchRadius, int searchRadius);
+
+/**
+ * Gain and threshold of one detail level of applyPyramidEnhance
+ */
+struct PyramidLevel {
+    double gain;       // Detail multiplier (1.0 keeps the level as it is)
+    double threshold;  // Detail up to this size (gray levels) is not boosted
+};
+
+/**
+ * Default pyramid settings for an unsharp mask amount and threshold
+ * 
+ * Three levels (fine, mid-scale and coarse detail); the fine level, which
+ * holds most of the noise, gets twice the threshold, and the coarse level
+ * half the gain.
+ */
+std::vector<PyramidLevel> defaultPyramidLevels(double amount, double threshold);
+
+/**
+ * Enhance detail at several scales with a Laplacian pyramid
+ * 
+ * The image is decomposed once with the 5-tap Burt-Adelson kernel; the
+ * detail of each scale is boosted with its own gain and threshold and the
+ * image is rebuilt. Replaces the blur and unsharp mask when fine noise
+ * and mid-scale structure need different settings, at about the cost of
+ * one unsharp mask pass.
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param levels Gain and threshold per level, finest first (1 to 8 levels)
+ * @return cv::Mat The enhanced image (empty on error)
+ */
+cv::Mat applyPyramidEnhance(const cv::Mat& input,
+                            const std::vector<PyramidLevel>& levels = defaultPyramidLevels(1.5, 0.0));
+
+/**
+ * Laplacian pyramid enhancement into an existing image buffer
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param output Destination image (may be input itself)
+ * @param levels Gain and threshold per level, finest first (1 to 8 levels)
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool applyPyramidEnhance(const cv::Mat& input, cv::Mat& output, const std::vector<PyramidLevel>& levels);
+
+/**
+ * Noise level of an image and the enhancement parameters derived from it
+ */
+struct NoiseEstimate {
+    double noiseSigma;         // Estimated noise standard deviation (gray levels)
+    int tilesSampled;          // Number of tiles the estimate was taken from
+    int kernelSize;            // Gaussian kernel size for the blur (odd)
+    double gaussianSigma;      // Gaussian sigma for the blur
+    double sharpenThreshold;   // Unsharp mask threshold (gray levels)
+};
+
+/**
+ * Estimate the noise level of an image and pick the filter parameters
+ *
+ * Samples at most 256 small tiles whatever the image size and takes a
+ * robust (median) noise estimate from the high-pass residual of each, so
+ * the parameters come in one pass instead of a parameter search. Takes a
+ * few milliseconds on a 24 MP image.
+ *
+ * @param image The image (8-bit, any number of channels)
+ * @param estimate Receives the noise level and the derived parameters
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool estimateNoiseLevel(const cv::Mat& image, NoiseEstimate& estimate);
+
 /**
  * Calculate composite quality score
  * 
@@ -1,8 +1,14 @@
 #include "image_quality.h"
+#include "cpu_features.h"
+#include "filter_graph.h"
+#include "sequence.h"
+#include "thread_pool.h"
 #include <opencv2/imgcodecs.hpp>
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <vector>
+#include <cstdlib>
 
 /**
  * IMAGE QUALITY ENHANCEMENT AND EVALUATION PROGRAM
@@ -21,20 +27,268 @@
  *   - Enhances the image
  *   - Compares enhanced to original compressed
  *   - Outputs the enhanced image
+ * 
+ * BATCH MODE:
+ *   - Takes any number of compressed/degraded images
+ *   - Enhances them concurrently on the shared thread pool
+ *   - Outputs one enhanced image per input
+ * 
+ * SEQUENCE MODE:
+ *   - Takes a video file or a numbered image sequence (and optionally a
+ *     clean reference sequence)
+ *   - Decodes, enhances and encodes frames in a pipeline
+ *   - Reports per-frame latency, PSNR and SSIM, and the sustained FPS
  */
 
 void printUsage(const char* programName) {
     std::cout << "Usage:" << std::endl;
     std::cout << "  TESTING MODE:   " << programName << " --test <clean_image> <compressed_image>" << std::endl;
     std::cout << "  PRACTICAL MODE: " << programName << " --practical <compressed_image>" << std::endl;
+    std::cout << "  BATCH MODE:     " << programName << " --batch <image1> [image2 ...]" << std::endl;
+    std::cout << "  SEQUENCE MODE:  " << programName << " --sequence <video_or_pattern> [reference]" << std::endl;
     std::cout << std::endl;
     std::cout << "Modes:" << std::endl;
     std::cout << "  --test      : Compare compressed vs clean, then enhanced vs clean" << std::endl;
     std::cout << "  --practical : Enhance image and compare to original compressed" << std::endl;
+    std::cout << "  --batch     : Enhance several images concurrently" << std::endl;
+    std::cout << "  --sequence  : Enhance every frame of a video or numbered image sequence" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --threads <n>    : Number of threads to use (default: one per core)" << std::endl;
+    std::cout << "  --pin-threads    : Pin threads to cores and keep each image on one NUMA node" << std::endl;
+    std::cout << "  --threshold <t>  : Only sharpen details of at least t gray levels; flat tiles are skipped" << std::endl;
+    std::cout << "  --fast-blur      : Approximate the Gaussian blur with three box filters (every mode)" << std::endl;
+    std::cout << "  --wavelet        : Denoise by wavelet shrinkage before the blur and sharpening (every mode)" << std::endl;
+    std::cout << "  --pyramid        : Enhance fine and mid-scale detail with a Laplacian pyramid (image modes)" << std::endl;
+    std::cout << "  --deblock        : Remove JPEG 8x8 blocking before enhancing (every mode)" << std::endl;
+    std::cout << "  --median <r>     : Remove salt-and-pepper noise with a median of radius r first (every mode)" << std::endl;
+    std::cout << "  --nlmeans <h>    : Denoise with non-local means of strength h first (every mode)" << std::endl;
+    std::cout << "  --auto           : Pick the blur and threshold from the estimated noise level (image modes)" << std::endl;
+    std::cout << "  --graph <g>      : Run the stages of a filter graph (file or \"stage; stage\") instead (image modes)" << std::endl;
+    std::cout << "  --temporal       : Sequence mode: denoise each frame with the previous frames" << std::endl;
+    std::cout << "  --block-matching : Sequence mode: temporal denoise with motion compensation" << std::endl;
+    std::cout << "  --ssim-fp16      : Store the SSIM moment planes in half precision (very large images)" << std::endl;
+    std::cout << "  --ssim-validate  : Like --ssim-fp16, and print each score's deviation from float32" << std::endl;
+    std::cout << "  --cpu-features   : Print the CPU features found and the kernel variants chosen, then exit" << std::endl;
     std::cout << std::endl;
     std::cout << "Examples:" << std::endl;
     std::cout << "  " << programName << " --test original.jpg compressed.jpg" << std::endl;
     std::cout << "  " << programName << " --practical noisy_image.jpg" << std::endl;
+    std::cout << "  " << programName << " --batch frame1.jpg frame2.jpg frame3.jpg" << std::endl;
+    std::cout << "  " << programName << " --auto --practical noisy_image.jpg" << std::endl;
+    std::cout << "  " << programName << " --graph \"deblock; median 1; sharpen 1.5 4; clamp 16 235\" --practical scan.jpg" << std::endl;
+    std::cout << "  " << programName << " --sequence frames/frame_%04d.png clean/frame_%04d.png" << std::endl;
+}
+
+/**
+ * Pick the blur and unsharp mask threshold from the image's noise (--auto)
+ * 
+ * One noise estimate on a sample of tiles replaces a parameter search.
+ * 
+ * @param verbose Print the estimate and the parameters chosen
+ * @return bool False if the noise could not be estimated (an error is printed)
+ */
+bool autoConfigureFilters(const cv::Mat& image, bool verbose, int& kernelSize, double& sigma,
+                          double& threshold) {
+    NoiseEstimate estimate;
+    if (!estimateNoiseLevel(image, estimate)) {
+        std::cerr << "ERROR: Noise estimation failed!" << std::endl;
+        return false;
+    }
+    kernelSize = estimate.kernelSize;
+    sigma = estimate.gaussianSigma;
+    threshold = estimate.sharpenThreshold;
+    if (verbose) {
+        std::cout << "  Auto: Estimated noise " << std::fixed << std::setprecision(2) << estimate.noiseSigma
+                  << " gray levels (" << estimate.tilesSampled << " tiles sampled) -> blur sigma "
+                  << sigma << ", threshold " << threshold
+                  << std::defaultfloat << std::setprecision(6) << std::endl;
+    }
+    return true;
+}
+
+/**
+ * Enhancement settings of the image modes (testing, practical and batch)
+ */
+struct ImageModeOptions {
+    bool deblock;              // Remove JPEG blocking first
+    int medianRadius;          // Median filter radius against impulse noise (0 = off)
+    double nlmStrength;        // Non-local means strength h before sharpening (0 = off)
+    bool waveletDenoise;       // Wavelet shrinkage denoising before sharpening
+    double sharpenThreshold;   // Unsharp mask threshold; above 0, flat tiles are skipped
+    BlurMethod blurMethod;     // Exact Gaussian blur or box cascade approximation
+    bool pyramid;              // Laplacian pyramid instead of the blur and unsharp mask
+    bool autoConfigure;        // Blur and threshold from the estimated noise level
+    const FilterGraph* graph;  // Stages to run instead of the chain above, or nullptr
+};
+
+/**
+ * Blur and unsharp mask settings an image was enhanced with
+ */
+struct FilterSettings {
+    int kernelSize;    // Gaussian kernel size
+    double sigma;      // Gaussian sigma
+    double amount;     // Unsharp mask amount
+    double threshold;  // Unsharp mask threshold
+};
+
+/**
+ * Enhance one image with the chain chosen by the options
+ * 
+ * Optional deblocking, median filter, non-local means and wavelet
+ * denoising, then Gaussian blur followed by unsharp masking (or the
+ * Laplacian pyramid, or the stages of the filter graph). Shared by the
+ * testing, practical and batch modes.
+ * 
+ * @param image The image to enhance
+ * @param options Enhancement settings
+ * @param verbose Print each step (batch mode runs quietly)
+ * @param enhanced Receives the enhanced image
+ * @param blurred Receives the blurred image (blur and unsharp mask only)
+ * @param settings Receives the blur and unsharp mask settings used
+ * @return bool False if a step fails (an error is printed)
+ */
+bool enhanceImage(const cv::Mat& image, const ImageModeOptions& options, bool verbose,
+                  cv::Mat& enhanced, cv::Mat& blurred, FilterSettings& settings) {
+    // Optionally remove JPEG blocking first, so the sharpening below does
+    // not amplify the block edges (only pixels next to the 8x8 grid change)
+    cv::Mat sourceImage = image;
+    if (options.deblock) {
+        if (verbose) {
+            std::cout << "  Pre-pass: Removing JPEG blocking (8x8 block edges only)..." << std::endl;
+        }
+        sourceImage = applyDeblocking(image);
+        if (sourceImage.empty()) {
+            std::cerr << "ERROR: Deblocking failed!" << std::endl;
+            return false;
+        }
+    }
+    
+    // Optionally remove salt-and-pepper noise, which the Gaussian blur
+    // would only smear and the unsharp mask would then amplify
+    if (options.medianRadius > 0) {
+        if (verbose) {
+            std::cout << "  Pre-pass: Removing impulse noise (median, radius " << options.medianRadius << ")..." << std::endl;
+        }
+        sourceImage = applyMedianFilter(sourceImage, options.medianRadius);
+        if (sourceImage.empty()) {
+            std::cerr << "ERROR: Median filter failed!" << std::endl;
+            return false;
+        }
+    }
+    
+    // Optionally denoise with non-local means (5x5 patches, 11x11 search
+    // window), which removes much more noise than the blur below alone
+    if (options.nlmStrength > 0) {
+        if (verbose) {
+            std::cout << "  Pre-pass: Non-local means denoising (h = " << options.nlmStrength << ")..." << std::endl;
+        }
+        sourceImage = applyNonLocalMeans(sourceImage, options.nlmStrength);
+        if (sourceImage.empty()) {
+            std::cerr << "ERROR: Non-local means denoising failed!" << std::endl;
+            return false;
+        }
+    }
+    
+    // Optionally denoise by wavelet shrinkage (CDF 5/3, 3 levels), which
+    // keeps edges; the blur and unsharp mask then sharpen the denoised image
+    if (options.waveletDenoise) {
+        if (verbose) {
+            std::cout << "  Pre-pass: Wavelet shrinkage denoising (3 levels)..." << std::endl;
+        }
+        sourceImage = applyWaveletDenoise(sourceImage);
+        if (sourceImage.empty()) {
+            std::cerr << "ERROR: Wavelet denoising failed!" << std::endl;
+            return false;
+        }
+    }
+    
+    settings.kernelSize = 5;
+    settings.sigma = 1.0;
+    settings.amount = 1.5;
+    settings.threshold = options.sharpenThreshold;
+    
+    // Optionally derive the blur and threshold from the noise left after
+    // the pre-passes instead of the fixed settings
+    if (options.autoConfigure &&
+        !autoConfigureFilters(sourceImage, verbose, settings.kernelSize, settings.sigma, settings.threshold)) {
+        return false;
+    }
+    
+    const FilterGraph* graph = options.graph;
+    if (graph != nullptr) {
+        // The stages of the filter graph run instead of the chain; pointwise
+        // stages are fused and neighborhood stages run in cache-sized bands
+        if (verbose) {
+            std::cout << "  [1/1] Running filter graph (" << graph->stageList().size() << " stages, "
+                      << graph->passCount() << " pass(es) over the image)..." << std::endl;
+            std::cout << graph->describe(sourceImage.cols, sourceImage.channels(), "    ");
+        }
+        if (!graph->run(sourceImage, enhanced)) {
+            std::cerr << "ERROR: Filter graph failed!" << std::endl;
+            return false;
+        }
+    } else if (options.pyramid) {
+        // Fine and mid-scale detail enhanced in one pass, each with its own
+        // gain and threshold, instead of the blur and unsharp mask
+        std::vector<PyramidLevel> levels = defaultPyramidLevels(settings.amount, settings.threshold);
+        if (verbose) {
+            std::cout << "  [1/1] Applying Laplacian pyramid enhancement (" << levels.size() << " detail levels)..." << std::endl;
+        }
+        if (!applyPyramidEnhance(sourceImage, enhanced, levels)) {
+            std::cerr << "ERROR: Pyramid enhancement failed!" << std::endl;
+            return false;
+        }
+    } else {
+        // With a sharpening threshold, find the flat tiles (no detail above the
+        // threshold): both filters copy them through instead of filtering them
+        TileActivity tiles;
+        const TileActivity* skipTiles = nullptr;
+        if (settings.threshold > 0) {
+            if (verbose) {
+                std::cout << "  Pre-pass: Finding flat tiles (" << defaultTileSize << "x" << defaultTileSize << ")..." << std::endl;
+            }
+            int margin = blurRadius(settings.kernelSize, settings.sigma, options.blurMethod);
+            if (!findFlatTiles(sourceImage, margin, settings.threshold, tiles)) {
+                std::cerr << "ERROR: Tile activity prepass failed!" << std::endl;
+                return false;
+            }
+            skipTiles = &tiles;
+            if (verbose) {
+                std::cout << "    " << tiles.flatCount() << " of " << tiles.flat.size() << " tiles flat ("
+                          << std::fixed << std::setprecision(1) << 100.0 * tiles.skipRatio() << "% skipped)"
+                          << std::defaultfloat << std::setprecision(6) << std::endl;
+            }
+        }
+        
+        // Apply Gaussian Blur for noise reduction
+        if (verbose) {
+            std::cout << "  [1/2] Applying Gaussian blur (noise reduction"
+                      << (options.blurMethod != BLUR_EXACT ? std::string(", ") + blurMethodName(options.blurMethod) : "")
+                      << ")..." << std::endl;
+        }
+        applyGaussianBlur(sourceImage, blurred, settings.kernelSize, settings.sigma, skipTiles, options.blurMethod);
+        
+        if (blurred.empty()) {
+            std::cerr << "ERROR: Gaussian blur failed!" << std::endl;
+            return false;
+        }
+        
+        // Apply Unsharp Masking for sharpness enhancement
+        if (verbose) {
+            std::cout << "  [2/2] Applying unsharp mask (sharpness enhancement)..." << std::endl;
+        }
+        if (!applyUnsharpMask(sourceImage, blurred, enhanced, settings.amount, settings.threshold, skipTiles)) {
+            enhanced = cv::Mat();
+        }
+        
+        if (enhanced.empty()) {
+            std::cerr << "ERROR: Unsharp masking failed!" << std::endl;
+            return false;
+        }
+    }
+    
+    return true;
 }
 
 /**
@@ -43,7 +297,8 @@ void printUsage(const char* programName) {
  * Evaluates the enhancement algorithm by comparing against a clean reference.
  * This mode proves that the enhancement improves image quality.
  */
-int runTestingMode(const std::string& cleanImagePath, const std::string& compressedImagePath) {
+int runTestingMode(const std::string& cleanImagePath, const std::string& compressedImagePath,
+                   const ImageModeOptions& options) {
     std::cout << "========================================" << std::endl;
     std::cout << "TESTING MODE" << std::endl;
     std::cout << "========================================" << std::endl << std::endl;
@@ -124,26 +379,10 @@ int runTestingMode(const std::string& cleanImagePath, const std::string& compres
     
     std::cout << "Applying enhancement filters to compressed image..." << std::endl;
     
-    // Apply Gaussian Blur for noise reduction
-    std::cout << "  [1/2] Applying Gaussian blur (noise reduction)..." << std::endl;
-    int gaussianKernelSize = 5;
-    double gaussianSigma = 1.0;
-    cv::Mat blurredImage = applyGaussianBlur(compressedImage, gaussianKernelSize, gaussianSigma);
-    
-    if (blurredImage.empty()) {
-        std::cerr << "ERROR: Gaussian blur failed!" << std::endl;
-        return -1;
-    }
-    
-    // Apply Unsharp Masking for sharpness enhancement
-    std::cout << "  [2/2] Applying unsharp mask (sharpness enhancement)..." << std::endl;
-    double sharpenAmount = 1.5;
-    double sharpenThreshold = 0.0;
-    cv::Mat enhancedImage = applyUnsharpMask(compressedImage, blurredImage, 
-                                             sharpenAmount, sharpenThreshold);
-    
-    if (enhancedImage.empty()) {
-        std::cerr << "ERROR: Unsharp masking failed!" << std::endl;
+    cv::Mat enhancedImage;
+    cv::Mat blurredImage;
+    FilterSettings settings;
+    if (!enhanceImage(compressedImage, options, true, enhancedImage, blurredImage, settings)) {
         return -1;
     }
     
@@ -237,7 +476,7 @@ int runTestingMode(const std::string& cleanImagePath, const std::string& compres
  * Enhances a compressed/degraded image and compares the result
  * to the original compressed version.
  */
-int runPracticalMode(const std::string& compressedImagePath) {
+int runPracticalMode(const std::string& compressedImagePath, const ImageModeOptions& options) {
     std::cout << "========================================" << std::endl;
     std::cout << "PRACTICAL MODE" << std::endl;
     std::cout << "========================================" << std::endl << std::endl;
@@ -269,36 +508,22 @@ int runPracticalMode(const std::string& compressedImagePath) {
     
     std::cout << "Applying enhancement filters..." << std::endl;
     
-    // Apply Gaussian Blur for noise reduction
-    std::cout << "  [1/2] Applying Gaussian blur (noise reduction)..." << std::endl;
-    int gaussianKernelSize = 5;
-    double gaussianSigma = 1.0;
-    cv::Mat blurredImage = applyGaussianBlur(compressedImage, gaussianKernelSize, gaussianSigma);
-    
-    if (blurredImage.empty()) {
-        std::cerr << "ERROR: Gaussian blur failed!" << std::endl;
-        return -1;
-    }
-    
-    // Apply Unsharp Masking for sharpness enhancement
-    std::cout << "  [2/2] Applying unsharp mask (sharpness enhancement)..." << std::endl;
-    double sharpenAmount = 1.5;
-    double sharpenThreshold = 0.0;
-    cv::Mat enhancedImage = applyUnsharpMask(compressedImage, blurredImage, 
-                                             sharpenAmount, sharpenThreshold);
-    
-    if (enhancedImage.empty()) {
-        std::cerr << "ERROR: Unsharp masking failed!" << std::endl;
+    cv::Mat enhancedImage;
+    cv::Mat blurredImage;
+    FilterSettings settings;
+    if (!enhanceImage(compressedImage, options, true, enhancedImage, blurredImage, settings)) {
         return -1;
     }
     
     std::cout << "✓ Enhancement complete!" << std::endl << std::endl;
     
-    // Save processed images
-    cv::imwrite("output_blurred.jpg", blurredImage);
-    cv::imwrite("output_enhanced.jpg", enhancedImage);
+    // Save processed images (no blurred image with the pyramid)
     std::cout << "✓ Saved processed images:" << std::endl;
-    std::cout << "  - output_blurred.jpg (after Gaussian blur)" << std::endl;
+    if (!blurredImage.empty()) {
+        cv::imwrite("output_blurred.jpg", blurredImage);
+        std::cout << "  - output_blurred.jpg (after Gaussian blur)" << std::endl;
+    }
+    cv::imwrite("output_enhanced.jpg", enhancedImage);
     std::cout << "  - output_enhanced.jpg (final enhanced image)" << std::endl << std::endl;
     
     
@@ -376,12 +601,38 @@ int runPracticalMode(const std::string& compressedImagePath) {
     
     std::cout << "========================================" << std::endl;
     std::cout << "Filter Parameters Used:" << std::endl;
-    std::cout << "  Gaussian Blur:" << std::endl;
-    std::cout << "    - Kernel Size: " << gaussianKernelSize << "x" << gaussianKernelSize << std::endl;
-    std::cout << "    - Sigma: " << gaussianSigma << std::endl;
-    std::cout << "  Unsharp Mask:" << std::endl;
-    std::cout << "    - Amount: " << sharpenAmount << std::endl;
-    std::cout << "    - Threshold: " << sharpenThreshold << std::endl;
+    if (options.graph != nullptr) {
+        std::cout << "  Filter Graph:" << std::endl;
+        const std::vector<GraphStage>& stages = options.graph->stageList();
+        for (size_t k = 0; k < stages.size(); k++) {
+            std::cout << "    - " << stages[k].name;
+            for (size_t j = 0; j < stages[k].params.size(); j++) {
+                std::cout << " " << stages[k].params[j];
+            }
+            std::cout << std::endl;
+        }
+    } else if (options.pyramid) {
+        std::vector<PyramidLevel> levels = defaultPyramidLevels(settings.amount, settings.threshold);
+        std::cout << "  Laplacian Pyramid (5-tap kernel):" << std::endl;
+        for (size_t k = 0; k < levels.size(); k++) {
+            std::cout << "    - Level " << k << ": gain " << levels[k].gain
+                      << ", threshold " << levels[k].threshold << std::endl;
+        }
+    } else {
+        std::cout << "  Gaussian Blur:" << std::endl;
+        if (options.blurMethod == BLUR_BOX_CASCADE) {
+            int boxWidths[3];
+            double boxSigma = boxCascadeWidths(settings.sigma, boxWidths);
+            std::cout << "    - Box Widths: " << boxWidths[0] << ", " << boxWidths[1] << ", " << boxWidths[2]
+                      << " (sigma " << boxSigma << ")" << std::endl;
+        } else {
+            std::cout << "    - Kernel Size: " << settings.kernelSize << "x" << settings.kernelSize << std::endl;
+        }
+        std::cout << "    - Sigma: " << settings.sigma << std::endl;
+        std::cout << "  Unsharp Mask:" << std::endl;
+        std::cout << "    - Amount: " << settings.amount << std::endl;
+        std::cout << "    - Threshold: " << settings.threshold << std::endl;
+    }
     std::cout << "========================================" << std::endl << std::endl;
     
     std::cout << "✓ Enhanced image saved as: output_enhanced.jpg" << std::endl;
@@ -394,42 +645,286 @@ int runPracticalMode(const std::string& compressedImagePath) {
     return 0;
 }
 
+/**
+ * BATCH MODE
+ * 
+ * Enhances many images at once. Each image is one task on the shared
+ * thread pool, and the filters inside each task split their rows over the
+ * same pool, so the machine stays busy without oversubscribing cores.
+ * 
+ * With --pin-threads, images are dealt out to the NUMA nodes in turn.
+ * An image is loaded, filtered and saved entirely by threads of its node,
+ * so all of its buffers are allocated in that node's local memory.
+ * 
+ * Each input <name>.<ext> is saved as output_enhanced_<name>.jpg
+ */
+int runBatchMode(const std::vector<std::string>& imagePaths, const ImageModeOptions& options) {
+    std::cout << "========================================" << std::endl;
+    std::cout << "BATCH MODE" << std::endl;
+    std::cout << "========================================" << std::endl << std::endl;
+    
+    ThreadPool& pool = ThreadPool::instance();
+    std::cout << "Enhancing " << imagePaths.size() << " images using "
+              << pool.threadCount() << " threads";
+    if (pool.threadsPinned()) {
+        std::cout << " pinned over " << pool.nodeCount() << " NUMA node(s)";
+    }
+    std::cout << "..." << std::endl << std::endl;
+    
+    // Per-image results, filled in by the tasks and reported in input order
+    std::vector<std::string> outputPaths(imagePaths.size());
+    std::vector<double> psnrValues(imagePaths.size(), -1.0);
+    std::vector<double> ssimValues(imagePaths.size(), -1.0);
+    
+    int64 startTicks = cv::getTickCount();
+    
+    TaskGroup images;
+    for (size_t i = 0; i < imagePaths.size(); i++) {
+        // Round-robin the images over the NUMA nodes (a single node unless pinned)
+        int node = static_cast<int>(i % pool.nodeCount());
+        images.runOnNode(node, [&, i]() {
+            cv::Mat compressedImage = cv::imread(imagePaths[i], cv::IMREAD_COLOR);
+            if (compressedImage.empty()) {
+                return;
+            }
+            
+            // Same chain as practical mode; with --auto each image gets its
+            // own blur and threshold
+            cv::Mat enhancedImage, blurredImage;
+            FilterSettings settings;
+            if (!enhanceImage(compressedImage, options, false, enhancedImage, blurredImage, settings)) {
+                return;
+            }
+            
+            // Build the output name from the input file name without directory or extension
+            std::string name = imagePaths[i];
+            size_t slash = name.find_last_of("/\\");
+            if (slash != std::string::npos) {
+                name = name.substr(slash + 1);
+            }
+            size_t dot = name.find_last_of('.');
+            if (dot != std::string::npos) {
+                name = name.substr(0, dot);
+            }
+            outputPaths[i] = "output_enhanced_" + name + ".jpg";
+            cv::imwrite(outputPaths[i], enhancedImage);
+            
+            psnrValues[i] = calculatePSNR(compressedImage, enhancedImage);
+            ssimValues[i] = computeSSIM(compressedImage, enhancedImage);
+        });
+    }
+    images.wait();
+    
+    double seconds = (cv::getTickCount() - startTicks) / cv::getTickFrequency();
+    
+    // Report results in input order
+    std::cout << std::fixed << std::setprecision(4);
+    int failures = 0;
+    for (size_t i = 0; i < imagePaths.size(); i++) {
+        if (outputPaths[i].empty() || psnrValues[i] < 0 || ssimValues[i] < 0) {
+            std::cerr << "✗ ERROR: Could not enhance image: " << imagePaths[i] << std::endl;
+            failures++;
+            continue;
+        }
+        std::cout << "✓ " << imagePaths[i] << " -> " << outputPaths[i]
+                  << "  (PSNR " << psnrValues[i] << " dB, SSIM " << ssimValues[i] << ")" << std::endl;
+    }
+    
+    std::cout << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "Processed " << (imagePaths.size() - failures) << " of " << imagePaths.size()
+              << " images in " << seconds << " s" << std::endl;
+    std::cout << "========================================" << std::endl;
+    
+    return failures == 0 ? 0 : -1;
+}
+
 /**
  * Main function - handles mode selection and argument parsing
  */
 int main(int argc, char** argv) {
+    // Separate global options from the mode and its image paths
+    // Options may appear anywhere on the command line
+    std::vector<std::string> args;
+    ImageModeOptions options;
+    options.deblock = false;
+    options.medianRadius = 0;
+    options.nlmStrength = 0.0;
+    options.waveletDenoise = false;
+    options.sharpenThreshold = 0.0;
+    options.blurMethod = BLUR_EXACT;
+    options.pyramid = false;
+    options.autoConfigure = false;
+    options.graph = nullptr;
+    FilterGraph graph;
+    bool useGraph = false;
+    SequenceOptions sequenceOptions;
+    sequenceOptions.deblock = false;
+    sequenceOptions.medianRadius = 0;
+    sequenceOptions.nlmStrength = 0.0;
+    sequenceOptions.waveletDenoise = false;
+    sequenceOptions.temporalDenoise = false;
+    sequenceOptions.blockMatching = false;
+    sequenceOptions.sharpenThreshold = 0.0;
+    sequenceOptions.blurMethod = BLUR_EXACT;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threads") {
+            if (i + 1 >= argc || std::atoi(argv[i + 1]) <= 0) {
+                std::cerr << "ERROR: --threads requires a positive number!" << std::endl << std::endl;
+                printUsage(argv[0]);
+                return -1;
+            }
+            ThreadPool::setThreadCount(std::atoi(argv[++i]));
+        } else if (arg == "--pin-threads") {
+            ThreadPool::setPinThreads(true);
+        } else if (arg == "--threshold") {
+            if (i + 1 >= argc || std::atof(argv[i + 1]) < 0) {
+                std::cerr << "ERROR: --threshold requires a number of gray levels (0 or more)!" << std::endl << std::endl;
+                printUsage(argv[0]);
+                return -1;
+            }
+            options.sharpenThreshold = std::atof(argv[++i]);
+            sequenceOptions.sharpenThreshold = options.sharpenThreshold;
+        } else if (arg == "--fast-blur") {
+            options.blurMethod = BLUR_BOX_CASCADE;
+            sequenceOptions.blurMethod = BLUR_BOX_CASCADE;
+        } else if (arg == "--wavelet") {
+            options.waveletDenoise = true;
+            sequenceOptions.waveletDenoise = true;
+        } else if (arg == "--pyramid") {
+            options.pyramid = true;
+        } else if (arg == "--auto") {
+            options.autoConfigure = true;
+        } else if (arg == "--graph") {
+            if (i + 1 >= argc || !graph.load(argv[i + 1])) {
+                std::cerr << "ERROR: --graph requires a filter graph file or description!" << std::endl << std::endl;
+                printUsage(argv[0]);
+                return -1;
+            }
+            i++;
+            useGraph = true;
+        } else if (arg == "--deblock") {
+            options.deblock = true;
+            sequenceOptions.deblock = true;
+        } else if (arg == "--median") {
+            if (i + 1 >= argc || std::atoi(argv[i + 1]) <= 0 || std::atoi(argv[i + 1]) > 127) {
+                std::cerr << "ERROR: --median requires a radius from 1 to 127!" << std::endl << std::endl;
+                printUsage(argv[0]);
+                return -1;
+            }
+            options.medianRadius = std::atoi(argv[++i]);
+            sequenceOptions.medianRadius = options.medianRadius;
+        } else if (arg == "--nlmeans") {
+            if (i + 1 >= argc || std::atof(argv[i + 1]) <= 0) {
+                std::cerr << "ERROR: --nlmeans requires a positive strength!" << std::endl << std::endl;
+                printUsage(argv[0]);
+                return -1;
+            }
+            options.nlmStrength = std::atof(argv[++i]);
+            sequenceOptions.nlmStrength = options.nlmStrength;
+        } else if (arg == "--temporal") {
+            sequenceOptions.temporalDenoise = true;
+        } else if (arg == "--block-matching") {
+            sequenceOptions.temporalDenoise = true;
+            sequenceOptions.blockMatching = true;
+        } else if (arg == "--ssim-fp16") {
+            setSSIMStorage(SSIM_STORAGE_FLOAT16);
+        } else if (arg == "--ssim-validate") {
+            setSSIMStorage(SSIM_STORAGE_VALIDATE);
+        } else if (arg == "--cpu-features") {
+            // Diagnostic: show which instruction set each kernel runs with
+            printCpuFeatures(std::cout);
+            return 0;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    
+    // A filter graph describes the whole chain, so the options that change
+    // the chain would be silently ignored with it
+    if (useGraph && (options.deblock || options.medianRadius > 0 || options.nlmStrength > 0 ||
+                     options.waveletDenoise || options.sharpenThreshold > 0 ||
+                     options.blurMethod != BLUR_EXACT || options.pyramid)) {
+        std::cerr << "ERROR: --graph replaces --deblock, --median, --nlmeans, --threshold, --fast-blur, "
+                  << "--wavelet and --pyramid; add those stages to the graph instead!" << std::endl << std::endl;
+        printUsage(argv[0]);
+        return -1;
+    }
+    options.graph = useGraph ? &graph : nullptr;
+    
+    // The pyramid replaces the blur, so a blur method would be ignored
+    if (options.pyramid && options.blurMethod != BLUR_EXACT) {
+        std::cerr << "ERROR: --pyramid replaces the Gaussian blur; it cannot be combined "
+                  << "with --fast-blur!" << std::endl << std::endl;
+        printUsage(argv[0]);
+        return -1;
+    }
+    
+    // --auto chooses the blur and threshold itself
+    if (options.autoConfigure && (useGraph || options.sharpenThreshold > 0)) {
+        std::cerr << "ERROR: --auto picks the blur and threshold itself; it cannot be combined "
+                  << "with --graph or --threshold!" << std::endl << std::endl;
+        printUsage(argv[0]);
+        return -1;
+    }
+    
+    // Start the shared thread pool from the main thread, so that in NUMA
+    // mode the main thread is the one pinned alongside the workers
+    ThreadPool::instance();
+    
     // Check if sufficient arguments provided
-    if (argc < 3) {
+    if (args.size() < 2) {
         printUsage(argv[0]);
         return -1;
     }
     
-    std::string mode = argv[1];
+    std::string mode = args[0];
     
     // TESTING MODE
     if (mode == "--test" || mode == "-t") {
-        if (argc != 4) {
+        if (args.size() != 3) {
             std::cerr << "ERROR: Testing mode requires 2 image paths!" << std::endl << std::endl;
             printUsage(argv[0]);
             return -1;
         }
         
-        std::string cleanImagePath = argv[2];
-        std::string compressedImagePath = argv[3];
+        std::string cleanImagePath = args[1];
+        std::string compressedImagePath = args[2];
         
-        return runTestingMode(cleanImagePath, compressedImagePath);
+        return runTestingMode(cleanImagePath, compressedImagePath, options);
     }
     // PRACTICAL MODE
     else if (mode == "--practical" || mode == "-p") {
-        if (argc != 3) {
+        if (args.size() != 2) {
             std::cerr << "ERROR: Practical mode requires 1 image path!" << std::endl << std::endl;
             printUsage(argv[0]);
             return -1;
         }
         
-        std::string compressedImagePath = argv[2];
+        std::string compressedImagePath = args[1];
+        
+        return runPracticalMode(compressedImagePath, options);
+    }
+    // BATCH MODE
+    else if (mode == "--batch" || mode == "-b") {
+        std::vector<std::string> imagePaths(args.begin() + 1, args.end());
+        
+        return runBatchMode(imagePaths, options);
+    }
+    // SEQUENCE MODE
+    else if (mode == "--sequence" || mode == "-s") {
+        if (args.size() != 2 && args.size() != 3) {
+            std::cerr << "ERROR: Sequence mode requires a video or image pattern (and optionally a reference)!"
+                      << std::endl << std::endl;
+            printUsage(argv[0]);
+            return -1;
+        }
+        
+        std::string inputSource = args[1];
+        std::string referenceSource = (args.size() == 3) ? args[2] : "";
         
-        return runPracticalMode(compressedImagePath);
+        return runSequenceMode(inputSource, referenceSource, sequenceOptions);
     }
     // INVALID MODE
     else {
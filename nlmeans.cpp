@@ -0,0 +1,227 @@
+#include "image_quality.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Output rows per task: at least 64, and at least four patch heights.
+// Every band sums the 2 × patchRadius + 1 difference rows of its first
+// patch again for each search offset, which then costs at most a quarter
+// of the band's sliding steps
+const int nlmMinBandHeight = 64;
+const int nlmBandPatchHeights = 4;
+
+// Parameter limits (larger windows are possible but very slow)
+const int maxPatchRadius = 8;
+const int maxSearchRadius = 16;
+
+/**
+ * Squared differences between one row of the image and the same row
+ * shifted by a search offset, for every sample of pixels -patchRadius to
+ * width + patchRadius
+ * 
+ * @param a Padded row at the pixel -patchRadius
+ * @param b Padded row of the shifted image at the same pixel
+ */
+void squaredDifferenceRow(const unsigned char* a, const unsigned char* b, int* out, int length) {
+    for (int i = 0; i < length; i++) {
+        int d = a[i] - b[i];
+        out[i] = d * d;
+    }
+}
+
+/**
+ * Non-local means of the output rows [y0, y1)
+ * 
+ * For one search offset (dx, dy) at a time, the distance between the
+ * patch around every pixel and the patch around its shifted neighbor is a
+ * box sum of squared differences. Box sums are taken from a summed-area
+ * table in its separable form: running sums down the columns (add the row
+ * entering the patch, subtract the row leaving it) and a running sum
+ * along each row. Each distance then costs a few adds, however large the
+ * patch is, and the loops vectorize. The squared-difference rows of the
+ * current patch height are kept in a ring, so the row leaving the patch
+ * is subtracted from the ring instead of being computed again; it shares
+ * its slot with the row entering.
+ * 
+ * The weight exp(-distance / h²) of the neighbor and its weighted value
+ * are added to per-pixel accumulators; the result is their ratio once all
+ * offsets are done.
+ */
+void nonLocalMeansBand(const cv::Mat& padded, cv::Mat& output, int border, double h,
+                       int patchRadius, int searchRadius, int y0, int y1) {
+    const int channels = output.channels();
+    const int width = output.cols;
+    const int rows = y1 - y0;
+    const int patchWidth = 2 * patchRadius + 1;
+    
+    // Samples of pixels -patchRadius to width + patchRadius
+    const int paddedPixels = width + 2 * patchRadius;
+    const int length = paddedPixels * channels;
+    
+    // Mean squared difference per sample, divided by h²
+    const float scale = static_cast<float>(1.0 / (h * h * channels * patchWidth * patchWidth));
+    
+    std::vector<float> numerators(rows * width * channels, 0.0f);
+    std::vector<float> weightSums(rows * width, 0.0f);
+    std::vector<int> columns(length);
+    std::vector<int> differences(patchWidth * length);
+    std::vector<int> pixelSums(paddedPixels);
+    std::vector<float> weights(width);
+    
+    // Padded row of image row y, at pixel -patchRadius, shifted by (dx, dy)
+    auto rowAt = [&](int y, int dx, int dy) {
+        return padded.ptr<unsigned char>(y + border + dy) + (border - patchRadius + dx) * channels;
+    };
+    
+    for (int dy = -searchRadius; dy <= searchRadius; dy++) {
+        for (int dx = -searchRadius; dx <= searchRadius; dx++) {
+            // Column sums of the patch rows around y0; the difference row
+            // of image row r is kept in ring slot (r - y0 + patchRadius) % patchWidth
+            std::fill(columns.begin(), columns.end(), 0);
+            for (int k = 0; k < patchWidth; k++) {
+                int* row = &differences[k * length];
+                int r = y0 - patchRadius + k;
+                squaredDifferenceRow(rowAt(r, 0, 0), rowAt(r, dx, dy), row, length);
+                for (int i = 0; i < length; i++) {
+                    columns[i] += row[i];
+                }
+            }
+            
+            for (int y = y0; y < y1; y++) {
+                // Slide the column sums down one row: the leaving row and
+                // the entering row are patchWidth rows apart, so they share
+                // a ring slot
+                if (y > y0) {
+                    int* row = &differences[((y - 1 - y0) % patchWidth) * length];
+                    for (int i = 0; i < length; i++) {
+                        columns[i] -= row[i];
+                    }
+                    squaredDifferenceRow(rowAt(y + patchRadius, 0, 0), rowAt(y + patchRadius, dx, dy),
+                                         row, length);
+                    for (int i = 0; i < length; i++) {
+                        columns[i] += row[i];
+                    }
+                }
+                
+                // Sum over the channels, then slide the patch along the row
+                for (int i = 0; i < paddedPixels; i++) {
+                    int sum = 0;
+                    for (int c = 0; c < channels; c++) {
+                        sum += columns[i * channels + c];
+                    }
+                    pixelSums[i] = sum;
+                }
+                int distance = 0;
+                for (int i = 0; i < patchWidth - 1; i++) {
+                    distance += pixelSums[i];
+                }
+                for (int x = 0; x < width; x++) {
+                    distance += pixelSums[x + patchWidth - 1];
+                    weights[x] = std::exp(-distance * scale);
+                    distance -= pixelSums[x];
+                }
+                
+                // Add the weighted neighbors
+                const unsigned char* neighbor = rowAt(y, dx, dy) + patchRadius * channels;
+                float* numerator = &numerators[(y - y0) * width * channels];
+                float* weightSum = &weightSums[(y - y0) * width];
+                for (int x = 0; x < width; x++) {
+                    for (int c = 0; c < channels; c++) {
+                        numerator[x * channels + c] += weights[x] * neighbor[x * channels + c];
+                    }
+                    weightSum[x] += weights[x];
+                }
+            }
+        }
+    }
+    
+    // The offset (0, 0) has weight 1, so no weight sum is 0
+    for (int y = y0; y < y1; y++) {
+        unsigned char* dst = output.ptr<unsigned char>(y);
+        const float* numerator = &numerators[(y - y0) * width * channels];
+        const float* weightSum = &weightSums[(y - y0) * width];
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < channels; c++) {
+                dst[x * channels + c] = cv::saturate_cast<unsigned char>(numerator[x * channels + c] / weightSum[x]);
+            }
+        }
+    }
+}
+
+}
+
+/**
+ * Denoise an image with non-local means
+ * 
+ * Every pixel becomes a weighted average of the pixels in a search window
+ * around it, weighted by how similar the patches around them are. Unlike
+ * a Gaussian or bilateral filter, repeated structure (text, edges,
+ * texture) is averaged with other copies of itself, so noise and
+ * compression artifacts are removed without blurring the detail.
+ * 
+ * The patch distances of one search offset are computed for a whole band
+ * of rows with running box sums (see nonLocalMeansBand), so the cost per
+ * pixel is proportional to the number of search offsets only, not to the
+ * patch size. Bands are at least four patch heights tall, so starting the
+ * running sums of each band stays a small share of the work. Row bands
+ * run on the shared thread pool. Borders are replicated.
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param output Destination image (must not share data with input)
+ * @param h Filter strength: about the noise standard deviation in gray
+ *          levels (larger removes more noise and more detail)
+ * @param patchRadius Patch radius (0 to 8; 2 = 5x5 patches)
+ * @param searchRadius Search window radius (1 to 16; 5 = 11x11 window)
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool applyNonLocalMeans(const cv::Mat& input, cv::Mat& output, double h, int patchRadius, int searchRadius) {
+    // Validate input image
+    if (input.empty()) {
+        std::cerr << "Error: Input image cannot be empty!" << std::endl;
+        return false;
+    }
+    if (input.depth() != CV_8U) {
+        std::cerr << "Error: Non-local means requires an 8-bit image!" << std::endl;
+        return false;
+    }
+    if (h <= 0) {
+        std::cerr << "Error: Non-local means strength must be positive!" << std::endl;
+        return false;
+    }
+    if (patchRadius < 0 || patchRadius > maxPatchRadius || searchRadius < 1 || searchRadius > maxSearchRadius) {
+        std::cerr << "Error: Non-local means patch radius must be 0 to " << maxPatchRadius
+                  << " and search radius 1 to " << maxSearchRadius << "!" << std::endl;
+        return false;
+    }
+    
+    // Border for the farthest sample: search offset plus patch radius
+    const int border = searchRadius + patchRadius;
+    cv::Mat padded;
+    cv::copyMakeBorder(input, padded, border, border, border, border, cv::BORDER_REPLICATE);
+    
+    output.create(input.size(), input.type());
+    
+    const int bandHeight = std::max(nlmMinBandHeight, nlmBandPatchHeights * (2 * patchRadius + 1));
+    const int bands = (input.rows + bandHeight - 1) / bandHeight;
+    parallelFor(0, bands, [&](int bandBegin, int bandEnd) {
+        for (int band = bandBegin; band < bandEnd; band++) {
+            int y0 = band * bandHeight;
+            int y1 = std::min(input.rows, y0 + bandHeight);
+            nonLocalMeansBand(padded, output, border, h, patchRadius, searchRadius, y0, y1);
+        }
+    });
+    
+    return true;
+}
+
+cv::Mat applyNonLocalMeans(const cv::Mat& input, double h, int patchRadius, int searchRadius) {
+    cv::Mat output;
+    if (!applyNonLocalMeans(input, output, h, patchRadius, searchRadius)) {
+        return cv::Mat();
+    }
+    return output;
+}
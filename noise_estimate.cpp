@@ -0,0 +1,148 @@
+#include "image_quality.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// Side of the sampled tiles, and the most tiles sampled per row and column
+const int noiseTileSize = 32;
+const int maxNoiseTilesPerSide = 16;
+
+// Noise gain of the residual mask [1 -2 1; -2 4 -2; 1 -2 1]: white noise
+// of standard deviation 1 gives a residual of standard deviation
+// sqrt(1 + 4 + 1 + 4 + 16 + 4 + 1 + 4 + 1) = 6
+const double residualNoiseGain = 6.0;
+
+// Median of |x| for a unit Gaussian
+const double madToSigma = 0.6745;
+
+/**
+ * Noise estimate of one tile: median absolute residual, scaled to a
+ * standard deviation
+ *
+ * The residual is the image convolved with [1 -2 1; -2 4 -2; 1 -2 1]
+ * (the difference of two Laplacians), which is zero on flat areas and on
+ * linear gradients, so in smooth parts of the image only noise is left.
+ * Saturated samples (0 or 255) carry no noise and are left out; a tile
+ * that is mostly saturated gives no estimate.
+ *
+ * @param image The image (8-bit)
+ * @param x0, y0 Top-left pixel of the tile (at least one pixel from each border)
+ * @param width, height Tile size, leaving one pixel to each border
+ * @param residuals Work buffer
+ * @return double Noise standard deviation estimated from the tile, or -1
+ */
+double tileNoise(const cv::Mat& image, int x0, int y0, int width, int height, std::vector<int>& residuals) {
+    const int channels = image.channels();
+    residuals.clear();
+    for (int y = y0; y < y0 + height; y++) {
+        const unsigned char* above = image.ptr<unsigned char>(y - 1);
+        const unsigned char* row = image.ptr<unsigned char>(y);
+        const unsigned char* below = image.ptr<unsigned char>(y + 1);
+        for (int i = x0 * channels; i < (x0 + width) * channels; i++) {
+            if (row[i] == 0 || row[i] == 255) {
+                continue;
+            }
+            int left = i - channels, right = i + channels;
+            int residual = (above[left] - 2 * above[i] + above[right])
+                         - 2 * (row[left] - 2 * row[i] + row[right])
+                         + (below[left] - 2 * below[i] + below[right]);
+            residuals.push_back(std::abs(residual));
+        }
+    }
+
+    if (residuals.size() < static_cast<size_t>(width * height * channels / 2)) {
+        return -1.0;
+    }
+    std::vector<int>::iterator middle = residuals.begin() + residuals.size() / 2;
+    std::nth_element(residuals.begin(), middle, residuals.end());
+    return *middle / madToSigma / residualNoiseGain;
+}
+
+}
+
+/**
+ * Estimate the noise level of an image from a sample of its tiles
+ *
+ * Up to 16 x 16 tiles of 32 x 32 pixels, spread evenly over the image,
+ * are examined (at most 256K pixels whatever the image size, so a 24 MP
+ * image takes a few milliseconds). Each tile gives a robust estimate from
+ * the median absolute value of its high-pass residual. Tiles with edges
+ * or texture overestimate the noise, so the image estimate is the 25th
+ * percentile of the tile estimates: the smoother tiles, where the residual
+ * is mostly noise, decide.
+ *
+ * The estimate is then mapped to the filter parameters:
+ *   - Blur sigma 0.5 + 0.1 × noise, from 0.5 to 2.5 (1.0 at a noise level
+ *     of 5 gray levels, the fixed setting of practical mode)
+ *   - Kernel size 2 × round(2 × sigma) + 1 (5 for sigma 1)
+ *   - Threshold 2 × noise, rounded, up to 32: nearly all noise stays
+ *     below it and is not amplified by the unsharp mask
+ *
+ * @param image The image (8-bit, any number of channels)
+ * @param estimate Receives the noise level and the parameters
+ * @return bool False if the image is empty or not 8-bit
+ */
+bool estimateNoiseLevel(const cv::Mat& image, NoiseEstimate& estimate) {
+    // Validate input image
+    if (image.empty()) {
+        std::cerr << "Error: Input image cannot be empty!" << std::endl;
+        return false;
+    }
+    if (image.depth() != CV_8U) {
+        std::cerr << "Error: Noise estimation requires an 8-bit image!" << std::endl;
+        return false;
+    }
+
+    // Tile grid over the image without its one-pixel border (the residual
+    // reads one pixel around each sample); small images are one tile
+    int innerWidth = image.cols - 2, innerHeight = image.rows - 2;
+    std::vector<double> tileSigmas;
+    if (innerWidth > 0 && innerHeight > 0) {
+        int tileWidth = std::min(noiseTileSize, innerWidth);
+        int tileHeight = std::min(noiseTileSize, innerHeight);
+        int tilesX = std::min(maxNoiseTilesPerSide, innerWidth / tileWidth);
+        int tilesY = std::min(maxNoiseTilesPerSide, innerHeight / tileHeight);
+        tileSigmas.resize(tilesX * tilesY);
+
+        // One task per tile row; tiles are spaced evenly over the image
+        parallelFor(0, tilesY, [&](int rowBegin, int rowEnd) {
+            std::vector<int> residuals;
+            residuals.reserve(tileWidth * tileHeight * image.channels());
+            for (int ty = rowBegin; ty < rowEnd; ty++) {
+                int y0 = 1 + (innerHeight - tileHeight) * ty / std::max(1, tilesY - 1);
+                if (tilesY == 1) {
+                    y0 = 1 + (innerHeight - tileHeight) / 2;
+                }
+                for (int tx = 0; tx < tilesX; tx++) {
+                    int x0 = 1 + (innerWidth - tileWidth) * tx / std::max(1, tilesX - 1);
+                    if (tilesX == 1) {
+                        x0 = 1 + (innerWidth - tileWidth) / 2;
+                    }
+                    tileSigmas[ty * tilesX + tx] = tileNoise(image, x0, y0, tileWidth, tileHeight, residuals);
+                }
+            }
+        }, 1);
+    }
+
+    // 25th percentile of the tile estimates (0 if the image is too small
+    // or saturated)
+    tileSigmas.erase(std::remove(tileSigmas.begin(), tileSigmas.end(), -1.0), tileSigmas.end());
+    double sigma = 0.0;
+    if (!tileSigmas.empty()) {
+        std::vector<double>::iterator quartile = tileSigmas.begin() + tileSigmas.size() / 4;
+        std::nth_element(tileSigmas.begin(), quartile, tileSigmas.end());
+        sigma = *quartile;
+    }
+
+    estimate.noiseSigma = sigma;
+    estimate.tilesSampled = static_cast<int>(tileSigmas.size());
+    estimate.gaussianSigma = std::min(2.5, std::max(0.5, 0.5 + 0.1 * sigma));
+    estimate.kernelSize = 2 * static_cast<int>(std::lround(2.0 * estimate.gaussianSigma)) + 1;
+    estimate.sharpenThreshold = std::min(32.0, static_cast<double>(std::lround(2.0 * sigma)));
+    return true;
+}
@@ -1,7 +1,89 @@
 #include "image_quality.h"
+#include "cpu_features.h"
+#include "thread_pool.h"
 #include <iostream>
 #include <cmath>
 #include <limits>
+#include <algorithm>
+#include <vector>
+
+/**
+ * Sum of squared differences over one row of integer samples
+ * 
+ * The squared difference of two 8-bit or 16-bit values is an exact
+ * integer (at most 65535^2), so a 64-bit accumulator gives the exact sum
+ * for any realistic row length.
+ * 
+ * @param a First row of samples
+ * @param b Second row of samples
+ * @param length Number of samples (width × channels)
+ * @return long long Exact sum of (a[i] - b[i])^2
+ */
+template <typename T>
+static long long rowSquaredError(const T* a, const T* b, int length) {
+    long long sum = 0;
+    for (int i = 0; i < length; i++) {
+        long long diff = static_cast<long long>(a[i]) - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+/**
+ * Sum of squared differences over one row of 8-bit samples
+ * 
+ * Same exact result as rowSquaredError, but each squared difference
+ * (at most 255^2) is accumulated in 32 bits over blocks of 32768 samples,
+ * which cannot overflow and lets the loop use full-width integer vectors.
+ * Forced inline so every ISA wrapper below gets its own vectorized copy.
+ */
+static FORCE_INLINE long long rowSquaredError8UKernel(const unsigned char* a, const unsigned char* b,
+                                                      int length) {
+    const int blockSize = 32768;  // 32768 × 255^2 < 2^31
+    long long sum = 0;
+    for (int start = 0; start < length; start += blockSize) {
+        int end = std::min(length, start + blockSize);
+        int blockSum = 0;
+        for (int i = start; i < end; i++) {
+            int diff = static_cast<int>(a[i]) - b[i];
+            blockSum += diff * diff;
+        }
+        sum += blockSum;
+    }
+    return sum;
+}
+
+typedef long long (*RowSquaredError8UFn)(const unsigned char*, const unsigned char*, int);
+
+static long long rowSquaredError8UGeneric(const unsigned char* a, const unsigned char* b, int length) {
+    return rowSquaredError8UKernel(a, b, length);
+}
+
+#if HAVE_ISA_VARIANTS
+ISA_TARGET_SSE2 static long long rowSquaredError8USSE2(const unsigned char* a, const unsigned char* b, int length) {
+    return rowSquaredError8UKernel(a, b, length);
+}
+
+ISA_TARGET_AVX2 static long long rowSquaredError8UAVX2(const unsigned char* a, const unsigned char* b, int length) {
+    return rowSquaredError8UKernel(a, b, length);
+}
+
+ISA_TARGET_AVX512 static long long rowSquaredError8UAVX512(const unsigned char* a, const unsigned char* b, int length) {
+    return rowSquaredError8UKernel(a, b, length);
+}
+
+static const KernelVariants<RowSquaredError8UFn> rowSquaredError8UVariants = {
+    "PSNR squared error (8-bit)", rowSquaredError8UGeneric,
+    rowSquaredError8USSE2, rowSquaredError8UAVX2, rowSquaredError8UAVX512
+};
+#else
+static const KernelVariants<RowSquaredError8UFn> rowSquaredError8UVariants = {
+    "PSNR squared error (8-bit)", rowSquaredError8UGeneric, nullptr, nullptr, nullptr
+};
+#endif
+
+// Best variant for this CPU, chosen once at startup
+static const RowSquaredError8UFn rowSquaredError8U = selectKernel(rowSquaredError8UVariants);
 
 /**
  * Calculate the Peak Signal-to-Noise Ratio (PSNR) between two images
@@ -35,31 +117,65 @@ double calculatePSNR(const cv::Mat& original, const cv::Mat& compressed) {
         return -1.0;
     }
     
-    // Convert images to CV_64F (64-bit floating point) format
-    // This provides high precision for calculations and prevents overflow
-    cv::Mat orig_float, comp_float;
-    original.convertTo(orig_float, CV_64F);
-    compressed.convertTo(comp_float, CV_64F);
-    
-    // Calculate the difference between the two images
-    // This creates a new matrix where each pixel contains (original - compressed)
-    cv::Mat diff = orig_float - comp_float;
-    
-    // Square each element in the difference matrix
-    // diff.mul(diff) performs element-wise multiplication (squaring)
-    // This gives us the squared error for each pixel
-    diff = diff.mul(diff);
+    // Split the image into horizontal bands processed on the shared thread pool
+    // Each band writes its partial sum into its own slot, and the slots are
+    // added in order afterwards so the result does not depend on scheduling
+    int numBands = std::max(1, std::min(original.rows, ThreadPool::instance().threadCount() * 4));
+    std::vector<double> band_sse(numBands, 0.0);
     
-    // Sum all the squared differences across all channels and pixels
-    // This reduces the entire matrix to a single scalar value per channel
-    cv::Scalar sum_squared_error = cv::sum(diff);
+    parallelFor(0, numBands, [&](int bandBegin, int bandEnd) {
+        for (int band = bandBegin; band < bandEnd; band++) {
+            int rowBegin = original.rows * band / numBands;
+            int rowEnd = original.rows * (band + 1) / numBands;
+            
+            // Choose the arithmetic from the pixel type:
+            //   - 8-bit and 16-bit samples: the squared differences are exact
+            //     integers, so they are summed in 64-bit integers (exact SSE,
+            //     no conversion pass at all)
+            //   - Anything else: samples are converted to float32 one band at
+            //     a time and each row's squared errors are summed in double.
+            //     The relative error of a float32 square is below 2^-24, far
+            //     under the 0.01 dB (0.23%) resolution PSNR is reported with.
+            int rowLength = original.cols * original.channels();
+            bool integerPath = original.type() == compressed.type() &&
+                               (original.depth() == CV_8U || original.depth() == CV_16U);
+            
+            if (integerPath && original.depth() == CV_8U) {
+                for (int y = rowBegin; y < rowEnd; y++) {
+                    band_sse[band] += static_cast<double>(
+                        rowSquaredError8U(original.ptr<unsigned char>(y), compressed.ptr<unsigned char>(y), rowLength));
+                }
+            } else if (integerPath) {
+                for (int y = rowBegin; y < rowEnd; y++) {
+                    band_sse[band] += static_cast<double>(
+                        rowSquaredError(original.ptr<unsigned short>(y), compressed.ptr<unsigned short>(y), rowLength));
+                }
+            } else {
+                // Convert the band to CV_32F (32-bit floating point) format
+                cv::Mat orig_float, comp_float;
+                original.rowRange(rowBegin, rowEnd).convertTo(orig_float, CV_32F);
+                compressed.rowRange(rowBegin, rowEnd).convertTo(comp_float, CV_32F);
+                
+                for (int y = 0; y < orig_float.rows; y++) {
+                    const float* origRow = orig_float.ptr<float>(y);
+                    const float* compRow = comp_float.ptr<float>(y);
+                    
+                    // Square the difference of each sample and add it up
+                    double rowSum = 0.0;
+                    for (int i = 0; i < rowLength; i++) {
+                        float diff = origRow[i] - compRow[i];
+                        rowSum += diff * diff;
+                    }
+                    band_sse[band] += rowSum;
+                }
+            }
+        }
+    }, 1);
     
-    // Calculate the total sum of squared errors across all channels
-    // For RGB images, this adds the errors from R, G, and B channels
-    // For grayscale, there's only one channel, so sum_squared_error[0] is used directly
+    // Calculate the total sum of squared errors across all bands
     double sse = 0.0;  // SSE = Sum of Squared Errors
-    for (int i = 0; i < original.channels(); i++) {
-        sse += sum_squared_error[i];
+    for (int band = 0; band < numBands; band++) {
+        sse += band_sse[band];
     }
     
     // Calculate the total number of pixel values in the image
@@ -0,0 +1,281 @@
+#include "image_quality.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Levels limit (eight halvings take a 4K image down to about 15x8 pixels)
+const int maxPyramidLevels = 8;
+
+// Burt-Adelson 5-tap kernel [1 4 6 4 1] / 16, used to build the pyramid
+const float tapOuter = 1.0f / 16.0f;
+const float tapInner = 4.0f / 16.0f;
+const float tapCenter = 6.0f / 16.0f;
+
+/**
+ * Reflect the pixels -1 to -count and width to width + count - 1 of a
+ * float row from its own pixels (BORDER_REFLECT_101)
+ * 
+ * @param row Row at pixel 0, with count pixels of room on both sides
+ */
+void reflectRowBorders(float* row, int width, int channels, int count) {
+    for (int j = 1; j <= count; j++) {
+        int left = cv::borderInterpolate(-j, width, cv::BORDER_REFLECT_101);
+        int right = cv::borderInterpolate(width - 1 + j, width, cv::BORDER_REFLECT_101);
+        for (int c = 0; c < channels; c++) {
+            row[-j * channels + c] = row[left * channels + c];
+            row[(width - 1 + j) * channels + c] = row[right * channels + c];
+        }
+    }
+}
+
+/**
+ * Reduce: rows [rowBegin, rowEnd) of the next (half size) pyramid level
+ * 
+ * The five fine rows around row 2y are combined with the 5-tap kernel
+ * over the whole fine width (one multiply-add per tap and sample, which
+ * vectorizes), then the horizontal taps are applied at every other pixel.
+ * 
+ * @param fine Pyramid level k (8-bit for level 0, float above)
+ * @param coarse Level k + 1, float, ((cols + 1) / 2) x ((rows + 1) / 2)
+ */
+template <typename T>
+void reduceRows(const cv::Mat& fine, cv::Mat& coarse, int rowBegin, int rowEnd) {
+    const int channels = fine.channels();
+    const int fineWidth = fine.cols;
+    const int length = fineWidth * channels;
+    
+    std::vector<float> padded((fineWidth + 4) * channels);
+    float* row = &padded[2 * channels];
+    
+    for (int y = rowBegin; y < rowEnd; y++) {
+        const T* r[5];
+        for (int k = 0; k < 5; k++) {
+            r[k] = fine.ptr<T>(cv::borderInterpolate(2 * y + k - 2, fine.rows, cv::BORDER_REFLECT_101));
+        }
+        for (int i = 0; i < length; i++) {
+            row[i] = tapOuter * (r[0][i] + r[4][i]) + tapInner * (r[1][i] + r[3][i]) + tapCenter * r[2][i];
+        }
+        reflectRowBorders(row, fineWidth, channels, 2);
+        
+        float* dst = coarse.ptr<float>(y);
+        for (int x = 0; x < coarse.cols; x++) {
+            const float* p = row + 2 * x * channels;
+            for (int c = 0; c < channels; c++) {
+                dst[x * channels + c] = tapOuter * (p[c - 2 * channels] + p[c + 2 * channels]) +
+                                        tapInner * (p[c - channels] + p[c + channels]) + tapCenter * p[c];
+            }
+        }
+    }
+}
+
+/**
+ * Expand: row y of the upsampling of a coarse level to the fine size
+ * 
+ * Interpolates with twice the 5-tap kernel on the zero-filled upsampled
+ * grid: its even taps [1 6 1] / 8 give the even rows and columns, its
+ * odd taps [4 4] / 8 the odd ones.
+ * 
+ * @param coarse Float pyramid level
+ * @param dst Output row of fineWidth pixels
+ * @param padded Work row of (coarse.cols + 2) × channels floats
+ */
+void expandRow(const cv::Mat& coarse, int y, float* dst, int fineWidth, float* padded) {
+    const int channels = coarse.channels();
+    const int coarseWidth = coarse.cols;
+    const int length = coarseWidth * channels;
+    float* row = padded + channels;
+    
+    // Vertical interpolation on the coarse width
+    const int j = y / 2;
+    if (y % 2 == 0) {
+        const float* above = coarse.ptr<float>(cv::borderInterpolate(j - 1, coarse.rows, cv::BORDER_REFLECT_101));
+        const float* center = coarse.ptr<float>(j);
+        const float* below = coarse.ptr<float>(cv::borderInterpolate(j + 1, coarse.rows, cv::BORDER_REFLECT_101));
+        for (int i = 0; i < length; i++) {
+            row[i] = 0.125f * (above[i] + below[i]) + 0.75f * center[i];
+        }
+    } else {
+        const float* above = coarse.ptr<float>(j);
+        const float* below = coarse.ptr<float>(cv::borderInterpolate(j + 1, coarse.rows, cv::BORDER_REFLECT_101));
+        for (int i = 0; i < length; i++) {
+            row[i] = 0.5f * (above[i] + below[i]);
+        }
+    }
+    reflectRowBorders(row, coarseWidth, channels, 1);
+    
+    // Horizontal interpolation to the fine width
+    for (int x = 0; x < coarseWidth; x++) {
+        const float* p = row + x * channels;
+        float* even = dst + 2 * x * channels;
+        for (int c = 0; c < channels; c++) {
+            even[c] = 0.125f * (p[c - channels] + p[c + channels]) + 0.75f * p[c];
+        }
+        if (2 * x + 1 < fineWidth) {
+            for (int c = 0; c < channels; c++) {
+                even[channels + c] = 0.5f * (p[c] + p[c + channels]);
+            }
+        }
+    }
+}
+
+/**
+ * Reconstruct rows [rowBegin, rowEnd) of one enhanced pyramid level
+ * 
+ * result = expand(resultCoarse) + boost(gaussian - expand(gaussianCoarse))
+ * 
+ * The detail (Laplacian) of the level is never stored: it is computed row
+ * by row from the two Gaussian levels. Detail up to threshold is kept as
+ * it is; beyond it, the excess is multiplied by gain, so the curve has no
+ * step at the threshold.
+ * 
+ * @param gaussian Gaussian level k (8-bit for level 0, float above)
+ * @param gaussianCoarse Gaussian level k + 1
+ * @param resultCoarse Enhanced level k + 1 (gaussianCoarse itself for the
+ *                     coarsest level, which is kept as it is)
+ * @param result Enhanced level k (8-bit for level 0, float above)
+ */
+template <typename T>
+void reconstructRows(const cv::Mat& gaussian, const cv::Mat& gaussianCoarse, const cv::Mat& resultCoarse,
+                     cv::Mat& result, const PyramidLevel& level, int rowBegin, int rowEnd) {
+    const int channels = gaussian.channels();
+    const int width = gaussian.cols;
+    const int length = width * channels;
+    const bool sameCoarse = (&resultCoarse == &gaussianCoarse);
+    const float extraGain = static_cast<float>(level.gain - 1.0);
+    const float threshold = static_cast<float>(level.threshold);
+    
+    std::vector<float> padded((gaussianCoarse.cols + 2) * channels);
+    std::vector<float> expandedGaussian(length);
+    std::vector<float> expandedResult(length);
+    
+    for (int y = rowBegin; y < rowEnd; y++) {
+        expandRow(gaussianCoarse, y, &expandedGaussian[0], width, &padded[0]);
+        const float* base = &expandedGaussian[0];
+        if (!sameCoarse) {
+            expandRow(resultCoarse, y, &expandedResult[0], width, &padded[0]);
+            base = &expandedResult[0];
+        }
+        
+        const T* src = gaussian.ptr<T>(y);
+        T* dst = result.ptr<T>(y);
+        for (int i = 0; i < length; i++) {
+            float detail = src[i] - expandedGaussian[i];
+            float excess = detail - std::max(-threshold, std::min(threshold, detail));
+            dst[i] = cv::saturate_cast<T>(base[i] + detail + extraGain * excess);
+        }
+    }
+}
+
+}
+
+std::vector<PyramidLevel> defaultPyramidLevels(double amount, double threshold) {
+    // The finest level holds most of the noise: a higher threshold there,
+    // and less gain on the coarsest level so large shapes keep their tone
+    std::vector<PyramidLevel> levels(3);
+    levels[0].gain = 1.0 + 0.5 * amount;
+    levels[0].threshold = 2.0 * threshold;
+    levels[1].gain = 1.0 + 0.5 * amount;
+    levels[1].threshold = threshold;
+    levels[2].gain = 1.0 + 0.25 * amount;
+    levels[2].threshold = threshold;
+    return levels;
+}
+
+/**
+ * Enhance detail at several scales with a Laplacian pyramid
+ * 
+ * The image is decomposed once into a Gaussian pyramid (each level
+ * blurred with the 5-tap kernel and halved). The difference between a
+ * level and the expanded next one is the detail of that scale; it is
+ * boosted with the gain and threshold of its level, and the image is
+ * rebuilt from the coarsest level up. Unlike one unsharp mask, fine
+ * noise and mid-scale structure get separate settings, in a single pass.
+ * 
+ * Only the Gaussian levels are stored (about a third of the image, as
+ * floats, plus the enhanced levels above 0); the details are recomputed
+ * row by row during the reconstruction. Rows run on the shared thread
+ * pool. Borders are reflected.
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param output Destination image (may be input itself)
+ * @param levels Gain and threshold per detail level, finest first (1 to
+ *               8; levels that would be smaller than 2 pixels are left out)
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool applyPyramidEnhance(const cv::Mat& input, cv::Mat& output, const std::vector<PyramidLevel>& levels) {
+    // Validate input image
+    if (input.empty()) {
+        std::cerr << "Error: Input image cannot be empty!" << std::endl;
+        return false;
+    }
+    if (input.depth() != CV_8U) {
+        std::cerr << "Error: Pyramid enhancement requires an 8-bit image!" << std::endl;
+        return false;
+    }
+    if (levels.empty() || static_cast<int>(levels.size()) > maxPyramidLevels) {
+        std::cerr << "Error: Pyramid enhancement needs 1 to " << maxPyramidLevels << " levels!" << std::endl;
+        return false;
+    }
+    for (size_t k = 0; k < levels.size(); k++) {
+        if (levels[k].gain < 0 || levels[k].threshold < 0) {
+            std::cerr << "Error: Pyramid gains and thresholds cannot be negative!" << std::endl;
+            return false;
+        }
+    }
+    
+    // Gaussian pyramid: gaussians[k] is level k + 1 (level 0 is the input)
+    std::vector<cv::Mat> gaussians;
+    gaussians.reserve(levels.size());
+    const cv::Mat* fine = &input;
+    while (gaussians.size() < levels.size() && fine->cols >= 2 && fine->rows >= 2) {
+        gaussians.push_back(cv::Mat((fine->rows + 1) / 2, (fine->cols + 1) / 2, CV_MAKETYPE(CV_32F, input.channels())));
+        cv::Mat& coarse = gaussians.back();
+        parallelFor(0, coarse.rows, [&](int rowBegin, int rowEnd) {
+            if (fine == &input) {
+                reduceRows<unsigned char>(*fine, coarse, rowBegin, rowEnd);
+            } else {
+                reduceRows<float>(*fine, coarse, rowBegin, rowEnd);
+            }
+        });
+        fine = &coarse;
+    }
+    
+    const int depth = static_cast<int>(gaussians.size());
+    if (depth == 0) {
+        input.copyTo(output);
+        return true;
+    }
+    
+    // Enhanced levels 1 to depth - 1 (results[k] is level k + 1), from the
+    // coarsest up; the coarsest Gaussian level is kept as it is
+    std::vector<cv::Mat> results(depth - 1);
+    for (int k = depth - 2; k >= 0; k--) {
+        results[k].create(gaussians[k].size(), gaussians[k].type());
+        parallelFor(0, results[k].rows, [&](int rowBegin, int rowEnd) {
+            reconstructRows<float>(gaussians[k], gaussians[k + 1],
+                                   (k + 1 == depth - 1) ? gaussians[k + 1] : results[k + 1],
+                                   results[k], levels[k + 1], rowBegin, rowEnd);
+        });
+    }
+    
+    // Level 0 straight into the output: each row only reads the same row
+    // of the input, so output may be input
+    output.create(input.size(), input.type());
+    parallelFor(0, input.rows, [&](int rowBegin, int rowEnd) {
+        reconstructRows<unsigned char>(input, gaussians[0], (depth == 1) ? gaussians[0] : results[0],
+                                       output, levels[0], rowBegin, rowEnd);
+    });
+    
+    return true;
+}
+
+cv::Mat applyPyramidEnhance(const cv::Mat& input, const std::vector<PyramidLevel>& levels) {
+    cv::Mat output;
+    if (!applyPyramidEnhance(input, output, levels)) {
+        return cv::Mat();
+    }
+    return output;
+}
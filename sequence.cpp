@@ -0,0 +1,497 @@
+#include "sequence.h"
+#include "image_quality.h"
+#include "temporal.h"
+#include "thread_pool.h"
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/**
+ * Pipeline stage a frame slot is waiting for
+ */
+enum SlotState {
+    SLOT_FREE,       // Empty, ready for the decoder
+    SLOT_DECODED,    // Holds an input frame, ready for processing
+    SLOT_PROCESSED   // Holds an enhanced frame, ready for the encoder
+};
+
+/**
+ * One frame travelling through the pipeline
+ * 
+ * The cv::Mat members are the persistent buffers: they are allocated for
+ * the first frame that uses the slot and reused for every later one.
+ */
+struct FrameSlot {
+    SlotState state;
+    bool endOfStream;      // No frame: marks the end of the sequence
+    int frameIndex;
+    
+    cv::Mat input;         // Decoded input frame
+    cv::Mat reference;     // Decoded reference frame (if any)
+    cv::Mat deblocked;     // Deblocked input (if enabled)
+    cv::Mat median;        // Median-filtered input (if enabled)
+    cv::Mat nlmDenoised;   // Non-local means denoised input (if enabled)
+    cv::Mat waveletDenoised; // Wavelet shrinkage denoised input (if enabled)
+    cv::Mat denoised;      // Temporally denoised input (if enabled)
+    cv::Mat blurred;       // Gaussian blur of the input
+    cv::Mat enhanced;      // Final enhanced frame
+    
+    int64 decodeStartTicks;
+    double processMs;
+    double skipRatio;      // Fraction of flat tiles copied through
+    double psnr;
+    double ssim;
+    double baselinePsnr;   // Input vs reference (only with a reference)
+    double baselineSsim;
+};
+
+/**
+ * Ring of frame slots shared by the three stages
+ * 
+ * Every stage visits frames in order, so frame n always uses slot
+ * n % depth; a stage waits until that slot reaches the state it needs.
+ */
+class FramePipeline {
+public:
+    explicit FramePipeline(int depth) : slots(depth), aborted(false) {
+        for (size_t i = 0; i < slots.size(); i++) {
+            slots[i].state = SLOT_FREE;
+            slots[i].endOfStream = false;
+        }
+    }
+    
+    /**
+     * Wait until the slot of frame n is in the wanted state
+     * 
+     * @return FrameSlot* The slot, or nullptr if the pipeline was aborted
+     */
+    FrameSlot* acquire(int n, SlotState wanted) {
+        FrameSlot& slot = slots[n % slots.size()];
+        std::unique_lock<std::mutex> lock(mutex);
+        stateChanged.wait(lock, [&] { return aborted || slot.state == wanted; });
+        return aborted ? nullptr : &slot;
+    }
+    
+    /**
+     * Hand a slot to the next stage
+     */
+    void release(FrameSlot* slot, SlotState next) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot->state = next;
+        }
+        stateChanged.notify_all();
+    }
+    
+    /**
+     * Stop all stages (after an error)
+     */
+    void abort() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            aborted = true;
+        }
+        stateChanged.notify_all();
+    }
+
+private:
+    std::vector<FrameSlot> slots;
+    std::mutex mutex;
+    std::condition_variable stateChanged;
+    bool aborted;
+};
+
+double millisecondsSince(int64 startTicks) {
+    return (cv::getTickCount() - startTicks) * 1000.0 / cv::getTickFrequency();
+}
+
+/**
+ * Print the mean of the frames that could be scored, and how many frames
+ * were left out (failed or, for PSNR, identical frames)
+ */
+void printMean(double total, int scoredFrames, int frames, const char* unit) {
+    if (scoredFrames > 0) {
+        std::cout << total / scoredFrames << unit;
+    } else {
+        std::cout << "n/a";
+    }
+    if (scoredFrames < frames) {
+        std::cout << " (" << frames - scoredFrames << " frame(s) skipped)";
+    }
+}
+
+}
+
+int runSequenceMode(const std::string& inputSource, const std::string& referenceSource,
+                    const SequenceOptions& options) {
+    std::cout << "========================================" << std::endl;
+    std::cout << "SEQUENCE MODE" << std::endl;
+    std::cout << "========================================" << std::endl << std::endl;
+    
+    // ================================================================
+    // STEP 1: OPEN THE SOURCES
+    // ================================================================
+    
+    // cv::VideoCapture reads both video files and numbered image patterns
+    cv::VideoCapture input(inputSource);
+    if (!input.isOpened()) {
+        std::cerr << "ERROR: Could not open sequence: " << inputSource << std::endl;
+        return -1;
+    }
+    
+    bool hasReference = !referenceSource.empty();
+    cv::VideoCapture reference;
+    if (hasReference && !reference.open(referenceSource)) {
+        std::cerr << "ERROR: Could not open reference sequence: " << referenceSource << std::endl;
+        return -1;
+    }
+    
+    // Image patterns are saved as numbered images, videos as a video file
+    bool imagePattern = inputSource.find('%') != std::string::npos;
+    double fps = input.get(cv::CAP_PROP_FPS);
+    if (fps <= 0) {
+        fps = 25.0;
+    }
+    
+    std::cout << "✓ Opened sequence: " << inputSource << std::endl;
+    if (hasReference) {
+        std::cout << "✓ Opened reference: " << referenceSource << std::endl;
+    }
+    std::cout << "  Output: " << (imagePattern ? "output_enhanced_%05d.jpg" : "output_enhanced.avi")
+              << std::endl;
+    std::cout << "  Deblocking: " << (options.deblock ? "on" : "off") << std::endl;
+    std::cout << "  Median filter: ";
+    if (options.medianRadius > 0) {
+        std::cout << "radius " << options.medianRadius << std::endl;
+    } else {
+        std::cout << "off" << std::endl;
+    }
+    std::cout << "  Non-local means: ";
+    if (options.nlmStrength > 0) {
+        std::cout << "h = " << options.nlmStrength << std::endl;
+    } else {
+        std::cout << "off" << std::endl;
+    }
+    std::cout << "  Wavelet denoise: " << (options.waveletDenoise ? "on" : "off") << std::endl;
+    std::cout << "  Temporal denoise: "
+              << (options.temporalDenoise ? (options.blockMatching ? "on (block matching)" : "on") : "off")
+              << std::endl;
+    std::cout << "  Blur: " << blurMethodName(options.blurMethod) << std::endl;
+    std::cout << "  Sharpen threshold: " << options.sharpenThreshold
+              << (options.sharpenThreshold > 0 ? " (flat tiles skipped)" : "") << std::endl;
+    std::cout << "  Threads: " << ThreadPool::instance().threadCount() << std::endl << std::endl;
+    
+    // Same filter parameters as practical mode
+    const int gaussianKernelSize = 5;
+    const double gaussianSigma = 1.0;
+    const double sharpenAmount = 1.5;
+    const double sharpenThreshold = options.sharpenThreshold;
+    const int tileMargin = blurRadius(gaussianKernelSize, gaussianSigma, options.blurMethod);
+    
+    // One frame decoding, one processing and one encoding
+    const int pipelineDepth = 3;
+    FramePipeline pipeline(pipelineDepth);
+    
+    // Set when a stage fails (read by the main thread after joining)
+    bool decodeFailed = false;
+    bool encodeFailed = false;
+    
+    // Results reported in the summary, filled in by the encoder
+    std::vector<double> latencies;
+    double totalProcessMs = 0.0;
+    double totalSkipRatio = 0.0;
+    double totalPsnr = 0.0, totalSsim = 0.0;
+    double totalBaselinePsnr = 0.0, totalBaselineSsim = 0.0;
+    
+    // Frames in each mean: a PSNR of -1 (error) or infinity (identical
+    // frames) and an SSIM of -1 (error) are left out and counted instead
+    int psnrFrames = 0, ssimFrames = 0;
+    int baselinePsnrFrames = 0, baselineSsimFrames = 0;
+    
+    int64 startTicks = cv::getTickCount();
+    
+    // ================================================================
+    // STAGE 1: DECODE THREAD
+    // ================================================================
+    
+    std::thread decoder([&]() {
+        for (int n = 0; ; n++) {
+            FrameSlot* slot = pipeline.acquire(n, SLOT_FREE);
+            if (slot == nullptr) {
+                return;
+            }
+            slot->frameIndex = n;
+            slot->decodeStartTicks = cv::getTickCount();
+            
+            // read() decodes into the slot's existing buffer when the size matches
+            bool haveFrame = input.read(slot->input) && !slot->input.empty();
+            if (haveFrame && hasReference) {
+                if (!reference.read(slot->reference) || slot->reference.empty()) {
+                    std::cerr << "ERROR: Reference sequence ended at frame " << n << std::endl;
+                    decodeFailed = true;
+                    haveFrame = false;
+                } else if (slot->reference.size() != slot->input.size()) {
+                    std::cerr << "ERROR: Reference frame " << n << " has a different size!" << std::endl;
+                    decodeFailed = true;
+                    haveFrame = false;
+                }
+            }
+            
+            slot->endOfStream = !haveFrame;
+            pipeline.release(slot, SLOT_DECODED);
+            if (!haveFrame) {
+                return;
+            }
+        }
+    });
+    
+    // ================================================================
+    // STAGE 3: ENCODE THREAD
+    // ================================================================
+    
+    std::thread encoder([&]() {
+        cv::VideoWriter writer;
+        std::cout << std::fixed << std::setprecision(2);
+        
+        for (int n = 0; ; n++) {
+            FrameSlot* slot = pipeline.acquire(n, SLOT_PROCESSED);
+            if (slot == nullptr) {
+                return;
+            }
+            if (slot->endOfStream) {
+                pipeline.release(slot, SLOT_FREE);
+                return;
+            }
+            
+            bool written = true;
+            if (imagePattern) {
+                char name[64];
+                std::snprintf(name, sizeof(name), "output_enhanced_%05d.jpg", slot->frameIndex);
+                written = cv::imwrite(name, slot->enhanced);
+            } else {
+                // The writer needs the frame size, so it is opened on the first frame
+                if (!writer.isOpened()) {
+                    writer.open("output_enhanced.avi", cv::VideoWriter::fourcc('M', 'J', 'P', 'G'),
+                                fps, slot->enhanced.size());
+                }
+                if (writer.isOpened()) {
+                    writer.write(slot->enhanced);
+                } else {
+                    written = false;
+                }
+            }
+            if (!written) {
+                std::cerr << "ERROR: Could not write enhanced frame " << slot->frameIndex << std::endl;
+                encodeFailed = true;
+                pipeline.abort();
+                return;
+            }
+            
+            double latencyMs = millisecondsSince(slot->decodeStartTicks);
+            latencies.push_back(latencyMs);
+            totalProcessMs += slot->processMs;
+            totalSkipRatio += slot->skipRatio;
+            if (slot->psnr >= 0 && std::isfinite(slot->psnr)) {
+                totalPsnr += slot->psnr;
+                psnrFrames++;
+            }
+            if (slot->ssim > -1.0) {
+                totalSsim += slot->ssim;
+                ssimFrames++;
+            }
+            if (hasReference && slot->baselinePsnr >= 0 && std::isfinite(slot->baselinePsnr)) {
+                totalBaselinePsnr += slot->baselinePsnr;
+                baselinePsnrFrames++;
+            }
+            if (hasReference && slot->baselineSsim > -1.0) {
+                totalBaselineSsim += slot->baselineSsim;
+                baselineSsimFrames++;
+            }
+            
+            std::cout << "Frame " << std::setw(5) << slot->frameIndex
+                      << ": process " << std::setw(7) << slot->processMs << " ms"
+                      << ", latency " << std::setw(7) << latencyMs << " ms"
+                      << std::setprecision(4)
+                      << ", PSNR " << slot->psnr << " dB, SSIM " << slot->ssim;
+            if (hasReference) {
+                std::cout << " (input: " << slot->baselinePsnr << " dB, " << slot->baselineSsim << ")";
+            }
+            std::cout << std::setprecision(2) << std::endl;
+            
+            pipeline.release(slot, SLOT_FREE);
+        }
+    });
+    
+    // ================================================================
+    // STAGE 2: PROCESS ON THE MAIN THREAD
+    // ================================================================
+    
+    // The filters split their rows over the shared thread pool; the main
+    // thread takes part in that work while the other stages do I/O
+    // Frames reach this stage in order, so the temporal history lives here
+    TemporalDenoiseParams temporalParams = defaultTemporalDenoiseParams();
+    temporalParams.blockMatching = options.blockMatching;
+    TemporalDenoiser denoiser(temporalParams);
+    
+    // Flat tiles of the current frame (only with a sharpening threshold)
+    TileActivity tiles;
+    
+    bool processFailed = false;
+    for (int n = 0; ; n++) {
+        FrameSlot* slot = pipeline.acquire(n, SLOT_DECODED);
+        if (slot == nullptr) {
+            break;
+        }
+        if (slot->endOfStream) {
+            pipeline.release(slot, SLOT_PROCESSED);
+            break;
+        }
+        
+        int64 processStart = cv::getTickCount();
+        
+        // Optionally remove JPEG blocking and impulse noise, denoise and
+        // average the frame with the previous ones first; the sharpening
+        // then starts from the result
+        const cv::Mat* base = &slot->input;
+        if (options.deblock) {
+            if (!applyDeblocking(slot->input, slot->deblocked, 1.0)) {
+                std::cerr << "ERROR: Deblocking failed on frame " << slot->frameIndex << "!" << std::endl;
+                processFailed = true;
+                pipeline.abort();
+                break;
+            }
+            base = &slot->deblocked;
+        }
+        if (options.medianRadius > 0) {
+            if (!applyMedianFilter(*base, slot->median, options.medianRadius)) {
+                std::cerr << "ERROR: Median filter failed on frame " << slot->frameIndex << "!" << std::endl;
+                processFailed = true;
+                pipeline.abort();
+                break;
+            }
+            base = &slot->median;
+        }
+        if (options.nlmStrength > 0) {
+            if (!applyNonLocalMeans(*base, slot->nlmDenoised, options.nlmStrength, 2, 5)) {
+                std::cerr << "ERROR: Non-local means denoising failed on frame " << slot->frameIndex << "!" << std::endl;
+                processFailed = true;
+                pipeline.abort();
+                break;
+            }
+            base = &slot->nlmDenoised;
+        }
+        if (options.waveletDenoise) {
+            if (!applyWaveletDenoise(*base, slot->waveletDenoised, 1.0, 3)) {
+                std::cerr << "ERROR: Wavelet denoising failed on frame " << slot->frameIndex << "!" << std::endl;
+                processFailed = true;
+                pipeline.abort();
+                break;
+            }
+            base = &slot->waveletDenoised;
+        }
+        if (options.temporalDenoise) {
+            if (!denoiser.process(*base, slot->denoised)) {
+                std::cerr << "ERROR: Temporal denoising failed on frame " << slot->frameIndex << "!" << std::endl;
+                processFailed = true;
+                pipeline.abort();
+                break;
+            }
+            base = &slot->denoised;
+        }
+        
+        // Find the flat tiles, which both filters copy through
+        const TileActivity* skipTiles = nullptr;
+        slot->skipRatio = 0.0;
+        if (sharpenThreshold > 0 && findFlatTiles(*base, tileMargin, sharpenThreshold, tiles)) {
+            skipTiles = &tiles;
+            slot->skipRatio = tiles.skipRatio();
+        }
+        
+        // Enhance into the slot's persistent buffers
+        applyGaussianBlur(*base, slot->blurred, gaussianKernelSize, gaussianSigma, skipTiles, options.blurMethod);
+        if (!applyUnsharpMask(*base, slot->blurred, slot->enhanced, sharpenAmount, sharpenThreshold, skipTiles)) {
+            std::cerr << "ERROR: Unsharp masking failed on frame " << slot->frameIndex << "!" << std::endl;
+            processFailed = true;
+            pipeline.abort();
+            break;
+        }
+        
+        // Quality against the reference frame, or against the input frame
+        const cv::Mat& target = hasReference ? slot->reference : slot->input;
+        slot->psnr = calculatePSNR(target, slot->enhanced);
+        slot->ssim = computeSSIM(target, slot->enhanced);
+        slot->baselinePsnr = 0.0;
+        slot->baselineSsim = 0.0;
+        if (hasReference) {
+            slot->baselinePsnr = calculatePSNR(slot->reference, slot->input);
+            slot->baselineSsim = computeSSIM(slot->reference, slot->input);
+        }
+        
+        slot->processMs = millisecondsSince(processStart);
+        pipeline.release(slot, SLOT_PROCESSED);
+    }
+    
+    decoder.join();
+    encoder.join();
+    
+    double seconds = millisecondsSince(startTicks) / 1000.0;
+    
+    // ================================================================
+    // STEP 2: SUMMARY
+    // ================================================================
+    
+    int frames = static_cast<int>(latencies.size());
+    std::cout << std::endl;
+    std::cout << "========================================" << std::endl;
+    std::cout << "RESULTS" << std::endl;
+    std::cout << "========================================" << std::endl << std::endl;
+    
+    if (frames == 0) {
+        std::cerr << "ERROR: No frames were enhanced!" << std::endl;
+        return -1;
+    }
+    
+    double meanLatency = 0.0;
+    for (size_t i = 0; i < latencies.size(); i++) {
+        meanLatency += latencies[i];
+    }
+    meanLatency /= frames;
+    double maxLatency = *std::max_element(latencies.begin(), latencies.end());
+    
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Frames enhanced:    " << frames << " in " << seconds << " s" << std::endl;
+    std::cout << "Sustained rate:     " << frames / seconds << " FPS" << std::endl;
+    std::cout << "Processing / frame: " << totalProcessMs / frames << " ms" << std::endl;
+    std::cout << "Latency / frame:    " << meanLatency << " ms (max " << maxLatency << " ms)" << std::endl;
+    if (sharpenThreshold > 0) {
+        std::cout << "Flat tiles skipped: " << 100.0 * totalSkipRatio / frames << "%" << std::endl;
+    }
+    std::cout << std::setprecision(4);
+    std::cout << "Mean PSNR:          ";
+    printMean(totalPsnr, psnrFrames, frames, " dB");
+    std::cout << (hasReference ? " (enhanced vs reference)" : " (enhanced vs input)") << std::endl;
+    std::cout << "Mean SSIM:          ";
+    printMean(totalSsim, ssimFrames, frames, "");
+    std::cout << std::endl;
+    if (hasReference) {
+        std::cout << "Mean input PSNR:    ";
+        printMean(totalBaselinePsnr, baselinePsnrFrames, frames, " dB");
+        std::cout << " (input vs reference)" << std::endl;
+        std::cout << "Mean input SSIM:    ";
+        printMean(totalBaselineSsim, baselineSsimFrames, frames, "");
+        std::cout << std::endl;
+    }
+    std::cout << "========================================" << std::endl;
+    
+    return (decodeFailed || processFailed || encodeFailed) ? -1 : 0;
+}
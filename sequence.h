@@ -0,0 +1,52 @@
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+
+#include "image_quality.h"
+#include <string>
+
+/**
+ * Optional stages of sequence mode
+ */
+struct SequenceOptions {
+    bool deblock;             // Remove JPEG blocking from each frame first
+    int medianRadius;         // Median filter radius against impulse noise (0 = off)
+    double nlmStrength;       // Non-local means strength h before sharpening (0 = off)
+    bool waveletDenoise;      // Wavelet shrinkage denoising before sharpening
+    bool temporalDenoise;     // Denoise each frame against the previous ones before sharpening
+    bool blockMatching;       // Motion-compensate the temporal history (block matching)
+    double sharpenThreshold;  // Unsharp mask threshold; above 0, flat tiles are skipped
+    BlurMethod blurMethod;    // Exact Gaussian blur or box cascade approximation
+};
+
+/**
+ * SEQUENCE MODE
+ * 
+ * Enhances every frame of a video file or of a numbered image sequence
+ * (a printf-style pattern such as frames/frame_%04d.png) in one run.
+ * 
+ * Frames flow through a three-stage pipeline so decoding, filtering and
+ * encoding overlap:
+ *   1. Decode thread: reads the next input (and reference) frame
+ *   2. Main thread: optional deblocking, median filter, non-local means,
+ *      wavelet and temporal denoise, blur + unsharp mask on the shared
+ *      thread pool, then PSNR and SSIM
+ *   3. Encode thread: writes the enhanced frame
+ * 
+ * The stages pass a small ring of frame slots to each other. Every slot
+ * keeps its image buffers for the whole run, so after the first few frames
+ * no frame buffer is allocated again.
+ * 
+ * Per-frame processing time, latency (decode start to encode end) and
+ * quality are printed, followed by the sustained frame rate (and the share
+ * of flat tiles skipped when a sharpening threshold is set).
+ * 
+ * @param inputSource Video file or numbered image pattern to enhance
+ * @param referenceSource Optional clean reference (same frame count);
+ *                        when empty, frames are compared to the input
+ * @param options Optional stages
+ * @return int 0 on success, -1 on error
+ */
+int runSequenceMode(const std::string& inputSource, const std::string& referenceSource,
+                    const SequenceOptions& options);
+
+#endif // SEQUENCE_H
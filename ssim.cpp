@@ -1,5 +1,456 @@
 #include "image_quality.h"
+#include "cpu_features.h"
+#include "thread_pool.h"
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#if HAVE_ISA_VARIANTS
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/**
+ * SSIM of one window from its means, variances and covariance
+ * 
+ *     SSIM = [(2*mu_A*mu_B + C1) * (2*sigma_AB + C2)] /
+ *            [(mu_A^2 + mu_B^2 + C1) * (sigma_A^2 + sigma_B^2 + C2)]
+ * 
+ * Luminance * structure over luminance * contrast, in float32.
+ */
+FORCE_INLINE float ssimOfWindow(float muA, float muB, float varianceA, float varianceB, float covariance,
+                                float C1, float C2) {
+    float numerator = (2.0f * muA * muB + C1) * (2.0f * covariance + C2);
+    float denominator = (muA * muA + muB * muB + C1) * (varianceA + varianceB + C2);
+    return numerator / denominator;
+}
+
+/**
+ * Sum of the SSIM map over one row, evaluated from the filtered moments
+ * 
+ * The whole formula runs per sample in registers, from the five Gaussian-
+ * filtered moments to the running sum:
+ *     sigma_A^2 = E[A^2] - mu_A^2,  sigma_B^2 = E[B^2] - mu_B^2
+ *     sigma_AB  = E[A*B] - mu_A * mu_B
+ * then ssimOfWindow, in float32 as the cv::Mat operations it replaces
+ * did; the row sum is kept in double.
+ * 
+ * @param meanA, meanB Local means mu_A and mu_B
+ * @param meanAA, meanBB, meanAB Local means of A^2, B^2 and A*B
+ * @param cols Pixels in the row
+ * @param channels Samples per pixel (only the first channel is summed)
+ * @param C1, C2 Stabilizing constants
+ * @return double Sum of the SSIM values of the first channel
+ */
+double ssimRowSum(const float* meanA, const float* meanB, const float* meanAA, const float* meanBB,
+                  const float* meanAB, int cols, int channels, float C1, float C2) {
+    double sum = 0.0;
+    for (int x = 0; x < cols; x++) {
+        int i = x * channels;
+        float muA = meanA[i], muB = meanB[i];
+        
+        // Variance and covariance of the window around this pixel
+        float varianceA = meanAA[i] - muA * muA;
+        float varianceB = meanBB[i] - muB * muB;
+        float covariance = meanAB[i] - muA * muB;
+        
+        sum += ssimOfWindow(muA, muB, varianceA, varianceB, covariance, C1, C2);
+    }
+    return sum;
+}
+
+// ================================================================
+// HALF-PRECISION (FP16) CONVERSION
+// ================================================================
+
+/**
+ * IEEE half-precision bits of a float, rounded to nearest even
+ * (portable version of the F16C conversion)
+ */
+uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7fffffffu;
+    
+    if (magnitude >= 0x7f800000u) {
+        // Infinity stays infinity, NaN stays a (quiet) NaN
+        return static_cast<uint16_t>(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+    }
+    if (magnitude >= 0x477ff000u) {
+        // Rounds to 65536 or more: overflow to infinity
+        return static_cast<uint16_t>(sign | 0x7c00u);
+    }
+    if (magnitude < 0x38800000u) {
+        // Below the smallest normal half (2^-14): subnormal or zero
+        if (magnitude < 0x33000000u) {
+            return static_cast<uint16_t>(sign);
+        }
+        int exponent = static_cast<int>(magnitude >> 23);
+        uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+        int shift = 126 - exponent;  // value = mantissa × 2^(exponent - 150), half units are 2^-24
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1u))) {
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    
+    // Normal: rebias the exponent and round the mantissa to 10 bits
+    uint32_t half = ((magnitude - 0x38000000u) >> 13);
+    uint32_t remainder = magnitude & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) {
+        half++;  // May carry into the exponent, which is still correct
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+/**
+ * Float value of IEEE half-precision bits (portable version)
+ */
+float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0x1fu) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {
+        // Subnormal half: normalize the mantissa
+        int shift = 0;
+        while ((mantissa & 0x400u) == 0) {
+            mantissa <<= 1;
+            shift++;
+        }
+        bits = sign | (static_cast<uint32_t>(113 - shift) << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+typedef void (*FloatToHalfRowFn)(const float*, uint16_t*, int);
+typedef void (*HalfToFloatRowFn)(const uint16_t*, float*, int);
+
+void floatToHalfRowGeneric(const float* in, uint16_t* out, int length) {
+    for (int i = 0; i < length; i++) {
+        out[i] = floatToHalf(in[i]);
+    }
+}
+
+void halfToFloatRowGeneric(const uint16_t* in, float* out, int length) {
+    for (int i = 0; i < length; i++) {
+        out[i] = halfToFloat(in[i]);
+    }
+}
+
+#if HAVE_ISA_VARIANTS
+// F16C converts 8 values per instruction; it is the AVX2 (and AVX-512)
+// variant, but only where the CPU reports F16C (a virtual machine can
+// hide it while exposing AVX2 and FMA)
+ISA_TARGET_AVX2_F16C void floatToHalfRowF16C(const float* in, uint16_t* out, int length) {
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m128i halves = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), halves);
+    }
+    for (; i < length; i++) {
+        out[i] = floatToHalf(in[i]);
+    }
+}
+
+ISA_TARGET_AVX2_F16C void halfToFloatRowF16C(const uint16_t* in, float* out, int length) {
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(halves));
+    }
+    for (; i < length; i++) {
+        out[i] = halfToFloat(in[i]);
+    }
+}
+
+const KernelVariants<FloatToHalfRowFn> floatToHalfRowVariants = {
+    "float to FP16", floatToHalfRowGeneric, nullptr, cpuSupportsF16C() ? floatToHalfRowF16C : nullptr, nullptr
+};
+const KernelVariants<HalfToFloatRowFn> halfToFloatRowVariants = {
+    "FP16 to float", halfToFloatRowGeneric, nullptr, cpuSupportsF16C() ? halfToFloatRowF16C : nullptr, nullptr
+};
+#else
+const KernelVariants<FloatToHalfRowFn> floatToHalfRowVariants = {
+    "float to FP16", floatToHalfRowGeneric, nullptr, nullptr, nullptr
+};
+const KernelVariants<HalfToFloatRowFn> halfToFloatRowVariants = {
+    "FP16 to float", halfToFloatRowGeneric, nullptr, nullptr, nullptr
+};
+#endif
+
+// Best variants for this CPU, chosen once at startup
+const FloatToHalfRowFn floatToHalfRow = selectKernel(floatToHalfRowVariants);
+const HalfToFloatRowFn halfToFloatRow = selectKernel(halfToFloatRowVariants);
+
+// Storage requested with setSSIMStorage()
+std::atomic<int> requestedSSIMStorage(SSIM_STORAGE_FLOAT32);
+
+// Rows on each side of a row the 11x11 SSIM window reads
+const int ssimWindowRadius = 5;
+
+/**
+ * Split the rows of an image into bands for the shared thread pool
+ */
+int ssimBandCount(int rows) {
+    return std::max(1, std::min(rows, ThreadPool::instance().threadCount() * 4));
+}
+
+/**
+ * Sum of the SSIM map with the filtered moments in float32 planes
+ * 
+ * The images, their squares and product and the five filtered moments
+ * are all full-frame float32 planes.
+ * 
+ * @param imageA, imageB The images (same size and type)
+ * @param C1, C2 Stabilizing constants
+ * @return double Sum of the SSIM values of the first channel
+ */
+double ssimSumFloatStorage(const cv::Mat& imageA, const cv::Mat& imageB, double C1, double C2) {
+    // Convert from integer pixel values (0-255) to floating point
+    // This prevents integer overflow and provides precision for calculations
+    cv::Mat floatImageA, floatImageB;
+    
+    // CV_32F = 32-bit floating point data type
+    imageA.convertTo(floatImageA, CV_32F);
+    imageB.convertTo(floatImageB, CV_32F);
+    
+    // We need these products for variance and covariance calculations
+    // mul() performs element-wise multiplication (each pixel multiplied independently)
+    cv::Mat squaredA = floatImageA.mul(floatImageA);  // A^2: squaring image A
+    cv::Mat squaredB = floatImageB.mul(floatImageB);  // B^2: squaring image B
+    cv::Mat product = floatImageA.mul(floatImageB);   // A*B: product of A and B
+    
+    // GaussianBlur creates a weighted average of neighboring pixels
+    // This gives us the local mean (mu) for each pixel region
+    // Parameters:
+    //   - 11: 11x11 pixel window (standard for SSIM)
+    //   - 1.5: sigma (standard deviation of Gaussian kernel)
+    //
+    // The five blurs are independent, so they run as one task group on the
+    // shared thread pool (each blur is additionally split into row bands)
+    
+    cv::Mat meanA, meanB;
+    cv::Mat meanAA, meanBB, meanAB;
+    
+    TaskGroup blurs;
+    
+    // Calculate local mean of image A at each pixel location
+    blurs.run([&]() { meanA = applyGaussianBlur(floatImageA, 11, 1.5); });
+    
+    // Calculate local mean of image B at each pixel location
+    blurs.run([&]() { meanB = applyGaussianBlur(floatImageB, 11, 1.5); });
+    
+    // Local means of the squares and of the product: E[A^2], E[B^2], E[A*B]
+    blurs.run([&]() { meanAA = applyGaussianBlur(squaredA, 11, 1.5); });
+    blurs.run([&]() { meanBB = applyGaussianBlur(squaredB, 11, 1.5); });
+    blurs.run([&]() { meanAB = applyGaussianBlur(product, 11, 1.5); });
+    
+    blurs.wait();
+    
+    // Variance, covariance, the SSIM formula and the mean are evaluated
+    // together, one sample at a time (see ssimRowSum), so none of the
+    // intermediate planes is ever written to memory
+    //
+    // Only the first channel is averaged (the value cv::mean(ssimMap)[0]
+    // gave when the whole SSIM map was built), so the other channels of
+    // color images are not evaluated at all
+    //
+    // Each band writes its partial sum into its own slot, and the slots are
+    // added in order afterwards so the result does not depend on scheduling
+    int numBands = ssimBandCount(imageA.rows);
+    std::vector<double> bandSums(numBands, 0.0);
+    
+    parallelFor(0, numBands, [&](int bandBegin, int bandEnd) {
+        for (int band = bandBegin; band < bandEnd; band++) {
+            int rowBegin = imageA.rows * band / numBands;
+            int rowEnd = imageA.rows * (band + 1) / numBands;
+            for (int y = rowBegin; y < rowEnd; y++) {
+                bandSums[band] += ssimRowSum(meanA.ptr<float>(y), meanB.ptr<float>(y),
+                                             meanAA.ptr<float>(y), meanBB.ptr<float>(y),
+                                             meanAB.ptr<float>(y), imageA.cols, imageA.channels(),
+                                             static_cast<float>(C1), static_cast<float>(C2));
+            }
+        }
+    }, 1);
+    
+    double ssimSum = 0.0;
+    for (int band = 0; band < numBands; band++) {
+        ssimSum += bandSums[band];
+    }
+    return ssimSum;
+}
+
+/**
+ * Sum of the SSIM map with the filtered moments in FP16 planes
+ * 
+ * The same two steps as ssimSumFloatStorage, with the five moment planes
+ * in half precision: the means mu_A and mu_B, and the variances and
+ * covariance computed in float32 before rounding. Storing E[A^2] itself
+ * would not work: near 255^2 FP16 values are 32 apart, while the variance
+ * subtracted from it is often a few gray levels^2.
+ * 
+ * Pass 1 blurs band by band straight from the images: each band is
+ * converted to float32 with the window radius on each side and its squares
+ * and product are formed in band-sized work images, so no float32 plane
+ * the size of the frame is built. Pass 2 converts the moments back to
+ * float32 one row at a time and evaluates the formula. The moment planes
+ * take 10 bytes per sample, against 20 for the float32 moment planes (and
+ * 20 more for the float32 images, squares and product), and the rounding
+ * is what --ssim-validate measures.
+ * 
+ * @param imageA, imageB The images (same size and type)
+ * @param C1, C2 Stabilizing constants
+ * @return double Sum of the SSIM values of the first channel
+ */
+double ssimSumHalfStorage(const cv::Mat& imageA, const cv::Mat& imageB, double C1, double C2) {
+    const int rows = imageA.rows;
+    const int cols = imageA.cols;
+    const int channels = imageA.channels();
+    const int rowLength = cols * channels;
+    const int floatType = CV_32FC(channels);
+    
+    // The five moment planes: mu_A, mu_B, sigma_A^2, sigma_B^2, sigma_AB
+    // (raw FP16 bits, one 16-bit value per sample)
+    cv::Mat moments[5];
+    for (int m = 0; m < 5; m++) {
+        moments[m].create(rows, rowLength, CV_16U);
+    }
+    
+    // Pass 1: blur band by band and store the moments in FP16
+    int numBands = ssimBandCount(rows);
+    parallelFor(0, numBands, [&](int bandBegin, int bandEnd) {
+        // A, B, A^2, B^2, A*B and their local means, reused across bands
+        cv::Mat planes[5], means[5];
+        std::vector<float> centered(rowLength);
+        for (int band = bandBegin; band < bandEnd; band++) {
+            int rowBegin = rows * band / numBands;
+            int rowEnd = rows * (band + 1) / numBands;
+            int haloBegin = std::max(0, rowBegin - ssimWindowRadius);
+            int haloEnd = std::min(rows, rowEnd + ssimWindowRadius);
+            imageA.rowRange(haloBegin, haloEnd).convertTo(planes[0], CV_32F);
+            imageB.rowRange(haloBegin, haloEnd).convertTo(planes[1], CV_32F);
+            for (int m = 2; m < 5; m++) {
+                planes[m].create(haloEnd - haloBegin, cols, floatType);
+            }
+            for (int by = 0; by < haloEnd - haloBegin; by++) {
+                const float* a = planes[0].ptr<float>(by);
+                const float* b = planes[1].ptr<float>(by);
+                float* aa = planes[2].ptr<float>(by);
+                float* bb = planes[3].ptr<float>(by);
+                float* ab = planes[4].ptr<float>(by);
+                for (int i = 0; i < rowLength; i++) {
+                    aa[i] = a[i] * a[i];
+                    bb[i] = b[i] * b[i];
+                    ab[i] = a[i] * b[i];
+                }
+            }
+            
+            // The halo gives the window every row it reads, so the band
+            // rows of the means are those of the full-frame blur
+            for (int m = 0; m < 5; m++) {
+                applyGaussianBlur(planes[m], means[m], 11, 1.5);
+            }
+            
+            for (int y = rowBegin; y < rowEnd; y++) {
+                int by = y - haloBegin;
+                const float* muA = means[0].ptr<float>(by);
+                const float* muB = means[1].ptr<float>(by);
+                floatToHalfRow(muA, moments[0].ptr<uint16_t>(y), rowLength);
+                floatToHalfRow(muB, moments[1].ptr<uint16_t>(y), rowLength);
+                
+                // Variances and covariance in float32, then rounded
+                const float* meanAA = means[2].ptr<float>(by);
+                for (int i = 0; i < rowLength; i++) {
+                    centered[i] = meanAA[i] - muA[i] * muA[i];
+                }
+                floatToHalfRow(&centered[0], moments[2].ptr<uint16_t>(y), rowLength);
+                const float* meanBB = means[3].ptr<float>(by);
+                for (int i = 0; i < rowLength; i++) {
+                    centered[i] = meanBB[i] - muB[i] * muB[i];
+                }
+                floatToHalfRow(&centered[0], moments[3].ptr<uint16_t>(y), rowLength);
+                const float* meanAB = means[4].ptr<float>(by);
+                for (int i = 0; i < rowLength; i++) {
+                    centered[i] = meanAB[i] - muA[i] * muB[i];
+                }
+                floatToHalfRow(&centered[0], moments[4].ptr<uint16_t>(y), rowLength);
+            }
+        }
+    }, 1);
+    
+    // Pass 2: read the moments back row by row and evaluate the formula
+    // (ssimOfWindow directly, since the planes hold the centered moments
+    // that ssimRowSum would compute); each band writes its partial sum into
+    // its own slot, added in order afterwards
+    std::vector<double> bandSums(numBands, 0.0);
+    const float c1 = static_cast<float>(C1), c2 = static_cast<float>(C2);
+    parallelFor(0, numBands, [&](int bandBegin, int bandEnd) {
+        std::vector<float> row(5 * static_cast<size_t>(rowLength));
+        for (int band = bandBegin; band < bandEnd; band++) {
+            int rowBegin = rows * band / numBands;
+            int rowEnd = rows * (band + 1) / numBands;
+            for (int y = rowBegin; y < rowEnd; y++) {
+                for (int m = 0; m < 5; m++) {
+                    halfToFloatRow(moments[m].ptr<uint16_t>(y), &row[m * static_cast<size_t>(rowLength)], rowLength);
+                }
+                const float* muA = &row[0];
+                const float* muB = muA + rowLength;
+                const float* varianceA = muB + rowLength;
+                const float* varianceB = varianceA + rowLength;
+                const float* covariance = varianceB + rowLength;
+                
+                double sum = 0.0;
+                for (int i = 0; i < rowLength; i += channels) {
+                    sum += ssimOfWindow(muA[i], muB[i], varianceA[i], varianceB[i], covariance[i], c1, c2);
+                }
+                bandSums[band] += sum;
+            }
+        }
+    }, 1);
+    
+    double ssimSum = 0.0;
+    for (int band = 0; band < numBands; band++) {
+        ssimSum += bandSums[band];
+    }
+    return ssimSum;
+}
+
+}
+
+void setSSIMStorage(SSIMStorage storage) {
+    requestedSSIMStorage = storage;
+}
+
+SSIMStorage activeSSIMStorage() {
+    return static_cast<SSIMStorage>(requestedSSIMStorage.load());
+}
+
+const char* ssimStorageName(SSIMStorage storage) {
+    switch (storage) {
+        case SSIM_STORAGE_FLOAT16:  return "FP16";
+        case SSIM_STORAGE_VALIDATE: return "FP16 (checked against float32)";
+        default:                    return "float32";
+    }
+}
 
 /**
  * Structural Similarity Index (SSIM) Function
@@ -55,144 +506,37 @@ double computeSSIM(const cv::Mat& imageA, const cv::Mat& imageB) {
     
     
     // ============================================================
-    // PART 3: CONVERT IMAGES TO FLOATING POINT
-    // ============================================================
-    
-    // Convert from integer pixel values (0-255) to floating point
-    // This prevents integer overflow and provides precision for calculations
-    cv::Mat floatImageA, floatImageB;
-    
-    // CV_32F = 32-bit floating point data type
-    imageA.convertTo(floatImageA, CV_32F);
-    imageB.convertTo(floatImageB, CV_32F);
-    
-    
+    // PART 3: FILTERED MOMENTS, SSIM FORMULA AND AVERAGE
     // ============================================================
-    // PART 4: CALCULATE PIXEL-WISE PRODUCTS
-    // ============================================================
-    
-    // We need these products for variance and covariance calculations
-    // mul() performs element-wise multiplication (each pixel multiplied independently)
-    
-    cv::Mat imageA_squared = floatImageA.mul(floatImageA);  // A^2: squaring image A
-    cv::Mat imageB_squared = floatImageB.mul(floatImageB);  // B^2: squaring image B
-    cv::Mat imageA_times_B = floatImageA.mul(floatImageB);  // A*B: product of A and B
-    
-    
-    // ============================================================
-    // PART 5: COMPUTE LOCAL MEANS USING GAUSSIAN BLUR
-    // ============================================================
-    
-    // GaussianBlur creates a weighted average of neighboring pixels
-    // This gives us the local mean (mu) for each pixel region
-    // Parameters:
-    //   - cv::Size(11, 11): 11x11 pixel window (standard for SSIM)
-    //   - 1.5: sigma (standard deviation of Gaussian kernel)
-    
-    cv::Mat meanA, meanB;
-    
-    // Calculate local mean of image A at each pixel location
-    cv::GaussianBlur(floatImageA, meanA, cv::Size(11, 11), 1.5);
-    
-    // Calculate local mean of image B at each pixel location
-    cv::GaussianBlur(floatImageB, meanB, cv::Size(11, 11), 1.5);
     
+    // The five Gaussian-filtered moments are kept in float32 planes, or
+    // in half-precision planes for very large images (see SSIMStorage);
+    // either way the formula itself is evaluated in float32
+    SSIMStorage storage = activeSSIMStorage();
+    double ssimSum = 0.0;
+    if (storage != SSIM_STORAGE_FLOAT16) {
+        ssimSum = ssimSumFloatStorage(imageA, imageB, C1, C2);
+    }
+    if (storage != SSIM_STORAGE_FLOAT32) {
+        double halfSum = ssimSumHalfStorage(imageA, imageB, C1, C2);
+        if (storage == SSIM_STORAGE_VALIDATE) {
+            // One line per call, so concurrent calls (batch mode) do not mix
+            double pixels = static_cast<double>(imageA.rows) * imageA.cols;
+            std::ostringstream report;
+            report << std::setprecision(8) << "  SSIM storage check: float32 " << ssimSum / pixels
+                   << ", FP16 " << halfSum / pixels << ", deviation " << std::scientific
+                   << std::setprecision(2) << std::abs(halfSum - ssimSum) / pixels << "\n";
+            std::cout << report.str() << std::flush;
+        }
+        ssimSum = halfSum;
+    }
     
-    // ============================================================
-    // PART 6: COMPUTE PRODUCTS OF MEANS
-    // ============================================================
-    
-    // We need these for the SSIM formula calculations
-    
-    cv::Mat meanA_squared = meanA.mul(meanA);  // mu_A^2
-    cv::Mat meanB_squared = meanB.mul(meanB);  // mu_B^2
-    cv::Mat meanA_times_meanB = meanA.mul(meanB);  // mu_A * mu_B
-    
-    
-    // ============================================================
-    // PART 7: COMPUTE VARIANCE AND COVARIANCE
-    // ============================================================
-    
-    // Variance formula: Var(X) = E[X^2] - (E[X])^2
-    //   where E[X] is the expected value (mean) of X
-    //
-    // Covariance formula: Cov(X,Y) = E[XY] - E[X]*E[Y]
-    
-    cv::Mat varianceA, varianceB, covariance;
-    
-    // Variance of image A: sigma_A^2 = E[A^2] - (E[A])^2
-    cv::GaussianBlur(imageA_squared, varianceA, cv::Size(11, 11), 1.5);  // E[A^2]
-    varianceA = varianceA - meanA_squared;  // Subtract (E[A])^2
-    
-    // Variance of image B: sigma_B^2 = E[B^2] - (E[B])^2
-    cv::GaussianBlur(imageB_squared, varianceB, cv::Size(11, 11), 1.5);  // E[B^2]
-    varianceB = varianceB - meanB_squared;  // Subtract (E[B])^2
-    
-    // Covariance: sigma_AB = E[A*B] - E[A]*E[B]
-    cv::GaussianBlur(imageA_times_B, covariance, cv::Size(11, 11), 1.5);  // E[A*B]
-    covariance = covariance - meanA_times_meanB;  // Subtract E[A]*E[B]
-    
-    
-    // ============================================================
-    // PART 8: APPLY THE SSIM FORMULA
-    // ============================================================
-    
-    // SSIM formula:
-    // SSIM = [(2*mu_A*mu_B + C1) * (2*sigma_AB + C2)] /
-    //        [(mu_A^2 + mu_B^2 + C1) * (sigma_A^2 + sigma_B^2 + C2)]
-    //
-    // This combines:
-    //   - Luminance comparison (means)
-    //   - Contrast comparison (variances)
-    //   - Structure comparison (covariance)
-    
-    // --- Calculate Numerator ---
-    
-    // Luminance component: 2*mu_A*mu_B + C1
-    cv::Mat luminance_numerator = 2.0 * meanA_times_meanB + C1;
-    
-    // Structure component: 2*sigma_AB + C2
-    cv::Mat structure_numerator = 2.0 * covariance + C2;
-    
-    // Multiply luminance and structure components
-    cv::Mat numerator = luminance_numerator.mul(structure_numerator);
-    
-    
-    // --- Calculate Denominator ---
-    
-    // Luminance component: mu_A^2 + mu_B^2 + C1
-    cv::Mat luminance_denominator = meanA_squared + meanB_squared + C1;
-    
-    // Contrast component: sigma_A^2 + sigma_B^2 + C2
-    cv::Mat contrast_denominator = varianceA + varianceB + C2;
-    
-    // Multiply luminance and contrast components
-    cv::Mat denominator = luminance_denominator.mul(contrast_denominator);
-    
-    
-    // --- Compute SSIM Map ---
-    
-    // Divide numerator by denominator to get SSIM value at each pixel
-    cv::Mat ssimMap;
-    cv::divide(numerator, denominator, ssimMap);
-    
-    
-    // ============================================================
-    // PART 9: CALCULATE THE MEAN SSIM VALUE
-    // ============================================================
-    
-    // Average all pixel-wise SSIM values to get a single metric
-    // cv::mean() returns a Scalar with one value per channel
-    cv::Scalar meanSSIM = cv::mean(ssimMap);
-    
-    // Extract the SSIM value from the first channel
-    // For grayscale images, this is the only channel
-    // For color images, you might want to average all channels
-    double ssimValue = meanSSIM[0];
+    // Average of the per-pixel SSIM values
+    double ssimValue = ssimSum / (static_cast<double>(imageA.rows) * imageA.cols);
     
     
     // ============================================================
-    // PART 10: RETURN THE RESULT
+    // PART 4: RETURN THE RESULT
     // ============================================================
     
     // Return the final SSIM score
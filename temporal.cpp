@@ -0,0 +1,223 @@
+#include "temporal.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+namespace {
+
+/**
+ * Sum of absolute differences between a block of the frame and the block
+ * displaced by (dx, dy) in the history
+ * 
+ * Every other row and every other sample is compared: a quarter of the
+ * work, and plenty to find the motion of textured or noisy content.
+ */
+int blockSad(const cv::Mat& frame, const cv::Mat& history, int x0, int y0,
+             int blockWidth, int blockHeight, int dx, int dy) {
+    const int channels = frame.channels();
+    const int length = blockWidth * channels;
+    int sad = 0;
+    for (int y = 0; y < blockHeight; y += 2) {
+        const unsigned char* current = frame.ptr<unsigned char>(y0 + y) + x0 * channels;
+        const unsigned char* previous = history.ptr<unsigned char>(y0 + y + dy) + (x0 + dx) * channels;
+        for (int i = 0; i < length; i += 2) {
+            sad += std::abs(current[i] - previous[i]);
+        }
+    }
+    return sad;
+}
+
+}
+
+TemporalDenoiseParams defaultTemporalDenoiseParams() {
+    TemporalDenoiseParams params;
+    params.strength = 0.75;
+    params.gateLow = 12;
+    params.gateHigh = 40;
+    params.blockMatching = false;
+    params.blockSize = 16;
+    params.searchRadius = 8;
+    return params;
+}
+
+TemporalDenoiser::TemporalDenoiser(const TemporalDenoiseParams& params)
+    : params(params), blocksPerRow(0) {
+    // Blend weight per absolute difference, in 1/256 steps
+    //   - up to gateLow: full strength (noise)
+    //   - gateLow to gateHigh: fades out linearly
+    //   - from gateHigh: 0, the current pixel is kept (motion)
+    double strength = std::min(1.0, std::max(0.0, params.strength));
+    int gateLow = std::max(0, this->params.gateLow);
+    int gateHigh = std::max(gateLow + 1, this->params.gateHigh);
+    for (int d = 0; d < 256; d++) {
+        double fade = 1.0;
+        if (d >= gateHigh) {
+            fade = 0.0;
+        } else if (d > gateLow) {
+            fade = static_cast<double>(gateHigh - d) / (gateHigh - gateLow);
+        }
+        weights[d] = static_cast<int>(std::round(256.0 * strength * fade));
+    }
+}
+
+void TemporalDenoiser::reset() {
+    history.release();
+    nextHistory.release();
+    motion.clear();
+}
+
+/**
+ * Find the displacement of every block between the history and the frame
+ * 
+ * Diamond search: starting from the best of (0, 0), the block's vector in
+ * the previous frame and its left neighbour's vector, steps of 2 pixels
+ * are taken towards lower SAD until none improves, then one refinement
+ * with steps of 1 pixel. This checks around 20 positions per block
+ * instead of the (2 × radius + 1)^2 of a full search.
+ */
+void TemporalDenoiser::estimateMotion(const cv::Mat& frame) {
+    const int blockSize = std::max(4, params.blockSize);
+    const int radius = std::max(0, params.searchRadius);
+    const int blockRows = (frame.rows + blockSize - 1) / blockSize;
+    const int newBlocksPerRow = (frame.cols + blockSize - 1) / blockSize;
+    
+    // Vectors of the previous frame are kept as predictors
+    if (newBlocksPerRow != blocksPerRow || static_cast<int>(motion.size()) != blockRows * newBlocksPerRow) {
+        blocksPerRow = newBlocksPerRow;
+        motion.assign(blockRows * blocksPerRow, cv::Point(0, 0));
+    }
+    
+    parallelFor(0, blockRows, [&](int rowBegin, int rowEnd) {
+        for (int by = rowBegin; by < rowEnd; by++) {
+            int y0 = by * blockSize;
+            int blockHeight = std::min(blockSize, frame.rows - y0);
+            
+            for (int bx = 0; bx < blocksPerRow; bx++) {
+                int x0 = bx * blockSize;
+                int blockWidth = std::min(blockSize, frame.cols - x0);
+                
+                // A candidate is valid if the displaced block lies inside the frame
+                auto valid = [&](const cv::Point& v) {
+                    return std::abs(v.x) <= radius && std::abs(v.y) <= radius &&
+                           x0 + v.x >= 0 && x0 + v.x + blockWidth <= frame.cols &&
+                           y0 + v.y >= 0 && y0 + v.y + blockHeight <= frame.rows;
+                };
+                auto cost = [&](const cv::Point& v) {
+                    return blockSad(frame, history, x0, y0, blockWidth, blockHeight, v.x, v.y);
+                };
+                
+                // Start from the best predictor
+                cv::Point best(0, 0);
+                int bestCost = cost(best);
+                cv::Point predictors[2] = {motion[by * blocksPerRow + bx],
+                                           bx > 0 ? motion[by * blocksPerRow + bx - 1] : cv::Point(0, 0)};
+                for (int p = 0; p < 2; p++) {
+                    if (predictors[p] != best && valid(predictors[p])) {
+                        int c = cost(predictors[p]);
+                        if (c < bestCost) {
+                            bestCost = c;
+                            best = predictors[p];
+                        }
+                    }
+                }
+                
+                // Large diamond (step 2) until the center is best, then small diamond (step 1)
+                for (int step = 2; step >= 1; step--) {
+                    bool improved = true;
+                    for (int iteration = 0; improved && iteration < radius; iteration++) {
+                        improved = false;
+                        const cv::Point offsets[4] = {cv::Point(step, 0), cv::Point(-step, 0),
+                                                      cv::Point(0, step), cv::Point(0, -step)};
+                        cv::Point center = best;
+                        for (int k = 0; k < 4; k++) {
+                            cv::Point candidate = center + offsets[k];
+                            if (!valid(candidate)) {
+                                continue;
+                            }
+                            int c = cost(candidate);
+                            if (c < bestCost) {
+                                bestCost = c;
+                                best = candidate;
+                                improved = true;
+                            }
+                        }
+                        if (step == 1) {
+                            break;
+                        }
+                    }
+                }
+                
+                motion[by * blocksPerRow + bx] = best;
+            }
+        }
+    });
+}
+
+bool TemporalDenoiser::process(const cv::Mat& frame, cv::Mat& output) {
+    // Validate the frame
+    if (frame.empty()) {
+        std::cerr << "Error: Input frame cannot be empty!" << std::endl;
+        return false;
+    }
+    if (frame.depth() != CV_8U) {
+        std::cerr << "Error: Temporal denoising requires 8-bit frames!" << std::endl;
+        return false;
+    }
+    
+    // First frame (or a new format): nothing to average with yet
+    if (history.size() != frame.size() || history.type() != frame.type()) {
+        reset();
+        frame.copyTo(history);
+        frame.copyTo(output);
+        return true;
+    }
+    
+    if (params.blockMatching) {
+        estimateMotion(frame);
+    }
+    
+    output.create(frame.size(), frame.type());
+    nextHistory.create(frame.size(), frame.type());
+    
+    const int channels = frame.channels();
+    const int blockSize = std::max(4, params.blockSize);
+    const bool compensate = params.blockMatching;
+    
+    // Blend every row with its (motion-compensated) history row
+    // Integer arithmetic: out = (cur × (256 - w) + prev × w + 128) / 256
+    parallelFor(0, frame.rows, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            const unsigned char* current = frame.ptr<unsigned char>(y);
+            unsigned char* out = output.ptr<unsigned char>(y);
+            unsigned char* next = nextHistory.ptr<unsigned char>(y);
+            
+            // Without block matching the whole row is one segment with no motion
+            int segments = compensate ? blocksPerRow : 1;
+            for (int s = 0; s < segments; s++) {
+                int x0 = compensate ? s * blockSize : 0;
+                int x1 = compensate ? std::min(frame.cols, x0 + blockSize) : frame.cols;
+                cv::Point v = compensate ? motion[(y / blockSize) * blocksPerRow + s] : cv::Point(0, 0);
+                
+                const unsigned char* previous = history.ptr<unsigned char>(y + v.y) + (x0 + v.x) * channels;
+                int begin = x0 * channels;
+                int length = (x1 - x0) * channels;
+                
+                for (int i = 0; i < length; i++) {
+                    int cur = current[begin + i];
+                    int prev = previous[i];
+                    int w = weights[std::abs(cur - prev)];
+                    unsigned char value = static_cast<unsigned char>((cur * (256 - w) + prev * w + 128) >> 8);
+                    out[begin + i] = value;
+                    next[begin + i] = value;
+                }
+            }
+        }
+    });
+    
+    // The denoised frame becomes the history of the next frame
+    std::swap(history, nextHistory);
+    return true;
+}
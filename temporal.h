@@ -0,0 +1,81 @@
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+/**
+ * Temporal denoising for video
+ * 
+ * Noise changes from frame to frame while the scene mostly does not, so
+ * averaging each pixel with the same pixel of earlier frames removes noise
+ * without the loss of detail of a spatial blur.
+ * 
+ * The filter is recursive: it keeps a single history frame (the previous
+ * denoised frame) and blends every new frame into it,
+ *     output = current + w × (history - current)
+ * where the weight w depends on |current - history|. Small differences
+ * (noise) are averaged with the full strength; large differences (motion,
+ * scene changes) are passed through untouched so moving objects do not
+ * leave ghost trails. With block matching enabled, the history is first
+ * motion-compensated per block, so panning content is averaged as well.
+ */
+
+/**
+ * Temporal denoise parameters
+ */
+struct TemporalDenoiseParams {
+    double strength;     // History weight for static pixels (0 to 1, e.g. 0.75)
+    int gateLow;         // Differences up to this are averaged with full strength
+    int gateHigh;        // Differences from this on are treated as motion (no averaging)
+    bool blockMatching;  // Motion-compensate the history per block
+    int blockSize;       // Block size for block matching (e.g. 16)
+    int searchRadius;    // Largest motion searched, in pixels (e.g. 8)
+};
+
+/**
+ * Default parameters: strength 0.75, gate 12 to 40 gray levels,
+ * no block matching (16x16 blocks, radius 8 when enabled)
+ */
+TemporalDenoiseParams defaultTemporalDenoiseParams();
+
+/**
+ * Recursive temporal denoiser holding the history of one sequence
+ * 
+ * Frames must be passed in display order. Memory use is two frames: the
+ * history and the buffer the next history is written into.
+ */
+class TemporalDenoiser {
+public:
+    explicit TemporalDenoiser(const TemporalDenoiseParams& params);
+    
+    /**
+     * Denoise the next frame of the sequence
+     * 
+     * The first frame (and any frame whose size or type differs from the
+     * previous one) is passed through and starts a new history.
+     * 
+     * @param frame Next input frame (8-bit, any number of channels)
+     * @param output Denoised frame; its buffer is reused when it already
+     *               has the right size and type (must not share data with frame)
+     * @return bool False if the frame is empty or not 8-bit
+     */
+    bool process(const cv::Mat& frame, cv::Mat& output);
+    
+    /**
+     * Forget the history (e.g. at a scene cut)
+     */
+    void reset();
+
+private:
+    void estimateMotion(const cv::Mat& frame);
+    
+    TemporalDenoiseParams params;
+    int weights[256];               // Blend weight (out of 256) per |difference|
+    cv::Mat history;                // Previous denoised frame
+    cv::Mat nextHistory;            // Receives the current denoised frame
+    std::vector<cv::Point> motion;  // Motion vector per block (block matching)
+    int blocksPerRow;
+};
+
+#endif // TEMPORAL_H
@@ -2,11 +2,14 @@
 #define BILATERAL_FILTER_H
 
 #include <vector>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <cstring>
 #include <stdexcept>
 #include <string>
+#include "convolution.h"
+#include "thread_pool.h"
 
 // Simple RGB pixel structure
 struct RGB {
@@ -37,14 +40,25 @@ public:
     void savePNG(const std::string& filename) const;
 };
 
+// Precision: all filters below compute in float32 rather than double.
+// Inputs are 8-bit, weights are normalized and at most kernelSize^2 terms
+// are accumulated, so the absolute error of a float sum stays below
+// kernelSize^2 × 255 × 2^-24 (< 0.002 for an 11x11 window). After
+// truncation to unsigned char a result can therefore differ from the
+// double computation by at most one gray level, and only when the exact
+// value lies within that distance of an integer.
+
 // Calculate spatial Gaussian weight
-inline double spatialWeight(int dx, int dy, double sigmaSpatial) {
-    return exp(-(dx * dx + dy * dy) / (2.0 * sigmaSpatial * sigmaSpatial));
+inline float spatialWeight(int dx, int dy, float sigmaSpatial) {
+    return std::exp(-(dx * dx + dy * dy) / (2.0f * sigmaSpatial * sigmaSpatial));
 }
 
 // Calculate intensity/range Gaussian weight
-inline double rangeWeight(int diff, double sigmaRange) {
-    return exp(-(diff * diff) / (2.0 * sigmaRange * sigmaRange));
+// (diff is squared in float, since a squared color distance squared again
+// does not fit in an int)
+inline float rangeWeight(int diff, float sigmaRange) {
+    float d = static_cast<float>(diff);
+    return std::exp(-(d * d) / (2.0f * sigmaRange * sigmaRange));
 }
 
 // Calculate color difference between two pixels
@@ -61,50 +75,55 @@ inline int colorDifference(const RGB& p1, const RGB& p2) {
 Image applyBilateralFilter(const Image& input, int kernelSize, double sigmaSpatial, double sigmaRange) {
     Image output(input.width, input.height);
     int offset = kernelSize / 2;
+    float sigmaSpatialF = static_cast<float>(sigmaSpatial);
+    float sigmaRangeF = static_cast<float>(sigmaRange);
     
-    for (int y = 0; y < input.height; y++) {
-        for (int x = 0; x < input.width; x++) {
-            const RGB& centerPixel = input.at(x, y);
-            
-            double sumR = 0.0, sumG = 0.0, sumB = 0.0;
-            double sumWeight = 0.0;
-            
-            // Iterate over neighborhood
-            for (int ky = -offset; ky <= offset; ky++) {
-                for (int kx = -offset; kx <= offset; kx++) {
-                    int nx = x + kx;
-                    int ny = y + ky;
-                    
-                    // Clamp to image boundaries
-                    nx = std::max(0, std::min(nx, input.width - 1));
-                    ny = std::max(0, std::min(ny, input.height - 1));
-                    
-                    const RGB& neighborPixel = input.at(nx, ny);
-                    
-                    // Calculate spatial weight (based on distance)
-                    double spatialW = spatialWeight(kx, ky, sigmaSpatial);
-                    
-                    // Calculate range weight (based on color similarity)
-                    int colorDiff = colorDifference(centerPixel, neighborPixel);
-                    double rangeW = rangeWeight(colorDiff, sigmaRange);
-                    
-                    // Combined weight
-                    double weight = spatialW * rangeW;
-                    
-                    sumR += neighborPixel.r * weight;
-                    sumG += neighborPixel.g * weight;
-                    sumB += neighborPixel.b * weight;
-                    sumWeight += weight;
+    // Rows are independent, so they are processed in parallel on the shared pool
+    parallelFor(0, input.height, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            for (int x = 0; x < input.width; x++) {
+                const RGB& centerPixel = input.at(x, y);
+                
+                float sumR = 0.0f, sumG = 0.0f, sumB = 0.0f;
+                float sumWeight = 0.0f;
+                
+                // Iterate over neighborhood
+                for (int ky = -offset; ky <= offset; ky++) {
+                    for (int kx = -offset; kx <= offset; kx++) {
+                        int nx = x + kx;
+                        int ny = y + ky;
+                        
+                        // Clamp to image boundaries
+                        nx = std::max(0, std::min(nx, input.width - 1));
+                        ny = std::max(0, std::min(ny, input.height - 1));
+                        
+                        const RGB& neighborPixel = input.at(nx, ny);
+                        
+                        // Calculate spatial weight (based on distance)
+                        float spatialW = spatialWeight(kx, ky, sigmaSpatialF);
+                        
+                        // Calculate range weight (based on color similarity)
+                        int colorDiff = colorDifference(centerPixel, neighborPixel);
+                        float rangeW = rangeWeight(colorDiff, sigmaRangeF);
+                        
+                        // Combined weight
+                        float weight = spatialW * rangeW;
+                        
+                        sumR += neighborPixel.r * weight;
+                        sumG += neighborPixel.g * weight;
+                        sumB += neighborPixel.b * weight;
+                        sumWeight += weight;
+                    }
                 }
+                
+                // Normalize by total weight
+                RGB& outPixel = output.at(x, y);
+                outPixel.r = static_cast<unsigned char>(sumR / sumWeight);
+                outPixel.g = static_cast<unsigned char>(sumG / sumWeight);
+                outPixel.b = static_cast<unsigned char>(sumB / sumWeight);
             }
-            
-            // Normalize by total weight
-            RGB& outPixel = output.at(x, y);
-            outPixel.r = static_cast<unsigned char>(sumR / sumWeight);
-            outPixel.g = static_cast<unsigned char>(sumG / sumWeight);
-            outPixel.b = static_cast<unsigned char>(sumB / sumWeight);
         }
-    }
+    });
     
     return output;
 }
@@ -115,127 +134,603 @@ Image applyBilateralFilterFast(const Image& input, int kernelSize, double sigmaS
     return applyBilateralFilter(input, fastKernelSize, sigmaSpatial, sigmaRange);
 }
 
+// Horizontal Gaussian of one row of width pixels into dst
+// K is the kernel size as a compile-time constant, so the tap loop is
+// fully unrolled; K = 0 is the generic version using kernelSize
+template <int K>
+void gaussianHorizontalRow(const RGB* src, RGB* dst, int width, const float* kernel1D, int kernelSize) {
+    const int size = (K > 0) ? K : kernelSize;
+    const int offset = size / 2;
+    
+    for (int x = 0; x < width; x++) {
+        float sumR = 0.0f, sumG = 0.0f, sumB = 0.0f;
+        
+        for (int k = 0; k < size; k++) {
+            int px = x + k - offset;
+            px = std::max(0, std::min(px, width - 1));
+            
+            const RGB& pixel = src[px];
+            float weight = kernel1D[k];
+            
+            sumR += pixel.r * weight;
+            sumG += pixel.g * weight;
+            sumB += pixel.b * weight;
+        }
+        
+        RGB& outPixel = dst[x];
+        outPixel.r = static_cast<unsigned char>(sumR);
+        outPixel.g = static_cast<unsigned char>(sumG);
+        outPixel.b = static_cast<unsigned char>(sumB);
+    }
+}
+
+// Horizontal pass of the Gaussian blur for rows [rowBegin, rowEnd)
+template <int K>
+void gaussianHorizontalPass(const Image& input, Image& temp, const float* kernel1D, int kernelSize,
+                            int rowBegin, int rowEnd) {
+    for (int y = rowBegin; y < rowEnd; y++) {
+        gaussianHorizontalRow<K>(&input.pixels[y * input.width], &temp.pixels[y * temp.width],
+                                 input.width, kernel1D, kernelSize);
+    }
+}
+
+// Rows are processed in strips, so the accumulators of the vertical pass
+// stay in L1 cache even for 8K-wide images
+const int gaussianStripLength = 2048;
+
+// Vertical Gaussian of one output row from its kernelSize source rows
+// (each a flat array of length samples; same compile-time specialization
+// as the horizontal pass)
+// Whole rows are accumulated at a time: each source row is multiplied by
+// its weight and added into a row of float accumulators. Every access is
+// sequential and the inner loop vectorizes, instead of reading kernelSize
+// different rows for every output pixel. The taps are added in the same
+// order as before, so the results are identical.
+// sums must hold min(length, gaussianStripLength) floats.
+template <int K>
+void gaussianVerticalRow(const unsigned char* const* srcRows, unsigned char* dst, int length,
+                         const float* kernel1D, int kernelSize, float* sums) {
+    const int size = (K > 0) ? K : kernelSize;
+    
+    for (int begin = 0; begin < length; begin += gaussianStripLength) {
+        const int count = std::min(gaussianStripLength, length - begin);
+        
+        // First tap initializes the accumulators, the others add to them
+        const unsigned char* first = srcRows[0] + begin;
+        for (int i = 0; i < count; i++) {
+            sums[i] = 0.0f + first[i] * kernel1D[0];
+        }
+        for (int k = 1; k < size; k++) {
+            const unsigned char* src = srcRows[k] + begin;
+            const float weight = kernel1D[k];
+            for (int i = 0; i < count; i++) {
+                sums[i] += src[i] * weight;
+            }
+        }
+        
+        for (int i = 0; i < count; i++) {
+            dst[begin + i] = static_cast<unsigned char>(sums[i]);
+        }
+    }
+}
+
+// Vertical pass of the Gaussian blur for rows [rowBegin, rowEnd)
+template <int K>
+void gaussianVerticalPass(const Image& temp, Image& output, const float* kernel1D, int kernelSize,
+                          int rowBegin, int rowEnd) {
+    const int size = (K > 0) ? K : kernelSize;
+    const int offset = size / 2;
+    
+    // A row of RGB pixels is a flat array of width × 3 samples
+    static_assert(sizeof(RGB) == 3, "RGB must be 3 packed bytes");
+    const int length = temp.width * 3;
+    
+    std::vector<float> sums(std::min(length, gaussianStripLength));
+    std::vector<const unsigned char*> srcRows(size);
+    
+    for (int y = rowBegin; y < rowEnd; y++) {
+        // Clamp the source rows once per output row, not once per tap and pixel
+        for (int k = 0; k < size; k++) {
+            int py = std::max(0, std::min(y + k - offset, temp.height - 1));
+            srcRows[k] = reinterpret_cast<const unsigned char*>(&temp.pixels[py * temp.width]);
+        }
+        unsigned char* dst = reinterpret_cast<unsigned char*>(&output.pixels[y * output.width]);
+        gaussianVerticalRow<K>(&srcRows[0], dst, length, kernel1D, kernelSize, &sums[0]);
+    }
+}
+
+// Run one Gaussian pass, specialized for the kernel sizes used by the
+// program (3, 5, 7, 9 and 11) and generic for any other size
+void gaussianPass(bool vertical, const Image& src, Image& dst, const float* kernel1D, int kernelSize,
+                  int rowBegin, int rowEnd) {
+    switch (kernelSize) {
+        case 3:
+            vertical ? gaussianVerticalPass<3>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd)
+                     : gaussianHorizontalPass<3>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd);
+            break;
+        case 5:
+            vertical ? gaussianVerticalPass<5>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd)
+                     : gaussianHorizontalPass<5>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd);
+            break;
+        case 7:
+            vertical ? gaussianVerticalPass<7>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd)
+                     : gaussianHorizontalPass<7>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd);
+            break;
+        case 9:
+            vertical ? gaussianVerticalPass<9>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd)
+                     : gaussianHorizontalPass<9>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd);
+            break;
+        case 11:
+            vertical ? gaussianVerticalPass<11>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd)
+                     : gaussianHorizontalPass<11>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd);
+            break;
+        default:
+            vertical ? gaussianVerticalPass<0>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd)
+                     : gaussianHorizontalPass<0>(src, dst, kernel1D, kernelSize, rowBegin, rowEnd);
+            break;
+    }
+}
+
 // Gaussian blur for comparison
 Image applyGaussianBlur(const Image& input, int kernelSize, double sigma) {
     Image output(input.width, input.height);
-    int offset = kernelSize / 2;
+    if (input.width == 0 || input.height == 0) {
+        return output;
+    }
     
-    // Generate 1D kernel
-    std::vector<double> kernel1D(kernelSize);
-    double sum = 0.0;
-    int center = kernelSize / 2;
+    // Generate 1D kernel (compile-time table for the common sizes and sigmas)
+    std::vector<float> kernel1D(kernelSize);
+    computeGaussianWeights(kernelSize, sigma, &kernel1D[0]);
     
-    for (int i = 0; i < kernelSize; i++) {
-        int x = i - center;
-        kernel1D[i] = exp(-(x * x) / (2.0 * sigma * sigma));
-        sum += kernel1D[i];
-    }
-    for (int i = 0; i < kernelSize; i++) {
-        kernel1D[i] /= sum;
+    // Very large kernels: FFT convolution, with the same rules as the loops
+    // below: the image is padded with its clamped border pixels (the FFT
+    // path's own reflected border then never reaches the result), and the
+    // float result is truncated. Both paths agree within float rounding.
+    if (kernelSize >= fftMinimumKernelSize && kernelSize >= fftConvolutionCrossover()) {
+        const int radius = kernelSize / 2;
+        cv::Mat source(input.height, input.width, CV_8UC3, const_cast<RGB*>(&input.pixels[0]));
+        cv::Mat padded, paddedFloat, blurred;
+        cv::copyMakeBorder(source, padded, radius, radius, radius, radius, cv::BORDER_REPLICATE);
+        padded.convertTo(paddedFloat, CV_32F);
+        convolveSeparableFFT(paddedFloat, blurred, &kernel1D[0], kernelSize);
+        
+        parallelFor(0, output.height, [&](int rowBegin, int rowEnd) {
+            const int length = output.width * 3;
+            for (int y = rowBegin; y < rowEnd; y++) {
+                const float* src = blurred.ptr<float>(y + radius) + radius * 3;
+                unsigned char* dst = reinterpret_cast<unsigned char*>(&output.pixels[y * output.width]);
+                for (int i = 0; i < length; i++) {
+                    dst[i] = static_cast<unsigned char>(std::max(0.0f, std::min(255.0f, src[i])));
+                }
+            }
+        });
+        return output;
     }
     
     // Horizontal pass
     Image temp(input.width, input.height);
     
-    for (int y = 0; y < input.height; y++) {
-        for (int x = 0; x < input.width; x++) {
-            double sumR = 0.0, sumG = 0.0, sumB = 0.0;
-            
-            for (int k = 0; k < kernelSize; k++) {
-                int px = x + k - offset;
-                px = std::max(0, std::min(px, input.width - 1));
-                
-                const RGB& pixel = input.at(px, y);
-                double weight = kernel1D[k];
-                
-                sumR += pixel.r * weight;
-                sumG += pixel.g * weight;
-                sumB += pixel.b * weight;
-            }
-            
-            RGB& outPixel = temp.at(x, y);
-            outPixel.r = static_cast<unsigned char>(sumR);
-            outPixel.g = static_cast<unsigned char>(sumG);
-            outPixel.b = static_cast<unsigned char>(sumB);
-        }
-    }
+    parallelFor(0, input.height, [&](int rowBegin, int rowEnd) {
+        gaussianPass(false, input, temp, &kernel1D[0], kernelSize, rowBegin, rowEnd);
+    });
     
-    // Vertical pass
-    for (int y = 0; y < temp.height; y++) {
-        for (int x = 0; x < temp.width; x++) {
-            double sumR = 0.0, sumG = 0.0, sumB = 0.0;
-            
-            for (int k = 0; k < kernelSize; k++) {
-                int py = y + k - offset;
-                py = std::max(0, std::min(py, temp.height - 1));
-                
-                const RGB& pixel = temp.at(x, py);
-                double weight = kernel1D[k];
-                
-                sumR += pixel.r * weight;
-                sumG += pixel.g * weight;
-                sumB += pixel.b * weight;
-            }
-            
-            RGB& outPixel = output.at(x, y);
-            outPixel.r = static_cast<unsigned char>(sumR);
-            outPixel.g = static_cast<unsigned char>(sumG);
-            outPixel.b = static_cast<unsigned char>(sumB);
-        }
-    }
+    // Vertical pass (starts only after the whole horizontal pass is done,
+    // since each output row reads several rows of temp)
+    parallelFor(0, temp.height, [&](int rowBegin, int rowEnd) {
+        gaussianPass(true, temp, output, &kernel1D[0], kernelSize, rowBegin, rowEnd);
+    });
     
     return output;
 }
 
-// Sharpen filter
-Image applySharpen(const Image& input, double amount = 1.0) {
+// Sharpen filter, float reference
+// The original implementation: nine float multiply-adds per channel with
+// clamped coordinates for every pixel. applySharpen below gives the same
+// results with integer arithmetic; this version is kept to compare them
+// (see the 'sharpen' benchmark).
+Image applySharpenFloat(const Image& input, double amount = 1.0) {
     Image output(input.width, input.height);
     
     // Sharpening kernel
-    double kernel[3][3] = {
+    float kernel[3][3] = {
         { 0, -1,  0},
         {-1,  5, -1},
         { 0, -1,  0}
     };
     
     // Scale kernel by amount
-    kernel[1][1] = 1 + 4 * amount;
+    float amountF = static_cast<float>(amount);
+    kernel[1][1] = 1 + 4 * amountF;
     for (int i = 0; i < 3; i++) {
         for (int j = 0; j < 3; j++) {
             if (i != 1 || j != 1) {
-                kernel[i][j] = -amount;
+                kernel[i][j] = -amountF;
             }
         }
     }
     
-    for (int y = 0; y < input.height; y++) {
-        for (int x = 0; x < input.width; x++) {
-            double sumR = 0.0, sumG = 0.0, sumB = 0.0;
-            
-            for (int ky = 0; ky < 3; ky++) {
-                for (int kx = 0; kx < 3; kx++) {
-                    int px = x + kx - 1;
-                    int py = y + ky - 1;
-                    
-                    px = std::max(0, std::min(px, input.width - 1));
-                    py = std::max(0, std::min(py, input.height - 1));
-                    
-                    const RGB& pixel = input.at(px, py);
-                    
-                    sumR += pixel.r * kernel[ky][kx];
-                    sumG += pixel.g * kernel[ky][kx];
-                    sumB += pixel.b * kernel[ky][kx];
+    parallelFor(0, input.height, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            for (int x = 0; x < input.width; x++) {
+                float sumR = 0.0f, sumG = 0.0f, sumB = 0.0f;
+                
+                for (int ky = 0; ky < 3; ky++) {
+                    for (int kx = 0; kx < 3; kx++) {
+                        int px = x + kx - 1;
+                        int py = y + ky - 1;
+                        
+                        px = std::max(0, std::min(px, input.width - 1));
+                        py = std::max(0, std::min(py, input.height - 1));
+                        
+                        const RGB& pixel = input.at(px, py);
+                        
+                        sumR += pixel.r * kernel[ky][kx];
+                        sumG += pixel.g * kernel[ky][kx];
+                        sumB += pixel.b * kernel[ky][kx];
+                    }
                 }
+                
+                RGB& outPixel = output.at(x, y);
+                outPixel.r = static_cast<unsigned char>(std::min(255.0f, std::max(0.0f, sumR)));
+                outPixel.g = static_cast<unsigned char>(std::min(255.0f, std::max(0.0f, sumG)));
+                outPixel.b = static_cast<unsigned char>(std::min(255.0f, std::max(0.0f, sumB)));
             }
-            
-            RGB& outPixel = output.at(x, y);
-            outPixel.r = static_cast<unsigned char>(std::min(255.0, std::max(0.0, sumR)));
-            outPixel.g = static_cast<unsigned char>(std::min(255.0, std::max(0.0, sumG)));
-            outPixel.b = static_cast<unsigned char>(std::min(255.0, std::max(0.0, sumB)));
         }
+    });
+    
+    return output;
+}
+
+// Fractional bits of the fixed-point sharpen amount (amount × 4096)
+const int sharpenFractionBits = 12;
+
+// Sharpen amount in fixed point
+// (limited to ±16, so every intermediate sum fits in an int)
+inline int sharpenAmountFixed(double amount) {
+    double limited = std::max(-16.0, std::min(16.0, amount));
+    return static_cast<int>(std::lround(limited * (1 << sharpenFractionBits)));
+}
+
+// 3x3 sharpen of one row, given the rows above and below it (flat arrays of
+// width × 3 samples; at the image border the row itself is passed again)
+// The kernel is 1 + 4 × amount at the center and -amount at all eight
+// neighbors, so the result is
+//   (1 + 5 × amount) × center - amount × (sum of the 3x3 window)
+// The window sums are built from the column sums of the three rows, each
+// shared by three neighboring pixels. Everything is integer arithmetic
+// along the row, so the loops vectorize.
+// columns must hold width × 3 ints.
+void sharpenRow(const unsigned char* above, const unsigned char* row, const unsigned char* below,
+                unsigned char* dst, int width, int amountFixed, int* columns) {
+    const int length = width * 3;
+    const int centerWeight = (1 << sharpenFractionBits) + 5 * amountFixed;
+    const int maxValue = (256 << sharpenFractionBits) - 1;
+    
+    for (int i = 0; i < length; i++) {
+        columns[i] = above[i] + row[i] + below[i];
     }
     
+    // Inner pixels: the left and right neighbors are 3 samples away
+    for (int i = 3; i < length - 3; i++) {
+        int window = columns[i - 3] + columns[i] + columns[i + 3];
+        int value = row[i] * centerWeight - amountFixed * window;
+        value = std::min(maxValue, std::max(0, value));
+        dst[i] = static_cast<unsigned char>(value >> sharpenFractionBits);
+    }
+    
+    // First and last pixel: the missing column is clamped to the edge one
+    const int edges[2] = {0, width - 1};
+    for (int e = 0; e < 2; e++) {
+        const int x = edges[e];
+        for (int c = 0; c < 3; c++) {
+            int i = x * 3 + c;
+            int left = (x > 0) ? i - 3 : i;
+            int right = (x < width - 1) ? i + 3 : i;
+            int window = columns[left] + columns[i] + columns[right];
+            int value = row[i] * centerWeight - amountFixed * window;
+            value = std::min(maxValue, std::max(0, value));
+            dst[i] = static_cast<unsigned char>(value >> sharpenFractionBits);
+        }
+    }
+}
+
+// Sharpen filter
+// Integer version of the 3x3 kernel: the amount is a 12-bit fixed-point
+// number, the three source rows are looked up once per output row, and
+// each row is processed with vectorized integer arithmetic. Results are
+// identical to applySharpenFloat when amount is a multiple of 1/4096
+// (e.g. 0.5, 1.0, 1.5) and otherwise within one gray level.
+Image applySharpen(const Image& input, double amount = 1.0) {
+    Image output(input.width, input.height);
+    if (input.width == 0 || input.height == 0) {
+        return output;
+    }
+    
+    const int amountFixed = sharpenAmountFixed(amount);
+    
+    parallelFor(0, input.height, [&](int rowBegin, int rowEnd) {
+        std::vector<int> columns(input.width * 3);
+        for (int y = rowBegin; y < rowEnd; y++) {
+            int above = std::max(0, y - 1);
+            int below = std::min(input.height - 1, y + 1);
+            sharpenRow(reinterpret_cast<const unsigned char*>(&input.pixels[above * input.width]),
+                       reinterpret_cast<const unsigned char*>(&input.pixels[y * input.width]),
+                       reinterpret_cast<const unsigned char*>(&input.pixels[below * input.width]),
+                       reinterpret_cast<unsigned char*>(&output.pixels[y * output.width]),
+                       input.width, amountFixed, &columns[0]);
+        }
+    });
+    
     return output;
 }
 
+// Gaussian blur followed by the sharpen filter for output rows
+// [rowBegin, rowEnd), in a single pass over the image
+// Instead of full-size intermediate images, only the last kernelSize
+// horizontally blurred rows and the last 3 blurred rows are kept, in small
+// rings (slot = row index modulo the ring size). Each output row computes
+// whatever rows of the rings it is still missing, so the intermediates
+// stay in cache and the image is read and written once. Only the first
+// rows of each chunk are computed twice (by the chunk above, too).
+template <int K>
+void gaussianSharpenRows(const Image& input, Image& output, const float* kernel1D, int kernelSize,
+                         int amountFixed, int rowBegin, int rowEnd) {
+    const int size = (K > 0) ? K : kernelSize;
+    const int offset = size / 2;
+    const int width = input.width;
+    const int height = input.height;
+    const int length = width * 3;
+    
+    // Rings of horizontally blurred rows and of blurred rows; the tags are
+    // the image rows the slots currently hold
+    std::vector<RGB> horizontal(size * width);
+    std::vector<int> horizontalTag(size, -1);
+    std::vector<unsigned char> blurred(3 * length);
+    int blurredTag[3] = {-1, -1, -1};
+    
+    std::vector<float> sums(std::min(length, gaussianStripLength));
+    std::vector<const unsigned char*> srcRows(size);
+    std::vector<int> columns(length);
+    const unsigned char* window[3];
+    
+    for (int y = rowBegin; y < rowEnd; y++) {
+        // Blurred rows y - 1, y and y + 1 (clamped)
+        for (int k = 0; k < 3; k++) {
+            int by = std::max(0, std::min(y + k - 1, height - 1));
+            int slot = by % 3;
+            if (blurredTag[slot] != by) {
+                for (int t = 0; t < size; t++) {
+                    int py = std::max(0, std::min(by + t - offset, height - 1));
+                    int hslot = py % size;
+                    RGB* hrow = &horizontal[hslot * width];
+                    if (horizontalTag[hslot] != py) {
+                        gaussianHorizontalRow<K>(&input.pixels[py * width], hrow, width, kernel1D, kernelSize);
+                        horizontalTag[hslot] = py;
+                    }
+                    srcRows[t] = reinterpret_cast<const unsigned char*>(hrow);
+                }
+                gaussianVerticalRow<K>(&srcRows[0], &blurred[slot * length], length, kernel1D, kernelSize, &sums[0]);
+                blurredTag[slot] = by;
+            }
+            window[k] = &blurred[slot * length];
+        }
+        
+        sharpenRow(window[0], window[1], window[2],
+                   reinterpret_cast<unsigned char*>(&output.pixels[y * output.width]),
+                   width, amountFixed, &columns[0]);
+    }
+}
+
+// Gaussian blur + sharpen (sharpen after denoise) in one memory pass
+// Gives exactly the same image as
+//   applySharpen(applyGaussianBlur(input, kernelSize, sigma), amount)
+// without writing and re-reading two full-size intermediate images.
+// Kernels large enough for the FFT blur take that route instead, so the
+// result stays the same.
+Image applyGaussianSharpen(const Image& input, int kernelSize, double sigma, double amount = 1.0) {
+    Image output(input.width, input.height);
+    if (input.width == 0 || input.height == 0) {
+        return output;
+    }
+    if (kernelSize >= fftMinimumKernelSize && kernelSize >= fftConvolutionCrossover()) {
+        return applySharpen(applyGaussianBlur(input, kernelSize, sigma), amount);
+    }
+    
+    std::vector<float> kernel1D(kernelSize);
+    computeGaussianWeights(kernelSize, sigma, &kernel1D[0]);
+    const int amountFixed = sharpenAmountFixed(amount);
+    
+    parallelFor(0, input.height, [&](int rowBegin, int rowEnd) {
+        switch (kernelSize) {
+            case 3:
+                gaussianSharpenRows<3>(input, output, &kernel1D[0], kernelSize, amountFixed, rowBegin, rowEnd);
+                break;
+            case 5:
+                gaussianSharpenRows<5>(input, output, &kernel1D[0], kernelSize, amountFixed, rowBegin, rowEnd);
+                break;
+            case 7:
+                gaussianSharpenRows<7>(input, output, &kernel1D[0], kernelSize, amountFixed, rowBegin, rowEnd);
+                break;
+            case 9:
+                gaussianSharpenRows<9>(input, output, &kernel1D[0], kernelSize, amountFixed, rowBegin, rowEnd);
+                break;
+            case 11:
+                gaussianSharpenRows<11>(input, output, &kernel1D[0], kernelSize, amountFixed, rowBegin, rowEnd);
+                break;
+            default:
+                gaussianSharpenRows<0>(input, output, &kernel1D[0], kernelSize, amountFixed, rowBegin, rowEnd);
+                break;
+        }
+    });
+    
+    return output;
+}
+
+// Box-average downsampling by an integer factor (the last block of a row
+// or column may be partial)
+Image downsampleImage(const Image& input, int factor) {
+    Image output((input.width + factor - 1) / factor, (input.height + factor - 1) / factor);
+    
+    parallelFor(0, output.height, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            int y0 = y * factor;
+            int y1 = std::min(input.height, y0 + factor);
+            for (int x = 0; x < output.width; x++) {
+                int x0 = x * factor;
+                int x1 = std::min(input.width, x0 + factor);
+                int sumR = 0, sumG = 0, sumB = 0;
+                for (int py = y0; py < y1; py++) {
+                    for (int px = x0; px < x1; px++) {
+                        const RGB& pixel = input.at(px, py);
+                        sumR += pixel.r;
+                        sumG += pixel.g;
+                        sumB += pixel.b;
+                    }
+                }
+                int count = (y1 - y0) * (x1 - x0);
+                RGB& outPixel = output.at(x, y);
+                outPixel.r = static_cast<unsigned char>((sumR + count / 2) / count);
+                outPixel.g = static_cast<unsigned char>((sumG + count / 2) / count);
+                outPixel.b = static_cast<unsigned char>((sumB + count / 2) / count);
+            }
+        }
+    });
+    
+    return output;
+}
+
+// Low-resolution neighbors used per full-resolution pixel, along each axis
+const int upsamplingTaps = 4;
+
+// Range weights of the joint bilateral upsampling are looked up by squared
+// color distance, in steps of 16
+const int guideWeightShift = 4;
+
+// Low-resolution neighbors of every full-resolution coordinate for the
+// upsampling: the first of the upsamplingTaps pixels around it and their
+// Gaussian distance weights (standard deviation: one low-resolution pixel)
+void upsamplingWeights(int length, int factor, std::vector<int>& first, std::vector<float>& weights) {
+    first.resize(length);
+    weights.resize(length * upsamplingTaps);
+    for (int i = 0; i < length; i++) {
+        float position = (i + 0.5f) / factor - 0.5f;
+        int start = static_cast<int>(std::floor(position)) - 1;
+        first[i] = start;
+        for (int k = 0; k < upsamplingTaps; k++) {
+            float distance = position - (start + k);
+            weights[i * upsamplingTaps + k] = std::exp(-0.5f * distance * distance);
+        }
+    }
+}
+
+// Joint bilateral upsampling
+// lowResult is a filtered version of lowGuide (the input downsampled by
+// factor), guide is the full-resolution input. Each output pixel is a
+// weighted average of the 4x4 low-resolution results around it: Gaussian
+// weights for the distance, times a Gaussian of the color distance between
+// the guide pixel and the low-resolution input at that neighbor. Across an
+// edge the neighbors on the other side (and the blocks that straddle it)
+// get almost no weight, so the edge stays where the full-resolution input
+// has it instead of being interpolated. When all neighbors differ too much
+// (thin detail lost by the downsampling), the distance weights alone are
+// used.
+Image jointBilateralUpsample(const Image& lowResult, const Image& lowGuide, const Image& guide,
+                             int factor, double sigmaRange) {
+    Image output(guide.width, guide.height);
+    
+    std::vector<int> firstX, firstY;
+    std::vector<float> weightsX, weightsY;
+    upsamplingWeights(guide.width, factor, firstX, weightsX);
+    upsamplingWeights(guide.height, factor, firstY, weightsY);
+    
+    // exp(-d / (2 sigmaRange²)) for the squared color distances d, in steps of 16
+    std::vector<float> guideWeights((3 * 255 * 255 >> guideWeightShift) + 1);
+    for (size_t i = 0; i < guideWeights.size(); i++) {
+        double distance = (i << guideWeightShift) + (1 << guideWeightShift) / 2;
+        guideWeights[i] = static_cast<float>(std::exp(-distance / (2.0 * sigmaRange * sigmaRange)));
+    }
+    
+    parallelFor(0, guide.height, [&](int rowBegin, int rowEnd) {
+        for (int y = rowBegin; y < rowEnd; y++) {
+            int qy[upsamplingTaps];
+            for (int j = 0; j < upsamplingTaps; j++) {
+                qy[j] = std::max(0, std::min(firstY[y] + j, lowResult.height - 1));
+            }
+            const float* wy = &weightsY[y * upsamplingTaps];
+            
+            for (int x = 0; x < guide.width; x++) {
+                const RGB& guidePixel = guide.at(x, y);
+                const float* wx = &weightsX[x * upsamplingTaps];
+                
+                float sumR = 0.0f, sumG = 0.0f, sumB = 0.0f, sumWeight = 0.0f;
+                float spatialR = 0.0f, spatialG = 0.0f, spatialB = 0.0f, spatialSum = 0.0f;
+                for (int i = 0; i < upsamplingTaps; i++) {
+                    int qx = std::max(0, std::min(firstX[x] + i, lowResult.width - 1));
+                    for (int j = 0; j < upsamplingTaps; j++) {
+                        float spatialW = wx[i] * wy[j];
+                        const RGB& neighbor = lowResult.at(qx, qy[j]);
+                        int colorDiff = colorDifference(guidePixel, lowGuide.at(qx, qy[j]));
+                        float weight = spatialW * guideWeights[colorDiff >> guideWeightShift];
+                        
+                        sumR += neighbor.r * weight;
+                        sumG += neighbor.g * weight;
+                        sumB += neighbor.b * weight;
+                        sumWeight += weight;
+                        spatialR += neighbor.r * spatialW;
+                        spatialG += neighbor.g * spatialW;
+                        spatialB += neighbor.b * spatialW;
+                        spatialSum += spatialW;
+                    }
+                }
+                
+                if (sumWeight < 1e-6f * spatialSum) {
+                    sumR = spatialR;
+                    sumG = spatialG;
+                    sumB = spatialB;
+                    sumWeight = spatialSum;
+                }
+                RGB& outPixel = output.at(x, y);
+                outPixel.r = static_cast<unsigned char>(sumR / sumWeight + 0.5f);
+                outPixel.g = static_cast<unsigned char>(sumG / sumWeight + 0.5f);
+                outPixel.b = static_cast<unsigned char>(sumB / sumWeight + 0.5f);
+            }
+        }
+    });
+    
+    return output;
+}
+
+// Run an expensive smoothing filter at 1/factor resolution
+// filter(const Image&) returns the filtered image of the same size. It
+// sees factor² times fewer pixels; joint bilateral upsampling guided by
+// the full-resolution input then brings the result back with sharp edges,
+// at the cost of 16 weights (from tables) per output pixel. factor 1 runs
+// the filter at full resolution.
+template <typename Filter>
+Image applyAtLowResolution(const Image& input, int factor, double sigmaRange, Filter filter) {
+    if (factor <= 1 || input.width == 0 || input.height == 0) {
+        return filter(input);
+    }
+    Image lowInput = downsampleImage(input, factor);
+    Image lowResult = filter(lowInput);
+    return jointBilateralUpsample(lowResult, lowInput, input, factor, sigmaRange);
+}
+
+// Bilateral filter at 1/factor resolution with joint bilateral upsampling
+// kernelSize and sigmaSpatial are full-resolution sizes; they are divided
+// by factor for the low-resolution filter (at least 3 taps), so the result
+// smooths over about the same area as applyBilateralFilter, roughly
+// factor² times faster.
+Image applyBilateralFilterDownsampled(const Image& input, int kernelSize, double sigmaSpatial,
+                                      double sigmaRange, int factor = 2) {
+    if (factor <= 1) {
+        return applyBilateralFilter(input, kernelSize, sigmaSpatial, sigmaRange);
+    }
+    const int lowKernelSize = std::max(3, (kernelSize / factor) | 1);
+    const double lowSigmaSpatial = std::max(0.5, sigmaSpatial / factor);
+    return applyAtLowResolution(input, factor, sigmaRange, [&](const Image& lowInput) {
+        return applyBilateralFilter(lowInput, lowKernelSize, lowSigmaSpatial, sigmaRange);
+    });
+}
+
 #endif // BILATERAL_FILTER_H
\ No newline at end of file
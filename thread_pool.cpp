@@ -0,0 +1,472 @@
+#include "thread_pool.h"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Requested thread count for the shared pool (0 = one per hardware core)
+int requestedThreadCount = 0;
+
+// Requested NUMA mode (pin threads, keep tasks node-local)
+bool requestedPinning = false;
+
+// Index of the worker running on this thread (-1 for non-pool threads)
+thread_local int workerIndex = -1;
+
+// NUMA node this thread is pinned to (-1 if not pinned)
+thread_local int threadNode = -1;
+
+/**
+ * Parse a Linux CPU list such as "0-15,32-47" into individual CPU ids
+ */
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    
+    while (std::getline(stream, range, ',')) {
+        if (range.empty()) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = std::atoi(range.substr(0, dash).c_str());
+        int last = (dash == std::string::npos) ? first : std::atoi(range.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    
+    return cpus;
+}
+
+/**
+ * Read the CPUs of every NUMA node from sysfs
+ * 
+ * Only CPUs this process is allowed to run on are kept. If the topology
+ * cannot be read (non-Linux, containers without sysfs) everything is
+ * reported as a single node.
+ * 
+ * @return std::vector<std::vector<int>> CPU ids per NUMA node
+ */
+std::vector<std::vector<int> > readNumaTopology() {
+    std::vector<std::vector<int> > topology;
+
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    
+    // Node directories are numbered densely on almost all systems;
+    // stop at the first missing one
+    for (int node = 0; ; node++) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (!file) {
+            break;
+        }
+        std::string list;
+        std::getline(file, list);
+        
+        std::vector<int> cpus;
+        std::vector<int> all = parseCpuList(list);
+        for (size_t i = 0; i < all.size(); i++) {
+            if (!haveMask || CPU_ISSET(all[i], &allowed)) {
+                cpus.push_back(all[i]);
+            }
+        }
+        
+        // Memory-only nodes have no CPUs to run on
+        if (!cpus.empty()) {
+            topology.push_back(cpus);
+        }
+    }
+#endif
+    
+    if (topology.empty()) {
+        std::vector<int> cpus;
+        int count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        for (int cpu = 0; cpu < count; cpu++) {
+            cpus.push_back(cpu);
+        }
+        topology.push_back(cpus);
+    }
+    
+    return topology;
+}
+
+/**
+ * Pin the calling thread to a single CPU
+ * 
+ * @return bool True on success
+ */
+bool pinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+}
+
+ThreadPool& ThreadPool::instance() {
+    // Function-local static: created on first use, thread-safe in C++11
+    static ThreadPool pool(requestedThreadCount);
+    return pool;
+}
+
+void ThreadPool::setThreadCount(int numThreads) {
+    requestedThreadCount = numThreads;
+}
+
+void ThreadPool::setPinThreads(bool pin) {
+    requestedPinning = pin;
+}
+
+int ThreadPool::currentWorkerIndex() {
+    return workerIndex;
+}
+
+int ThreadPool::currentNode() {
+    return threadNode;
+}
+
+ThreadPool::ThreadPool(int numThreads)
+    : nextQueue(0), stopping(false), pinned(requestedPinning) {
+    if (numThreads <= 0) {
+        numThreads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    totalThreads = std::max(1, numThreads);
+    
+    // Stop OpenCV from running its own thread pool underneath ours.
+    // All parallelism in the program goes through this pool instead.
+    cv::setNumThreads(0);
+    
+    // The thread that waits on a TaskGroup also executes tasks,
+    // so we only need (totalThreads - 1) dedicated workers
+    int numWorkers = totalThreads - 1;
+    
+    // Decide which CPU each thread runs on. CPUs are taken alternately
+    // from each node (node0, node1, node0, node1, ...) so that any thread
+    // count is spread evenly over the sockets.
+    // Slot 0 is the creating (main) thread, slot i + 1 is worker i.
+    std::vector<int> slotCpu(totalThreads, -1);
+    std::vector<int> slotNode(totalThreads, 0);
+    int numNodes = 1;
+    
+    if (pinned) {
+        std::vector<std::vector<int> > topology = readNumaTopology();
+        numNodes = static_cast<int>(topology.size());
+        
+        std::vector<int> interleavedCpus, interleavedNodes;
+        for (size_t index = 0; ; index++) {
+            bool any = false;
+            for (int node = 0; node < numNodes; node++) {
+                if (index < topology[node].size()) {
+                    interleavedCpus.push_back(topology[node][index]);
+                    interleavedNodes.push_back(node);
+                    any = true;
+                }
+            }
+            if (!any) {
+                break;
+            }
+        }
+        
+        for (int slot = 0; slot < totalThreads; slot++) {
+            size_t i = slot % interleavedCpus.size();
+            slotCpu[slot] = interleavedCpus[i];
+            slotNode[slot] = interleavedNodes[i];
+        }
+        
+        // The creating thread also helps run tasks, so pin it as well
+        if (pinCurrentThread(slotCpu[0])) {
+            threadNode = slotNode[0];
+        }
+    }
+    
+    for (int node = 0; node < numNodes; node++) {
+        std::unique_ptr<NodeState> state(new NodeState());
+        state->queuedTasks = 0;
+        state->nextQueue = 0;
+        nodes.push_back(std::move(state));
+    }
+    
+    // Always keep at least one queue so submit() works with no workers
+    int numQueues = std::max(1, numWorkers);
+    for (int i = 0; i < numQueues; i++) {
+        int node = (numWorkers > 0) ? slotNode[i + 1] : slotNode[0];
+        queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+        queueNode.push_back(node);
+        nodes[node]->queueIndices.push_back(i);
+    }
+    
+    for (int i = 0; i < numWorkers; i++) {
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i, slotCpu[i + 1]));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    stopping = true;
+    for (size_t node = 0; node < nodes.size(); node++) {
+        {
+            std::lock_guard<std::mutex> lock(nodes[node]->sleepMutex);
+        }
+        nodes[node]->wakeUp.notify_all();
+    }
+    
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+int ThreadPool::threadCount() const {
+    return totalThreads;
+}
+
+int ThreadPool::nodeCount() const {
+    return static_cast<int>(nodes.size());
+}
+
+bool ThreadPool::threadsPinned() const {
+    return pinned;
+}
+
+int ThreadPool::pickQueue(int node) {
+    // Round-robin over the queues of the requested node, or over all
+    // queues if there is no node preference (or the node has no workers)
+    if (node >= 0 && node < static_cast<int>(nodes.size()) && !nodes[node]->queueIndices.empty()) {
+        NodeState& state = *nodes[node];
+        return state.queueIndices[state.nextQueue++ % state.queueIndices.size()];
+    }
+    return static_cast<int>(nextQueue++ % queues.size());
+}
+
+void ThreadPool::pushTask(int queueIndex, Task task) {
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->tasks.push_back(std::move(task));
+    }
+    
+    // Increment under the sleep mutex so a worker about to sleep
+    // cannot miss the notification
+    NodeState& state = *nodes[queueNode[queueIndex]];
+    {
+        std::lock_guard<std::mutex> lock(state.sleepMutex);
+        state.queuedTasks++;
+    }
+    state.wakeUp.notify_one();
+}
+
+void ThreadPool::submit(Task task) {
+    // Workers push onto their own queue; other threads spread tasks around
+    // (staying on their own node when pinned)
+    int target = workerIndex;
+    if (target < 0 || target >= static_cast<int>(queues.size())) {
+        target = pickQueue(threadNode);
+    }
+    pushTask(target, std::move(task));
+}
+
+void ThreadPool::submitToNode(int node, Task task) {
+    pushTask(pickQueue(node % nodeCount()), std::move(task));
+}
+
+bool ThreadPool::popTask(int preferredQueue, Task& task) {
+    int numQueues = static_cast<int>(queues.size());
+    
+    // First look at our own queue (newest task first)
+    if (preferredQueue >= 0 && preferredQueue < numQueues) {
+        WorkerQueue& own = *queues[preferredQueue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            nodes[queueNode[preferredQueue]]->queuedTasks--;
+            return true;
+        }
+    }
+    
+    // Otherwise steal the oldest task from another queue
+    // In NUMA mode only queues on our own node are candidates
+    int start = preferredQueue < 0 ? 0 : preferredQueue + 1;
+    for (int i = 0; i < numQueues; i++) {
+        int victim = (start + i) % numQueues;
+        if (victim == preferredQueue) {
+            continue;
+        }
+        if (threadNode >= 0 && queueNode[victim] != threadNode) {
+            continue;
+        }
+        WorkerQueue& other = *queues[victim];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            nodes[queueNode[victim]]->queuedTasks--;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+bool ThreadPool::runPendingTask() {
+    Task task;
+    if (!popTask(workerIndex, task)) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(int index, int cpu) {
+    workerIndex = index;
+    if (pinned && pinCurrentThread(cpu)) {
+        threadNode = queueNode[index];
+    }
+    
+    NodeState& state = *nodes[queueNode[index]];
+    
+    while (true) {
+        Task task;
+        if (popTask(index, task)) {
+            task();
+            continue;
+        }
+        
+        // Nothing to do: sleep until new tasks arrive on our node
+        // or the pool shuts down
+        std::unique_lock<std::mutex> lock(state.sleepMutex);
+        if (threadNode < 0 && nodes.size() > 1) {
+            // Pinning failed on a multi-node pool: tasks on any node are
+            // fair game, so only sleep briefly before scanning again
+            state.wakeUp.wait_for(lock, std::chrono::milliseconds(1),
+                                  [this, &state] { return stopping || state.queuedTasks > 0; });
+        } else {
+            state.wakeUp.wait(lock, [this, &state] { return stopping || state.queuedTasks > 0; });
+        }
+        if (stopping && state.queuedTasks == 0) {
+            return;
+        }
+    }
+}
+
+TaskGroup::TaskGroup(ThreadPool& pool) : pool(pool), pending(0) {
+}
+
+TaskGroup::~TaskGroup() {
+    // Never leave tasks running that reference this group
+    try {
+        wait();
+    } catch (...) {
+        // Errors must be collected with an explicit wait()
+    }
+}
+
+std::function<void()> TaskGroup::wrap(std::function<void()> task) {
+    pending++;
+    return [this, task]() {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!firstError) {
+                firstError = std::current_exception();
+            }
+        }
+        
+        // Last task to finish wakes up the waiting thread
+        std::lock_guard<std::mutex> lock(doneMutex);
+        if (--pending == 0) {
+            done.notify_all();
+        }
+    };
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    pool.submit(wrap(task));
+}
+
+void TaskGroup::runOnNode(int node, std::function<void()> task) {
+    pool.submitToNode(node, wrap(task));
+}
+
+void TaskGroup::wait() {
+    while (pending > 0) {
+        // Help out instead of blocking, so nested waits cannot starve the pool
+        if (pool.runPendingTask()) {
+            continue;
+        }
+        
+        // Our tasks are running on other threads; wait briefly and re-check
+        // in case new (possibly nested) tasks were queued in the meantime
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait_for(lock, std::chrono::microseconds(200),
+                      [this] { return pending == 0; });
+    }
+    
+    // The last task may still hold doneMutex after decrementing; taking it
+    // here guarantees no task touches this group after wait() returns
+    {
+        std::lock_guard<std::mutex> lock(doneMutex);
+    }
+    
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void parallelFor(int begin, int end, const std::function<void(int, int)>& body, int grainSize) {
+    int length = end - begin;
+    if (length <= 0) {
+        return;
+    }
+    
+    ThreadPool& pool = ThreadPool::instance();
+    
+    // In NUMA mode the chunks stay on the caller's node, so only that
+    // node's share of the threads will work on them
+    int threads = std::max(1, pool.threadCount() / pool.nodeCount());
+    
+    // Default grain: about four chunks per thread, for load balancing
+    // when some rows are more expensive than others
+    if (grainSize <= 0) {
+        grainSize = std::max(1, length / (threads * 4));
+    }
+    
+    // Not worth splitting: run everything on the calling thread
+    if (pool.threadCount() == 1 || length <= grainSize) {
+        body(begin, end);
+        return;
+    }
+    
+    TaskGroup group(pool);
+    int firstEnd = std::min(end, begin + grainSize);
+    for (int chunkBegin = firstEnd; chunkBegin < end; chunkBegin += grainSize) {
+        int chunkEnd = std::min(end, chunkBegin + grainSize);
+        group.run([&body, chunkBegin, chunkEnd]() {
+            body(chunkBegin, chunkEnd);
+        });
+    }
+    
+    // The caller takes the first chunk itself, then helps with the rest
+    body(begin, firstEnd);
+    group.wait();
+}
@@ -0,0 +1,230 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing thread pool shared by every kernel in the project
+ * 
+ * Filters, metrics and batch processing all submit their work here instead
+ * of creating their own threads, so nested parallelism (e.g. a batch of
+ * images where each image is also split into row bands) never runs more
+ * threads than there are cores.
+ * 
+ * Each worker owns a double-ended queue:
+ *   - The owner pushes and pops at the back (LIFO, keeps caches warm)
+ *   - Idle workers steal from the front of other queues (FIFO, takes the
+ *     oldest and usually largest piece of work)
+ * 
+ * Threads waiting on a TaskGroup help by executing queued tasks, so waiting
+ * from inside a task cannot deadlock the pool.
+ * 
+ * OpenCV's internal threading is disabled when the pool starts
+ * (cv::setNumThreads(0)) so OpenCV calls made from pool tasks do not spawn
+ * a second set of threads on top of ours.
+ * 
+ * NUMA mode (setPinThreads(true)):
+ *   - Threads are pinned to cores, spread evenly over the NUMA nodes
+ *   - Tasks stay on the node they were queued on: workers only steal from
+ *     queues of their own node, and work submitted from a pinned thread
+ *     goes to queues of that thread's node
+ *   - Memory is placed by the Linux first-touch policy, so buffers that are
+ *     allocated and first written inside a node's tasks live on that node.
+ *     Submitting each image with TaskGroup::runOnNode() therefore keeps the
+ *     image, all its intermediate buffers and all its tiles on one node.
+ */
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+    
+    /**
+     * Get the project-wide pool, creating it on first use
+     * 
+     * @return ThreadPool& The shared pool instance
+     */
+    static ThreadPool& instance();
+    
+    /**
+     * Set the total number of threads (workers + calling thread)
+     * 
+     * Must be called before the first call to instance() to take effect.
+     * 
+     * @param numThreads Total threads to use (<= 0 means one per hardware core)
+     */
+    static void setThreadCount(int numThreads);
+    
+    /**
+     * Enable NUMA mode: pin every thread to a core and keep tasks on the
+     * NUMA node they were submitted to
+     * 
+     * Must be called before the first call to instance() to take effect.
+     * Pinning is only available on Linux; elsewhere this has no effect.
+     * 
+     * @param pin True to pin threads and keep work node-local
+     */
+    static void setPinThreads(bool pin);
+    
+    /**
+     * Total number of threads that execute pool work, including the thread
+     * that waits on a TaskGroup (which helps run tasks)
+     */
+    int threadCount() const;
+    
+    /**
+     * Number of NUMA nodes the pool spreads its threads over
+     * (always 1 unless NUMA mode is enabled on a multi-node host)
+     */
+    int nodeCount() const;
+    
+    /**
+     * True if threads are pinned to cores (NUMA mode is active)
+     */
+    bool threadsPinned() const;
+    
+    /**
+     * Queue a task for execution
+     * 
+     * Tasks submitted from a worker go to that worker's own queue; tasks
+     * submitted from any other thread are distributed round-robin (over
+     * the queues of the caller's node when it is pinned).
+     * 
+     * @param task The work to run
+     */
+    void submit(Task task);
+    
+    /**
+     * Queue a task on the workers of a specific NUMA node
+     * 
+     * @param node NUMA node index (taken modulo nodeCount())
+     * @param task The work to run
+     */
+    void submitToNode(int node, Task task);
+    
+    /**
+     * Run one queued task on the calling thread, if any is available
+     * 
+     * @return bool True if a task was executed
+     */
+    bool runPendingTask();
+    
+    /**
+     * Index of the calling worker thread, or -1 for non-pool threads
+     */
+    static int currentWorkerIndex();
+    
+    /**
+     * NUMA node of the calling thread, or -1 if it is not pinned
+     */
+    static int currentNode();
+    
+    ~ThreadPool();
+
+private:
+    explicit ThreadPool(int numThreads);
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+    
+    // Per-worker task queue
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    
+    // Per-node state: sleeping workers of a node wait here until tasks
+    // are queued on that node
+    struct NodeState {
+        std::mutex sleepMutex;
+        std::condition_variable wakeUp;
+        std::atomic<int> queuedTasks;
+        std::vector<int> queueIndices;
+        std::atomic<unsigned> nextQueue;
+    };
+    
+    void workerLoop(int index, int cpu);
+    bool popTask(int preferredQueue, Task& task);
+    void pushTask(int queueIndex, Task task);
+    int pickQueue(int node);
+    
+    std::vector<std::unique_ptr<WorkerQueue> > queues;
+    std::vector<int> queueNode;
+    std::vector<std::unique_ptr<NodeState> > nodes;
+    std::vector<std::thread> workers;
+    
+    std::atomic<unsigned> nextQueue;
+    std::atomic<bool> stopping;
+    int totalThreads;
+    bool pinned;
+};
+
+/**
+ * Group of tasks that can be waited on together
+ * 
+ * The destructor waits for any tasks still running. If a task throws,
+ * the first exception is rethrown from wait().
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool = ThreadPool::instance());
+    ~TaskGroup();
+    
+    /**
+     * Submit a task belonging to this group
+     * 
+     * @param task The work to run
+     */
+    void run(std::function<void()> task);
+    
+    /**
+     * Submit a task that must run on a specific NUMA node
+     * 
+     * Any parallelFor() inside the task stays on the same node, so all
+     * buffers the task allocates are first touched (and placed) there.
+     * 
+     * @param node NUMA node index (taken modulo the pool's node count)
+     * @param task The work to run
+     */
+    void runOnNode(int node, std::function<void()> task);
+    
+    /**
+     * Block until every task in the group has finished, executing queued
+     * pool tasks on this thread in the meantime
+     */
+    void wait();
+
+private:
+    TaskGroup(const TaskGroup&);
+    TaskGroup& operator=(const TaskGroup&);
+    
+    std::function<void()> wrap(std::function<void()> task);
+    
+    ThreadPool& pool;
+    std::atomic<int> pending;
+    std::mutex doneMutex;
+    std::condition_variable done;
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+};
+
+/**
+ * Split [begin, end) into chunks and process them on the shared pool
+ * 
+ * Intended for row ranges: body(rowBegin, rowEnd) is called once per chunk.
+ * The calling thread processes chunks too, and the call returns once the
+ * whole range is done. Small ranges run inline without touching the pool.
+ * 
+ * @param begin First index of the range
+ * @param end One past the last index of the range
+ * @param body Function processing the half-open chunk [chunkBegin, chunkEnd)
+ * @param grainSize Minimum chunk length (<= 0 picks one automatically)
+ */
+void parallelFor(int begin, int end, const std::function<void(int, int)>& body, int grainSize = 0);
+
+#endif // THREAD_POOL_H
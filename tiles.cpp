@@ -0,0 +1,101 @@
+#include "tiles.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+int TileActivity::flatCount() const {
+    int count = 0;
+    for (size_t i = 0; i < flat.size(); i++) {
+        count += flat[i];
+    }
+    return count;
+}
+
+double TileActivity::skipRatio() const {
+    if (flat.empty()) {
+        return 0.0;
+    }
+    return static_cast<double>(flatCount()) / flat.size();
+}
+
+bool findFlatTiles(const cv::Mat& image, int margin, double threshold, TileActivity& tiles,
+                   int tileSize) {
+    // Validate input image
+    if (image.empty()) {
+        std::cerr << "Error: Input image cannot be empty!" << std::endl;
+        return false;
+    }
+    if (image.depth() != CV_8U) {
+        std::cerr << "Error: Tile activity requires an 8-bit image!" << std::endl;
+        return false;
+    }
+    
+    tiles.tileSize = std::max(1, tileSize);
+    tiles.tilesX = (image.cols + tiles.tileSize - 1) / tiles.tileSize;
+    tiles.tilesY = (image.rows + tiles.tileSize - 1) / tiles.tileSize;
+    tiles.flat.assign(tiles.tilesX * tiles.tilesY, 0);
+    
+    // The unsharp mask keeps details of at least ceil(threshold) gray
+    // levels (see applyUnsharpMask), so a tile is flat when its range is
+    // below that; with a threshold of 0 every pixel is sharpened
+    int maxRange = static_cast<int>(std::ceil(std::max(0.0, threshold)));
+    if (maxRange <= 0) {
+        return true;
+    }
+    
+    margin = std::max(0, margin);
+    const int channels = image.channels();
+    const int length = image.cols * channels;
+    const int size = tiles.tileSize;
+    
+    // One task per tile row
+    parallelFor(0, tiles.tilesY, [&](int tileRowBegin, int tileRowEnd) {
+        std::vector<unsigned char> columnMin(length);
+        std::vector<unsigned char> columnMax(length);
+        std::vector<int> low(channels), high(channels);
+        
+        for (int ty = tileRowBegin; ty < tileRowEnd; ty++) {
+            // Rows of the tile row plus the margin above and below
+            int y0 = std::max(0, ty * size - margin);
+            int y1 = std::min(image.rows, (ty + 1) * size + margin);
+            
+            // Element-wise min and max down the columns (vectorizes)
+            const unsigned char* first = image.ptr<unsigned char>(y0);
+            std::copy(first, first + length, columnMin.begin());
+            std::copy(first, first + length, columnMax.begin());
+            for (int y = y0 + 1; y < y1; y++) {
+                const unsigned char* row = image.ptr<unsigned char>(y);
+                for (int i = 0; i < length; i++) {
+                    columnMin[i] = std::min(columnMin[i], row[i]);
+                    columnMax[i] = std::max(columnMax[i], row[i]);
+                }
+            }
+            
+            // Range of every tile plus the margin left and right, per channel
+            for (int tx = 0; tx < tiles.tilesX; tx++) {
+                int x0 = std::max(0, tx * size - margin);
+                int x1 = std::min(image.cols, (tx + 1) * size + margin);
+                
+                std::fill(low.begin(), low.end(), 255);
+                std::fill(high.begin(), high.end(), 0);
+                for (int x = x0; x < x1; x++) {
+                    for (int c = 0; c < channels; c++) {
+                        low[c] = std::min<int>(low[c], columnMin[x * channels + c]);
+                        high[c] = std::max<int>(high[c], columnMax[x * channels + c]);
+                    }
+                }
+                
+                bool flat = true;
+                for (int c = 0; c < channels; c++) {
+                    if (high[c] - low[c] >= maxRange) {
+                        flat = false;
+                    }
+                }
+                tiles.flat[ty * tiles.tilesX + tx] = flat ? 1 : 0;
+            }
+        }
+    });
+    
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+/**
+ * Tile activity prepass for the enhancement pipeline
+ * 
+ * Large parts of typical images (sky, walls, document backgrounds) have no
+ * detail above the unsharp mask threshold, so sharpening leaves them
+ * unchanged. The prepass finds these areas per tile, so the blur and the
+ * unsharp mask can copy them through instead of filtering them.
+ * 
+ * A tile is flat when, in every channel, the range (max - min) of the tile
+ * plus a margin of the blur radius around it is below the threshold. A
+ * Gaussian blur only averages pixels within its radius, so in a flat tile
+ * |original - blurred| stays below the threshold everywhere and the unsharp
+ * mask would return the original pixel: skipping the tile gives exactly the
+ * same enhanced image.
+ */
+
+// Tile size of the prepass (pixels per side)
+const int defaultTileSize = 32;
+
+/**
+ * Flat / active state of every tile of an image
+ */
+struct TileActivity {
+    int tileSize;
+    int tilesX;                       // Tiles per row (the last one may be partial)
+    int tilesY;                       // Tile rows
+    std::vector<unsigned char> flat;  // 1 = flat tile, row-major
+    
+    bool isFlat(int tx, int ty) const {
+        return flat[ty * tilesX + tx] != 0;
+    }
+    
+    /**
+     * Number of flat tiles
+     */
+    int flatCount() const;
+    
+    /**
+     * Fraction of the tiles that are flat (0 to 1)
+     */
+    double skipRatio() const;
+};
+
+/**
+ * Find the flat tiles of an image for a blur + unsharp mask pipeline
+ * 
+ * @param image The image that will be blurred and sharpened (8-bit)
+ * @param margin Pixels the blur reads beyond a tile (see blurRadius); a
+ *               smaller margin makes the skip inexact
+ * @param threshold Unsharp mask threshold; a threshold of 0 sharpens every
+ *                  pixel, so no tile is flat
+ * @param tiles Receives the tile states (sized to the image)
+ * @param tileSize Tile size in pixels
+ * @return bool False if the image is empty or not 8-bit
+ */
+bool findFlatTiles(const cv::Mat& image, int margin, double threshold, TileActivity& tiles,
+                   int tileSize = defaultTileSize);
+
+#endif // TILES_H
@@ -0,0 +1,365 @@
+#include "image_quality.h"
+#include "thread_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Columns per block of the vertical transform: a block of all rows stays
+// in L2 cache and every lifting step is a vectorized loop along its rows
+const int columnBlock = 32;
+
+// Decomposition levels (each halves the resolution of the low band)
+const int maxWaveletLevels = 6;
+
+/**
+ * Forward CDF 5/3 lifting step of n samples, split into the nLow even
+ * samples lo and the nHigh odd samples hi
+ * 
+ * Every sample is a vector of count integers (1 for a row, the block
+ * width for columns), stored one after the other, so each step is a
+ * single loop over nLow × count or nHigh × count values that vectorizes
+ * for rows and columns alike. Integer lifting as in lossless JPEG 2000:
+ *   predict: hi[i] -= floor((lo[i] + lo[i + 1]) / 2)
+ *   update:  lo[i] += floor((hi[i - 1] + hi[i] + 2) / 4)
+ * with symmetric extension at both ends. liftInverse undoes it exactly.
+ * Requires n >= 2.
+ */
+void liftForward(int* lo, int* hi, int nLow, int nHigh, int count) {
+    // Predict: odd samples become the high band
+    // (with an even n, the last odd sample mirrors its left neighbor)
+    int inner = (nLow > nHigh) ? nHigh : nHigh - 1;
+    for (int k = 0; k < inner * count; k++) {
+        hi[k] -= (lo[k] + lo[k + count]) >> 1;
+    }
+    for (int k = inner * count; k < nHigh * count; k++) {
+        hi[k] -= lo[k];
+    }
+    
+    // Update: even samples become the low band
+    // (the first one mirrors hi[0]; with an odd n, so does the last one
+    // with hi[nHigh - 1])
+    for (int k = 0; k < count; k++) {
+        lo[k] += (2 * hi[k] + 2) >> 2;
+    }
+    for (int k = count; k < nHigh * count; k++) {
+        lo[k] += (hi[k - count] + hi[k] + 2) >> 2;
+    }
+    if (nLow > nHigh) {
+        int* last = lo + nHigh * count;
+        const int* mirror = hi + (nHigh - 1) * count;
+        for (int k = 0; k < count; k++) {
+            last[k] += (2 * mirror[k] + 2) >> 2;
+        }
+    }
+}
+
+/**
+ * Inverse of liftForward (same arguments, the steps in reverse order)
+ */
+void liftInverse(int* lo, int* hi, int nLow, int nHigh, int count) {
+    for (int k = 0; k < count; k++) {
+        lo[k] -= (2 * hi[k] + 2) >> 2;
+    }
+    for (int k = count; k < nHigh * count; k++) {
+        lo[k] -= (hi[k - count] + hi[k] + 2) >> 2;
+    }
+    if (nLow > nHigh) {
+        int* last = lo + nHigh * count;
+        const int* mirror = hi + (nHigh - 1) * count;
+        for (int k = 0; k < count; k++) {
+            last[k] -= (2 * mirror[k] + 2) >> 2;
+        }
+    }
+    
+    int inner = (nLow > nHigh) ? nHigh : nHigh - 1;
+    for (int k = 0; k < inner * count; k++) {
+        hi[k] += (lo[k] + lo[k + count]) >> 1;
+    }
+    for (int k = inner * count; k < nHigh * count; k++) {
+        hi[k] += lo[k];
+    }
+}
+
+/**
+ * One level of the 2D transform (or its inverse) on the coefficient plane
+ * 
+ * The plane is transformed in place, without reordering: the samples of
+ * level L sit at the multiples of step = 2^L, and after the level its low
+ * band sits at the multiples of 2 × step. Rows and column blocks are
+ * copied into a small buffer (even samples first, then odd ones), lifted
+ * there and copied back, so the lifting loops always run over contiguous
+ * memory. Forward: rows, then columns; inverse: columns, then rows.
+ */
+void transformLevel(std::vector<int>& plane, int width, int height, int step, bool inverse) {
+    const int nx = (width + step - 1) / step;
+    const int ny = (height + step - 1) / step;
+    
+    auto rows = [&]() {
+        if (nx < 2) {
+            return;
+        }
+        const int nLow = (nx + 1) / 2;
+        const int nHigh = nx / 2;
+        parallelFor(0, ny, [&](int begin, int end) {
+            std::vector<int> buffer(nx);
+            for (int r = begin; r < end; r++) {
+                int* row = &plane[r * step * width];
+                for (int i = 0; i < nx; i++) {
+                    buffer[(i & 1) ? nLow + i / 2 : i / 2] = row[i * step];
+                }
+                if (inverse) {
+                    liftInverse(&buffer[0], &buffer[nLow], nLow, nHigh, 1);
+                } else {
+                    liftForward(&buffer[0], &buffer[nLow], nLow, nHigh, 1);
+                }
+                for (int i = 0; i < nx; i++) {
+                    row[i * step] = buffer[(i & 1) ? nLow + i / 2 : i / 2];
+                }
+            }
+        });
+    };
+    
+    auto columns = [&]() {
+        if (ny < 2) {
+            return;
+        }
+        const int nLow = (ny + 1) / 2;
+        const int nHigh = ny / 2;
+        const int blocks = (nx + columnBlock - 1) / columnBlock;
+        parallelFor(0, blocks, [&](int begin, int end) {
+            std::vector<int> buffer(ny * columnBlock);
+            for (int b = begin; b < end; b++) {
+                const int first = b * columnBlock;
+                const int count = std::min(columnBlock, nx - first);
+                for (int i = 0; i < ny; i++) {
+                    const int* row = &plane[i * step * width + first * step];
+                    int* sample = &buffer[((i & 1) ? nLow + i / 2 : i / 2) * count];
+                    for (int j = 0; j < count; j++) {
+                        sample[j] = row[j * step];
+                    }
+                }
+                if (inverse) {
+                    liftInverse(&buffer[0], &buffer[nLow * count], nLow, nHigh, count);
+                } else {
+                    liftForward(&buffer[0], &buffer[nLow * count], nLow, nHigh, count);
+                }
+                for (int i = 0; i < ny; i++) {
+                    int* row = &plane[i * step * width + first * step];
+                    const int* sample = &buffer[((i & 1) ? nLow + i / 2 : i / 2) * count];
+                    for (int j = 0; j < count; j++) {
+                        row[j * step] = sample[j];
+                    }
+                }
+            }
+        });
+    };
+    
+    if (inverse) {
+        columns();
+        rows();
+    } else {
+        rows();
+        columns();
+    }
+}
+
+/**
+ * Standard deviation that white noise of standard deviation 1 has in the
+ * low or high band of a level (ignoring the integer rounding)
+ * 
+ * The band is the input filtered by the lowpass of every earlier level and
+ * then by the lowpass or highpass of this level, each upsampled by its
+ * step; the noise gain is the L2 norm of that combined filter.
+ */
+double bandNoiseGain(int level, bool high) {
+    const double lowpass[] = {-0.125, 0.25, 0.75, 0.25, -0.125};
+    const double highpass[] = {-0.5, 1.0, -0.5};
+    
+    std::vector<double> filter(1, 1.0);
+    for (int l = 0; l <= level; l++) {
+        const bool last = (l == level);
+        const double* taps = (last && high) ? highpass : lowpass;
+        const int tapCount = (last && high) ? 3 : 5;
+        const int step = 1 << l;
+        
+        std::vector<double> combined(filter.size() + (tapCount - 1) * step, 0.0);
+        for (size_t i = 0; i < filter.size(); i++) {
+            for (int t = 0; t < tapCount; t++) {
+                combined[i + t * step] += filter[i] * taps[t];
+            }
+        }
+        filter.swap(combined);
+    }
+    
+    double sum = 0.0;
+    for (size_t i = 0; i < filter.size(); i++) {
+        sum += filter[i] * filter[i];
+    }
+    return std::sqrt(sum);
+}
+
+/**
+ * Robust estimate of the noise standard deviation of one channel
+ * 
+ * Median absolute value of the finest diagonal (high-high) band divided
+ * by 0.6745 (the median of |x| for a unit Gaussian) and by the band's
+ * noise gain. Image detail is sparse in that band, so the median mostly
+ * sees noise.
+ */
+double estimateNoise(const std::vector<int>& plane, int width, int height) {
+    // Histogram of the absolute values (large ones share the last bin,
+    // they never decide the median)
+    const int bins = 1024;
+    std::vector<int> histogram(bins, 0);
+    int total = 0;
+    for (int y = 1; y < height; y += 2) {
+        const int* row = &plane[y * width];
+        for (int x = 1; x < width; x += 2) {
+            histogram[std::min(bins - 1, std::abs(row[x]))]++;
+            total++;
+        }
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    
+    int count = 0;
+    int median = 0;
+    while (count + histogram[median] <= total / 2) {
+        count += histogram[median];
+        median++;
+    }
+    double gain = bandNoiseGain(0, true) * bandNoiseGain(0, true);
+    return median / 0.6745 / gain;
+}
+
+}
+
+/**
+ * Denoise an image by wavelet shrinkage
+ * 
+ * Each channel is decomposed with the CDF 5/3 wavelet (integer lifting, as
+ * in lossless JPEG 2000) into several levels of detail bands. Noise spreads
+ * evenly over all coefficients while image structure concentrates in a few
+ * large ones, so every detail coefficient is shrunk towards zero by a
+ * threshold (soft thresholding) and the image is transformed back.
+ * 
+ * The noise level is estimated from the image itself, and each band's
+ * threshold is thresholdScale noise standard deviations as seen in that
+ * band. All levels transform one integer plane in place, the only working
+ * buffer; rows and column blocks run on the shared thread pool, so the
+ * whole denoiser takes linear time.
+ * 
+ * @param input The input image (8-bit, any number of channels)
+ * @param output Destination image; its buffer is reused when it already
+ *               has the right size and type (may be input itself)
+ * @param thresholdScale Threshold in noise standard deviations (larger
+ *                       removes more noise and more detail)
+ * @param levels Decomposition levels, 1 to 6
+ * @return bool False if the input is invalid (an error is printed)
+ */
+bool applyWaveletDenoise(const cv::Mat& input, cv::Mat& output, double thresholdScale, int levels) {
+    // Validate input image
+    if (input.empty()) {
+        std::cerr << "Error: Input image cannot be empty!" << std::endl;
+        return false;
+    }
+    if (input.depth() != CV_8U) {
+        std::cerr << "Error: Wavelet denoising requires an 8-bit image!" << std::endl;
+        return false;
+    }
+    if (levels < 1 || levels > maxWaveletLevels) {
+        std::cerr << "Error: Wavelet levels must be between 1 and " << maxWaveletLevels << "!" << std::endl;
+        return false;
+    }
+    
+    const int width = input.cols;
+    const int height = input.rows;
+    const int channels = input.channels();
+    output.create(input.size(), input.type());
+    
+    std::vector<int> plane(width * height);
+    for (int c = 0; c < channels; c++) {
+        // Load the channel into the coefficient plane
+        parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; y++) {
+                const unsigned char* src = input.ptr<unsigned char>(y);
+                int* dst = &plane[y * width];
+                for (int x = 0; x < width; x++) {
+                    dst[x] = src[x * channels + c];
+                }
+            }
+        });
+        
+        for (int level = 0; level < levels; level++) {
+            transformLevel(plane, width, height, 1 << level, false);
+        }
+        
+        // Soft-threshold the detail coefficients of every level
+        double sigma = thresholdScale * estimateNoise(plane, width, height);
+        for (int level = 0; level < levels; level++) {
+            const int step = 1 << level;
+            double lowGain = bandNoiseGain(level, false);
+            double highGain = bandNoiseGain(level, true);
+            // Threshold of a coefficient by its (vertical, horizontal) band
+            int thresholds[2][2];
+            thresholds[0][0] = 0;
+            thresholds[0][1] = static_cast<int>(std::lround(sigma * lowGain * highGain));
+            thresholds[1][0] = thresholds[0][1];
+            thresholds[1][1] = static_cast<int>(std::lround(sigma * highGain * highGain));
+            if (thresholds[0][1] == 0 && thresholds[1][1] == 0) {
+                continue;
+            }
+            
+            // Rows of this level: the low ones hold the low band (threshold
+            // 0, kept for the next levels) and the horizontal detail band,
+            // the high ones (odd multiples of step) the other two bands
+            const int ny = (height + step - 1) / step;
+            parallelFor(0, ny, [&](int rowBegin, int rowEnd) {
+                for (int r = rowBegin; r < rowEnd; r++) {
+                    int* row = &plane[r * step * width];
+                    const int* t = thresholds[r & 1];
+                    for (int x = 0, i = 0; x < width; x += step, i++) {
+                        int threshold = t[i & 1];
+                        int value = row[x];
+                        if (value > threshold) {
+                            row[x] = value - threshold;
+                        } else if (value < -threshold) {
+                            row[x] = value + threshold;
+                        } else {
+                            row[x] = 0;
+                        }
+                    }
+                }
+            });
+        }
+        
+        for (int level = levels - 1; level >= 0; level--) {
+            transformLevel(plane, width, height, 1 << level, true);
+        }
+        
+        // Store the channel
+        parallelFor(0, height, [&](int rowBegin, int rowEnd) {
+            for (int y = rowBegin; y < rowEnd; y++) {
+                const int* src = &plane[y * width];
+                unsigned char* dst = output.ptr<unsigned char>(y);
+                for (int x = 0; x < width; x++) {
+                    dst[x * channels + c] = cv::saturate_cast<unsigned char>(src[x]);
+                }
+            }
+        });
+    }
+    
+    return true;
+}
+
+cv::Mat applyWaveletDenoise(const cv::Mat& input, double thresholdScale, int levels) {
+    cv::Mat output;
+    if (!applyWaveletDenoise(input, output, thresholdScale, levels)) {
+        return cv::Mat();
+    }
+    return output;
+}